@@ -0,0 +1,92 @@
+//
+// Accept.cpp
+// NaoCar Network Benchmark
+//
+// Measures the connections accepted per second: the server gives each
+// socket back as soon as it is accepted, as the remote server does when a
+// client goes away. A client waits for the close before it connects again,
+// so each one has a single connection in the backlog.
+//
+
+#include <atomic>
+
+#include "Benchmark.hpp"
+#include "Network/ITcpServerDelegate.h"
+
+class Acceptor : public Network::ITcpServerDelegate
+{
+public:
+  Acceptor() : _accepted(0)
+  {
+  }
+
+  uint64_t accepted() const
+  {
+    return _accepted.load();
+  }
+
+  virtual void newConnection(Network::ATcpServer* server,
+                             Network::ATcpSocket* socket)
+  {
+    _accepted.fetch_add(1, std::memory_order_relaxed);
+    server->release(socket);
+  }
+
+private:
+  std::atomic<uint64_t> _accepted;
+};
+
+//! Connects, waits for the server to close and resets, until told to stop
+static void connectLoop(Loopback const* loopback, std::atomic<bool> const* stop)
+{
+  boost::asio::io_service ioService;
+
+  while (!*stop)
+    {
+      boost::asio::ip::tcp::socket socket(ioService);
+      boost::system::error_code error;
+      char byte;
+
+      socket.connect(loopback->endpoint(), error);
+      if (error)
+        continue ;
+      // Fails once the connection is accepted and closed
+      socket.read_some(boost::asio::buffer(&byte, 1), error);
+      // Resets instead of closing, so no TIME_WAIT exhausts the ports
+      socket.set_option(boost::asio::socket_base::linger(true, 0), error);
+      socket.close(error);
+    }
+}
+
+void runAccept(Options const& options, Samples& samples)
+{
+  Loopback loopback(options.threads, options.backend);
+  Acceptor acceptor;
+  std::atomic<bool> stop(false);
+  std::vector<boost::thread*> clients;
+  size_t count = options.maxClients < 4 ? options.maxClients : 4;
+
+  loopback.server().setDelegate(&acceptor);
+  if (!loopback.start())
+    return ;
+  for (size_t i = 0; i < count; ++i)
+    clients.push_back(new boost::thread(&connectLoop, &loopback, &stop));
+
+  measure(0.2);
+  double start = now();
+  uint64_t accepted = acceptor.accepted();
+  measure(options.seconds);
+  double elapsed = now() - start;
+  accepted = acceptor.accepted() - accepted;
+
+  stop = true;
+  for (size_t i = 0; i < clients.size(); ++i)
+    {
+      clients[i]->join();
+      delete clients[i];
+    }
+  loopback.stop();
+  samples.push_back(Sample("accept")
+                    .set("clients", count)
+                    .set("accepts_per_second", accepted / elapsed));
+}
@@ -0,0 +1,107 @@
+//
+// Benchmark.hpp
+// NaoCar Network Benchmark
+//
+
+#ifndef __BENCHMARK_HPP__
+# define __BENCHMARK_HPP__
+
+# include <boost/asio.hpp>
+# include <boost/thread/thread.hpp>
+# include <string>
+# include <utility>
+# include <vector>
+
+# include "Network/BoostTcpServer.h"
+# ifdef NETWORK_HAVE_URING
+#  include "Network/UringTcpServer.h"
+# endif
+
+//! A measure, written as a JSON object
+struct Sample
+{
+  explicit Sample(std::string const& benchmark) : benchmark(benchmark), values() {}
+
+  Sample& set(std::string const& key, double value)
+  {
+    values.push_back(std::make_pair(key, value));
+    return *this;
+  }
+
+  std::string                                  benchmark;
+  std::vector<std::pair<std::string, double> > values;
+};
+
+typedef std::vector<Sample> Samples;
+
+struct Options
+{
+  //! Length of each measure
+  double       seconds;
+  //! Threads running the io_service of the server
+  unsigned int threads;
+  //! Largest number of concurrent clients
+  unsigned int maxClients;
+  //! Network backend of the server, "boost" or "uring"
+  std::string  backend;
+};
+
+//! A server listening on loopback, its io_service run by a thread pool
+/*!
+ With the uring backend the server runs in the thread of its UringService
+ instead, threads is ignored.
+ The delegates give their sockets back with release() once the server is
+ stopped, and outlive it: the sockets are recycled when it is destroyed.
+ */
+class Loopback
+{
+public:
+  Loopback(unsigned int threads, std::string const& backend);
+  ~Loopback();
+
+  boost::asio::io_service* ioService();
+  Network::ATcpServer& server();
+#ifdef NETWORK_HAVE_URING
+  //! NULL with the boost backend
+  Network::UringService* uringService();
+#endif
+  boost::asio::ip::tcp::endpoint endpoint() const;
+
+  //! Listens and starts the threads, once the delegate is set
+  bool start();
+  //! Stops the io_service, waits for the threads and closes the server
+  void stop();
+  //! Gives back an accepted socket, once stopped
+  void release(Network::ATcpSocket* socket);
+
+private:
+  boost::asio::io_service       _ioService;
+#ifdef NETWORK_HAVE_URING
+  Network::UringService*        _uringService;
+#endif
+  Network::ATcpServer*          _server;
+  unsigned int                  _threads;
+  std::vector<boost::thread*>   _pool;
+};
+
+//! Whether the backend is built and supported by the kernel
+bool isBackendAvailable(std::string const& backend);
+
+//! Seconds since an arbitrary point
+double now();
+
+//! Sleeps until the measure has lasted long enough
+void measure(double seconds);
+
+//! Connects a blocking client socket to the server
+boost::asio::ip::tcp::socket* connectClient(boost::asio::io_service& ioService,
+                                            Loopback const& loopback);
+
+// Each benchmark appends its measures to samples
+void runLines(Options const& options, Samples& samples);
+void runWrite(Options const& options, Samples& samples);
+void runAccept(Options const& options, Samples& samples);
+void runLatency(Options const& options, Samples& samples);
+void runFanOut(Options const& options, Samples& samples);
+
+#endif
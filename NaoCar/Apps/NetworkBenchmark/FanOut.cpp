@@ -0,0 +1,237 @@
+//
+// FanOut.cpp
+// NaoCar Network Benchmark
+//
+// Measures how the stream fan-out of the remote server scales with the
+// number of threads running the io_service. A server sends frames to local
+// clients the way StreamServer does: the same shared frame is written on the
+// socket of every client, whose handlers run in its own strand. Every
+// client keeps a few frames in flight, so the server runs as fast as the
+// io_service threads allow.
+// The uring backend runs in a single thread, its system calls per frame
+// are reported instead.
+//
+
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include "Benchmark.hpp"
+#include "Network/ITcpServerDelegate.h"
+#include "Network/ITcpSocketDelegate.h"
+
+//! Frames queued on a socket at any time
+static const size_t framesInFlight = 4;
+
+class FanOut : public Network::ITcpServerDelegate,
+               public Network::ITcpSocketDelegate
+{
+public:
+  FanOut(size_t frameSize) :
+    _frame(frameSize), _clients(), _clientsMutex(), _stop(false)
+  {
+    memset(_frame.mutableData(), 'x', frameSize);
+  }
+
+  virtual ~FanOut()
+  {
+    for (auto it = _clients.begin(); it != _clients.end(); ++it)
+      delete it->second;
+  }
+
+  //! Gives the sockets back, once the server is stopped
+  void release(Loopback& loopback)
+  {
+    for (auto it = _clients.begin(); it != _clients.end(); ++it)
+      loopback.release(it->second->socket);
+  }
+
+  void stop()
+  {
+    _stop = true;
+  }
+
+  //! Bytes written so far, by all the clients
+  uint64_t written()
+  {
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    uint64_t total = 0;
+
+    for (auto it = _clients.begin(); it != _clients.end(); ++it)
+      total += it->second->written;
+    return total;
+  }
+
+  virtual void newConnection(Network::ATcpServer*, Network::ATcpSocket* socket)
+  {
+    Client* client = new Client();
+
+    client->socket = socket;
+    socket->setDelegate(this);
+    {
+      std::lock_guard<std::mutex> lock(_clientsMutex);
+      _clients[socket] = client;
+    }
+    // Each write is started in the strand of the socket
+    _start(client);
+  }
+
+  virtual void connected(Network::ASocket*, Network::ASocket::Error)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket*, Network::ASocket::Error, size_t)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket*, Network::ASocket::Error,
+                            Network::ASocket::Buffer const&)
+  {
+  }
+
+  virtual void writeFinished(Network::ASocket* sender,
+                             Network::ASocket::Error error,
+                             size_t bytesWritten)
+  {
+    Client* client;
+    {
+      std::lock_guard<std::mutex> lock(_clientsMutex);
+      auto it = _clients.find(sender);
+      if (it == _clients.end())
+        return ;
+      client = it->second;
+    }
+    if (error)
+      return ;
+    client->written += bytesWritten;
+    if (!_stop)
+      _writeFrame(client);
+  }
+
+private:
+  struct Client
+  {
+    Client() : socket(NULL), written(0) {}
+
+    Network::ATcpSocket* socket;
+    std::atomic<uint64_t> written;
+  };
+
+  void _start(Client* client)
+  {
+    for (size_t i = 0; i < framesInFlight; ++i)
+      _writeFrame(client);
+  }
+
+  void _writeFrame(Client* client)
+  {
+    // Shared by every client, like StreamServer does
+    client->socket->write(_frame);
+  }
+
+  Network::SharedBuffer            _frame;
+  std::map<Network::ASocket*, Client*> _clients;
+  std::mutex                       _clientsMutex;
+  std::atomic<bool>                _stop;
+};
+
+//! Reads and drops everything until the connection is closed
+static void receive(boost::asio::ip::tcp::socket* socket)
+{
+  char buffer[65536];
+  boost::system::error_code error;
+
+  while (!error)
+    socket->read_some(boost::asio::buffer(buffer), error);
+}
+
+//! Returns the throughput of the fan-out, in bytes per second, and the
+//! io_uring_enter calls of the period with the uring backend
+static double run(unsigned int threads, std::string const& backend,
+                  size_t clients, size_t frameSize, double seconds,
+                  uint64_t& enters)
+{
+  Loopback loopback(threads, backend);
+  boost::asio::io_service client;
+  FanOut fanOut(frameSize);
+  std::vector<boost::asio::ip::tcp::socket*> sockets;
+  std::vector<boost::thread*> receivers;
+
+  loopback.server().setDelegate(&fanOut);
+  if (!loopback.start())
+    return 0;
+  for (size_t i = 0; i < clients; ++i)
+    {
+      sockets.push_back(connectClient(client, loopback));
+      receivers.push_back(new boost::thread(&receive, sockets.back()));
+    }
+
+  // Let the connections be accepted and the queues fill up
+  measure(0.5);
+  enters = 0;
+#ifdef NETWORK_HAVE_URING
+  if (loopback.uringService())
+    enters = loopback.uringService()->getStatistics().enters;
+#endif
+  double start = now();
+  uint64_t before = fanOut.written();
+  measure(seconds);
+  uint64_t after = fanOut.written();
+  double end = now();
+#ifdef NETWORK_HAVE_URING
+  if (loopback.uringService())
+    enters = loopback.uringService()->getStatistics().enters - enters;
+#endif
+
+  fanOut.stop();
+  // Unblocks the receivers, the pending writes fail
+  for (size_t i = 0; i < sockets.size(); ++i)
+    {
+      boost::system::error_code error;
+      sockets[i]->shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+    }
+  for (size_t i = 0; i < receivers.size(); ++i)
+    {
+      receivers[i]->join();
+      delete receivers[i];
+      sockets[i]->close();
+      delete sockets[i];
+    }
+  loopback.stop();
+  fanOut.release(loopback);
+  return (after - before) / (end - start);
+}
+
+void runFanOut(Options const& options, Samples& samples)
+{
+  static const size_t clients = 8;
+  static const size_t frameSize = 16384;
+  double single = 0;
+  bool uring = options.backend == "uring";
+  unsigned int maxThreads = uring ? 1 : options.threads;
+
+  for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+      uint64_t enters = 0;
+      double throughput = run(threads, options.backend, clients, frameSize,
+                              options.seconds, enters);
+      // Frames written to a client
+      double frames = throughput * options.seconds / frameSize;
+      Sample sample("fanout");
+
+      if (threads == 1)
+        single = throughput;
+      sample.set("threads", threads)
+        .set("clients", clients)
+        .set("frame_bytes", frameSize)
+        .set("mb_per_second", throughput / 1e6)
+        .set("frames_per_second", throughput / frameSize)
+        .set("speedup", single > 0 ? throughput / single : 0);
+      if (uring)
+        sample.set("enters_per_frame", frames > 0 ? enters / frames : 0);
+      samples.push_back(sample);
+      if (threads < maxThreads && threads * 2 > maxThreads)
+        threads = maxThreads / 2;
+    }
+}
@@ -0,0 +1,161 @@
+//
+// Latency.cpp
+// NaoCar Network Benchmark
+//
+// Measures the round trip of a request, the way a command goes to the remote
+// server: each client sends a line and waits for the answer of the server
+// before sending the next one.
+//
+
+#include <algorithm>
+#include <mutex>
+
+#include "Benchmark.hpp"
+#include "Network/ITcpServerDelegate.h"
+#include "Network/ITcpSocketDelegate.h"
+
+static const char request[] = "ping\n";
+static const char response[] = "pong\n";
+
+class Echo : public Network::ITcpServerDelegate,
+             public Network::ITcpSocketDelegate
+{
+public:
+  Echo() : _sockets(), _socketsMutex()
+  {
+  }
+
+  //! Gives the sockets back, once the server is stopped
+  void release(Loopback& loopback)
+  {
+    for (size_t i = 0; i < _sockets.size(); ++i)
+      loopback.release(_sockets[i]);
+    _sockets.clear();
+  }
+
+  virtual void newConnection(Network::ATcpServer*, Network::ATcpSocket* socket)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_socketsMutex);
+      _sockets.push_back(socket);
+    }
+    socket->setNoDelay(true);
+    socket->setDelegate(this);
+    socket->readUntil("\n");
+  }
+
+  virtual void connected(Network::ASocket*, Network::ASocket::Error)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket*, Network::ASocket::Error, size_t)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket* sender,
+                            Network::ASocket::Error error,
+                            Network::ASocket::Buffer const&)
+  {
+    if (error)
+      return ;
+    sender->write(response, sizeof(response) - 1);
+    static_cast<Network::ATcpSocket*>(sender)->readUntil("\n");
+  }
+
+  virtual void writeFinished(Network::ASocket*, Network::ASocket::Error, size_t)
+  {
+  }
+
+private:
+  std::vector<Network::ATcpSocket*> _sockets;
+  std::mutex                        _socketsMutex;
+};
+
+struct Client
+{
+  boost::asio::ip::tcp::socket* socket;
+  double                        warmUpEnd;
+  double                        end;
+  //! Round trips in seconds, after the warm-up
+  std::vector<double>           roundTrips;
+};
+
+static void pingLoop(Client* client)
+{
+  char answer[sizeof(response) - 1];
+  boost::system::error_code error;
+  double start;
+
+  while ((start = now()) < client->end)
+    {
+      boost::asio::write(*client->socket,
+                         boost::asio::buffer(request, sizeof(request) - 1),
+                         error);
+      if (!error)
+        boost::asio::read(*client->socket, boost::asio::buffer(answer), error);
+      if (error)
+        return ;
+      if (start >= client->warmUpEnd)
+        client->roundTrips.push_back(now() - start);
+    }
+}
+
+//! The round trip below which a ratio of them are, in microseconds
+static double percentile(std::vector<double> const& sorted, double ratio)
+{
+  size_t index = (size_t)(ratio * sorted.size());
+
+  if (index >= sorted.size())
+    index = sorted.size() - 1;
+  return sorted[index] * 1e6;
+}
+
+static void run(Options const& options, size_t count, Samples& samples)
+{
+  Loopback loopback(options.threads, options.backend);
+  boost::asio::io_service ioService;
+  Echo echo;
+  std::vector<Client> clients(count);
+  std::vector<boost::thread*> threads;
+  std::vector<double> roundTrips;
+
+  loopback.server().setDelegate(&echo);
+  if (!loopback.start())
+    return ;
+  double warmUpEnd = now() + 0.2;
+  for (size_t i = 0; i < count; ++i)
+    {
+      clients[i].socket = connectClient(ioService, loopback);
+      clients[i].warmUpEnd = warmUpEnd;
+      clients[i].end = warmUpEnd + options.seconds;
+    }
+  for (size_t i = 0; i < count; ++i)
+    threads.push_back(new boost::thread(&pingLoop, &clients[i]));
+  for (size_t i = 0; i < count; ++i)
+    {
+      threads[i]->join();
+      delete threads[i];
+      delete clients[i].socket;
+      roundTrips.insert(roundTrips.end(), clients[i].roundTrips.begin(),
+                        clients[i].roundTrips.end());
+    }
+  loopback.stop();
+  echo.release(loopback);
+  if (roundTrips.empty())
+    return ;
+  std::sort(roundTrips.begin(), roundTrips.end());
+  samples.push_back(Sample("latency")
+                    .set("clients", count)
+                    .set("requests_per_second", roundTrips.size() / options.seconds)
+                    .set("p50_us", percentile(roundTrips, 0.5))
+                    .set("p90_us", percentile(roundTrips, 0.9))
+                    .set("p99_us", percentile(roundTrips, 0.99))
+                    .set("p999_us", percentile(roundTrips, 0.999))
+                    .set("max_us", roundTrips.back() * 1e6));
+}
+
+void runLatency(Options const& options, Samples& samples)
+{
+  for (size_t clients = 1; clients <= options.maxClients; clients *= 2)
+    run(options, clients, samples);
+}
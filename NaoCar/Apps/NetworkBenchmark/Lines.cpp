@@ -0,0 +1,148 @@
+//
+// Lines.cpp
+// NaoCar Network Benchmark
+//
+// Measures readUntil() the way the stream server reads the requests of its
+// clients: each client sends lines of 64 bytes as fast as it can, and the
+// server reads them one by one.
+//
+
+#include <atomic>
+#include <mutex>
+
+#include "Benchmark.hpp"
+#include "Network/ITcpServerDelegate.h"
+#include "Network/ITcpSocketDelegate.h"
+
+static const size_t lineSize = 64;
+
+class LineReader : public Network::ITcpServerDelegate,
+                   public Network::ITcpSocketDelegate
+{
+public:
+  LineReader() : _sockets(), _socketsMutex(), _lines(0), _bytes(0)
+  {
+  }
+
+  //! Gives the sockets back, once the server is stopped
+  void release(Loopback& loopback)
+  {
+    for (size_t i = 0; i < _sockets.size(); ++i)
+      loopback.release(_sockets[i]);
+    _sockets.clear();
+  }
+
+  uint64_t lines() const
+  {
+    return _lines.load();
+  }
+
+  uint64_t bytes() const
+  {
+    return _bytes.load();
+  }
+
+  virtual void newConnection(Network::ATcpServer*, Network::ATcpSocket* socket)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_socketsMutex);
+      _sockets.push_back(socket);
+    }
+    socket->setDelegate(this);
+    socket->readUntil("\n");
+  }
+
+  virtual void connected(Network::ASocket*, Network::ASocket::Error)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket*, Network::ASocket::Error, size_t)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket* sender,
+                            Network::ASocket::Error error,
+                            Network::ASocket::Buffer const& line)
+  {
+    if (error)
+      return ;
+    _lines.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add(line.size, std::memory_order_relaxed);
+    static_cast<Network::ATcpSocket*>(sender)->readUntil("\n");
+  }
+
+  virtual void writeFinished(Network::ASocket*, Network::ASocket::Error, size_t)
+  {
+  }
+
+private:
+  std::vector<Network::ATcpSocket*> _sockets;
+  std::mutex                        _socketsMutex;
+  std::atomic<uint64_t>             _lines;
+  std::atomic<uint64_t>             _bytes;
+};
+
+//! Writes blocks of lines until the connection is shut down
+static void sendLines(boost::asio::ip::tcp::socket* socket)
+{
+  std::vector<char> block(1024 * lineSize, 'x');
+  boost::system::error_code error;
+
+  for (size_t i = lineSize - 1; i < block.size(); i += lineSize)
+    block[i] = '\n';
+  while (!error)
+    boost::asio::write(*socket, boost::asio::buffer(block), error);
+}
+
+static void run(Options const& options, size_t clients, Samples& samples)
+{
+  Loopback loopback(options.threads, options.backend);
+  boost::asio::io_service client;
+  LineReader reader;
+  std::vector<boost::asio::ip::tcp::socket*> sockets;
+  std::vector<boost::thread*> senders;
+
+  loopback.server().setDelegate(&reader);
+  if (!loopback.start())
+    return ;
+  for (size_t i = 0; i < clients; ++i)
+    {
+      sockets.push_back(connectClient(client, loopback));
+      senders.push_back(new boost::thread(&sendLines, sockets.back()));
+    }
+
+  measure(0.2);
+  double start = now();
+  uint64_t lines = reader.lines();
+  uint64_t bytes = reader.bytes();
+  measure(options.seconds);
+  double elapsed = now() - start;
+  lines = reader.lines() - lines;
+  bytes = reader.bytes() - bytes;
+
+  for (size_t i = 0; i < sockets.size(); ++i)
+    {
+      boost::system::error_code error;
+      sockets[i]->shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+    }
+  for (size_t i = 0; i < senders.size(); ++i)
+    {
+      senders[i]->join();
+      delete senders[i];
+      delete sockets[i];
+    }
+  loopback.stop();
+  reader.release(loopback);
+  samples.push_back(Sample("lines")
+                    .set("clients", clients)
+                    .set("line_bytes", lineSize)
+                    .set("lines_per_second", lines / elapsed)
+                    .set("mb_per_second", bytes / elapsed / 1e6));
+}
+
+void runLines(Options const& options, Samples& samples)
+{
+  run(options, 1, samples);
+  if (options.maxClients > 1)
+    run(options, options.maxClients < 8 ? options.maxClients : 8, samples);
+}
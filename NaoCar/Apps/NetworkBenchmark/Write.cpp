@@ -0,0 +1,136 @@
+//
+// Write.cpp
+// NaoCar Network Benchmark
+//
+// Measures write() with payloads from 1 KB to 1 MB: the server keeps a few
+// writes queued on the socket of a single client, which drops what it
+// reads. The payload is not copied, only the socket is measured.
+//
+
+#include <atomic>
+
+#include "Benchmark.hpp"
+#include "Network/ITcpServerDelegate.h"
+#include "Network/ITcpSocketDelegate.h"
+
+//! Writes queued on the socket at any time
+static const size_t writesInFlight = 4;
+
+class Writer : public Network::ITcpServerDelegate,
+               public Network::ITcpSocketDelegate
+{
+public:
+  Writer(size_t size) :
+    _payload(size, 'x'), _socket(NULL), _written(0), _writes(0), _stop(false)
+  {
+  }
+
+  //! Gives the socket back, once the server is stopped
+  void release(Loopback& loopback)
+  {
+    if (_socket)
+      loopback.release(_socket);
+    _socket = NULL;
+  }
+
+  uint64_t written() const
+  {
+    return _written.load();
+  }
+
+  uint64_t writes() const
+  {
+    return _writes.load();
+  }
+
+  void stop()
+  {
+    _stop = true;
+  }
+
+  virtual void newConnection(Network::ATcpServer*, Network::ATcpSocket* socket)
+  {
+    _socket = socket;
+    socket->setDelegate(this);
+    for (size_t i = 0; i < writesInFlight; ++i)
+      socket->write(&_payload[0], _payload.size());
+  }
+
+  virtual void connected(Network::ASocket*, Network::ASocket::Error)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket*, Network::ASocket::Error, size_t)
+  {
+  }
+
+  virtual void readFinished(Network::ASocket*, Network::ASocket::Error,
+                            Network::ASocket::Buffer const&)
+  {
+  }
+
+  virtual void writeFinished(Network::ASocket* sender,
+                             Network::ASocket::Error error,
+                             size_t bytesWritten)
+  {
+    if (error)
+      return ;
+    _written.fetch_add(bytesWritten, std::memory_order_relaxed);
+    _writes.fetch_add(1, std::memory_order_relaxed);
+    if (!_stop)
+      sender->write(&_payload[0], _payload.size());
+  }
+
+private:
+  std::vector<char>       _payload;
+  Network::ATcpSocket*    _socket;
+  std::atomic<uint64_t>   _written;
+  std::atomic<uint64_t>   _writes;
+  std::atomic<bool>       _stop;
+};
+
+static void drain(boost::asio::ip::tcp::socket* socket)
+{
+  std::vector<char> buffer(256 * 1024);
+  boost::system::error_code error;
+
+  while (!error)
+    socket->read_some(boost::asio::buffer(buffer), error);
+}
+
+void runWrite(Options const& options, Samples& samples)
+{
+  for (size_t size = 1024; size <= 1024 * 1024; size *= 4)
+    {
+      Loopback loopback(options.threads, options.backend);
+      boost::asio::io_service client;
+      Writer writer(size);
+
+      loopback.server().setDelegate(&writer);
+      if (!loopback.start())
+        return ;
+      boost::asio::ip::tcp::socket* socket = connectClient(client, loopback);
+      boost::thread reader(&drain, socket);
+
+      measure(0.2);
+      double start = now();
+      uint64_t written = writer.written();
+      uint64_t writes = writer.writes();
+      measure(options.seconds);
+      double elapsed = now() - start;
+      written = writer.written() - written;
+      writes = writer.writes() - writes;
+
+      writer.stop();
+      boost::system::error_code error;
+      socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+      reader.join();
+      delete socket;
+      loopback.stop();
+      writer.release(loopback);
+      samples.push_back(Sample("write")
+                        .set("payload_bytes", size)
+                        .set("writes_per_second", writes / elapsed)
+                        .set("mb_per_second", written / elapsed / 1e6));
+    }
+}
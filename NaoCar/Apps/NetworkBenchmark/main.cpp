@@ -0,0 +1,247 @@
+//
+// main.cpp
+// NaoCar Network Benchmark
+//
+// Loopback benchmarks of the Network layer, the path every command and
+// frame of the remote server takes. The results are written to stdout as
+// JSON, the progress to stderr.
+//
+// Usage: NetworkBenchmark [--seconds S] [--threads N] [--clients N]
+//                         [--backend boost|uring]
+//                         [lines] [write] [accept] [latency] [fanout]
+//
+//   lines    readUntil() throughput, lines of 64 bytes
+//   write    write() throughput, 1 KB to 1 MB payloads
+//   accept   connections accepted per second
+//   latency  request/response round trip percentiles, 1 to N clients
+//   fanout   stream fan-out throughput, 1 to N threads
+//
+// All of them run when none is given. The uring backend is built with
+// NETWORK_WITH_URING, and runs the server in a single thread.
+//
+
+#include <boost/bind.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "Benchmark.hpp"
+
+Loopback::Loopback(unsigned int threads, std::string const& backend) :
+  _ioService(),
+#ifdef NETWORK_HAVE_URING
+  _uringService(NULL),
+#endif
+  _server(NULL), _threads(threads), _pool()
+{
+#ifdef NETWORK_HAVE_URING
+  if (backend == "uring")
+    {
+      _uringService = new Network::UringService();
+      _server = new Network::UringTcpServer(_uringService);
+      return ;
+    }
+#endif
+  (void)backend;
+  _server = new Network::BoostTcpServer(&_ioService);
+}
+
+Loopback::~Loopback()
+{
+  stop();
+  // Runs the aborted operations of the released sockets
+  Network::BoostTcpServer::drain(&_ioService);
+  delete _server;
+#ifdef NETWORK_HAVE_URING
+  delete _uringService;
+#endif
+}
+
+boost::asio::io_service* Loopback::ioService()
+{
+  return &_ioService;
+}
+
+Network::ATcpServer& Loopback::server()
+{
+  return *_server;
+}
+
+#ifdef NETWORK_HAVE_URING
+Network::UringService* Loopback::uringService()
+{
+  return _uringService;
+}
+#endif
+
+boost::asio::ip::tcp::endpoint Loopback::endpoint() const
+{
+  return boost::asio::ip::tcp::endpoint
+    (boost::asio::ip::address::from_string("127.0.0.1"), _server->getPort());
+}
+
+bool Loopback::start()
+{
+  if (!_server->listen(0, "127.0.0.1"))
+    return false;
+#ifdef NETWORK_HAVE_URING
+  if (_uringService)
+    return _uringService->start();
+#endif
+  for (unsigned int i = 0; i < _threads; ++i)
+    _pool.push_back(new boost::thread(boost::bind(&boost::asio::io_service::run,
+                                                  &_ioService)));
+  return true;
+}
+
+void Loopback::stop()
+{
+#ifdef NETWORK_HAVE_URING
+  if (_uringService)
+    _uringService->stop();
+#endif
+  _ioService.stop();
+  for (size_t i = 0; i < _pool.size(); ++i)
+    {
+      _pool[i]->join();
+      delete _pool[i];
+    }
+  _pool.clear();
+  _server->close();
+}
+
+void Loopback::release(Network::ATcpSocket* socket)
+{
+  // The delegate may be destroyed before the io_service is drained
+  socket->setDelegate(NULL);
+#ifdef NETWORK_HAVE_URING
+  // Its service is stopped, the socket may be destroyed
+  if (_uringService)
+    {
+      delete socket;
+      return ;
+    }
+#endif
+  _server->release(socket);
+}
+
+bool isBackendAvailable(std::string const& backend)
+{
+  if (backend == "boost")
+    return true;
+#ifdef NETWORK_HAVE_URING
+  if (backend == "uring")
+    return Network::UringService::isSupported();
+#endif
+  return false;
+}
+
+double now()
+{
+  static const boost::posix_time::ptime epoch =
+    boost::posix_time::microsec_clock::universal_time();
+
+  return (boost::posix_time::microsec_clock::universal_time() - epoch)
+    .total_microseconds() / 1e6;
+}
+
+void measure(double seconds)
+{
+  boost::this_thread::sleep(boost::posix_time::microseconds((long)(seconds * 1e6)));
+}
+
+boost::asio::ip::tcp::socket* connectClient(boost::asio::io_service& ioService,
+                                            Loopback const& loopback)
+{
+  boost::asio::ip::tcp::socket* socket = new boost::asio::ip::tcp::socket(ioService);
+
+  socket->connect(loopback.endpoint());
+  socket->set_option(boost::asio::ip::tcp::no_delay(true));
+  return socket;
+}
+
+static void writeJson(Options const& options, Samples const& samples)
+{
+  printf("{\n  \"cores\": %u,\n  \"threads\": %u,\n  \"seconds\": %g,\n"
+         "  \"backend\": \"%s\",\n  \"samples\": [\n",
+         boost::thread::hardware_concurrency(), options.threads, options.seconds,
+         options.backend.c_str());
+  for (size_t i = 0; i < samples.size(); ++i)
+    {
+      printf("    {\"benchmark\": \"%s\"", samples[i].benchmark.c_str());
+      for (size_t j = 0; j < samples[i].values.size(); ++j)
+        printf(", \"%s\": %.10g", samples[i].values[j].first.c_str(),
+               samples[i].values[j].second);
+      printf("}%s\n", i + 1 < samples.size() ? "," : "");
+    }
+  printf("  ]\n}\n");
+}
+
+int main(int ac, char** av)
+{
+  static const char* names[] = { "lines", "write", "accept", "latency", "fanout" };
+  static void (*const benchmarks[])(Options const&, Samples&) =
+    { &runLines, &runWrite, &runAccept, &runLatency, &runFanOut };
+  static const size_t count = sizeof(names) / sizeof(*names);
+  Options options;
+  bool selected[count] = { false };
+  bool any = false;
+  Samples samples;
+
+  options.seconds = 1;
+  options.threads = boost::thread::hardware_concurrency();
+  options.maxClients = 64;
+  options.backend = "boost";
+  for (int i = 1; i < ac; ++i)
+    {
+      std::string arg(av[i]);
+      size_t j;
+
+      if (arg == "--seconds" && i + 1 < ac)
+        options.seconds = atof(av[++i]);
+      else if (arg == "--threads" && i + 1 < ac)
+        options.threads = atoi(av[++i]);
+      else if (arg == "--clients" && i + 1 < ac)
+        options.maxClients = atoi(av[++i]);
+      else if (arg == "--backend" && i + 1 < ac)
+        options.backend = av[++i];
+      else
+        {
+          for (j = 0; j < count && arg != names[j]; ++j)
+            ;
+          if (j == count)
+            {
+              std::cerr << "Usage: " << av[0]
+                        << " [--seconds S] [--threads N] [--clients N]"
+                        << " [--backend boost|uring]"
+                        << " [lines] [write] [accept] [latency] [fanout]"
+                        << std::endl;
+              return (1);
+            }
+          selected[j] = true;
+          any = true;
+        }
+    }
+  if (options.seconds <= 0)
+    options.seconds = 1;
+  if (options.threads == 0)
+    options.threads = 1;
+  if (options.maxClients == 0)
+    options.maxClients = 1;
+  if (!isBackendAvailable(options.backend))
+    {
+      std::cerr << "Backend " << options.backend
+                << " is not built or not supported" << std::endl;
+      return (1);
+    }
+  for (size_t i = 0; i < count; ++i)
+    if (!any || selected[i])
+      {
+        std::cerr << names[i] << "..." << std::endl;
+        benchmarks[i](options, samples);
+      }
+  writeJson(options, samples);
+  return (0);
+}
@@ -19,7 +19,7 @@ Remote::Remote()
   : _mainWindow(this),
     _bonjour(this), _naoAvailable(false), _naoUrl(), _networkManager(),
     _connected(false), _streamSocket(new QTcpSocket(this)),
-    _streamImageSize(-1), _streamImage(new QImage()), _streamSizeRead(false) {
+    _streamDecoder(), _streamImage(new QImage()) {
   // Launch Bonjour to automatically detect Nao on a local network
   if (!_bonjour.browseServices("_http._tcp")) {
     std::cerr << "Cannot browse Bonjour services" << std::endl;
@@ -28,6 +28,8 @@ Remote::Remote()
   QObject::connect(&_networkManager, SIGNAL(finished(QNetworkReply*)),
 		   this, SLOT(networkRequestFinished(QNetworkReply*)));
   _naoUrl.setScheme("http");
+  QObject::connect(_streamSocket, SIGNAL(connected()),
+		   this, SLOT(streamConnected()));
   QObject::connect(_streamSocket, SIGNAL(readyRead()),
 		   this, SLOT(streamDataAvailable()));
   _streamImage->load(":/waiting-streaming.png");
@@ -174,17 +176,13 @@ void Remote::networkRequestFinished(QNetworkReply* reply) {
   }
 }
 
+void Remote::streamConnected() {
+  // Asks for the H.264 stream if it can be decoded, JPEG otherwise
+  _streamDecoder.reset();
+  _streamSocket->write(StreamDecoder::codecRequest());
+}
+
 void Remote::streamDataAvailable() {
-  if (_streamSizeRead == false &&
-      (quint64)_streamSocket->bytesAvailable() >= sizeof(_streamImageSize)) {
-    _streamSocket->read((char*)&_streamImageSize, sizeof(_streamImageSize));
-    _streamSizeRead = true;
-  }
-  if (_streamSizeRead == true &&
-      _streamSocket->bytesAvailable() >= _streamImageSize) {
-    QByteArray data = _streamSocket->read(_streamImageSize);
-    _streamImage->loadFromData(data);
+  if (_streamDecoder.read(_streamSocket, *_streamImage))
     _mainWindow.setStreamImage(_streamImage);
-    _streamSizeRead = false;
-  }
 }
@@ -18,6 +18,7 @@
 # include "MainWindowDelegate.hpp"
 # include "Bonjour.hpp"
 # include "BonjourDelegate.hpp"
+# include "StreamDecoder.hpp"
 
 # define NAOCAR_BONJOUR_SERVICE_NAME "nao-car"
 
@@ -63,6 +64,7 @@ public slots:
   void networkRequestFinished(QNetworkReply* reply);
 
 private slots:
+  void streamConnected();
   void streamDataAvailable();
 
 private:
@@ -73,9 +75,8 @@ private:
   QNetworkAccessManager	_networkManager;
   bool			_connected;
   QTcpSocket		*_streamSocket;
-  qint64		_streamImageSize;
+  StreamDecoder		_streamDecoder;
   QImage		*_streamImage;
-  bool			_streamSizeRead;
 };
 
 #endif
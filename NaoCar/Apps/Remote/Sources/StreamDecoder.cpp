@@ -0,0 +1,154 @@
+//
+// StreamDecoder.cpp
+// NaoCar Remote
+//
+
+#include "StreamDecoder.hpp"
+
+#include <QDebug>
+
+#ifdef REMOTE_HAVE_H264
+extern "C" {
+# include <libavcodec/avcodec.h>
+# include <libswscale/swscale.h>
+}
+#endif
+
+// Size prefix of the legacy framing
+static const qint64 legacyHeaderSize = 8;
+
+StreamDecoder::StreamDecoder()
+  : _tagged(false), _headerRead(false), _header(), _context(NULL),
+    _frame(NULL), _packet(NULL), _scale(NULL), _buffer() {
+}
+
+StreamDecoder::~StreamDecoder() {
+  reset();
+}
+
+const char* StreamDecoder::codecRequest() {
+#ifdef REMOTE_HAVE_H264
+  return "codec h264\n";
+#else
+  return "codec jpeg\n";
+#endif
+}
+
+void StreamDecoder::reset() {
+  _tagged = false;
+  _headerRead = false;
+#ifdef REMOTE_HAVE_H264
+  // The next connection starts a new H.264 stream
+  sws_freeContext(_scale);
+  av_packet_free(&_packet);
+  av_frame_free(&_frame);
+  avcodec_free_context(&_context);
+  _scale = NULL;
+#endif
+}
+
+bool StreamDecoder::read(QIODevice* device, QImage& image) {
+  bool decoded = false;
+
+  for (;;) {
+    if (!_headerRead) {
+      char data[streamHeaderSize];
+      qint64 available = device->bytesAvailable();
+
+      if (available < legacyHeaderSize)
+	break ;
+      device->peek(data, legacyHeaderSize);
+      // Frames sent before the codec request was read are size prefixed
+      if (!_tagged && (streamLoad(data, 2) != streamMagic
+		       || streamLoad(data + 2, 1) != streamVersion)) {
+	device->read(data, legacyHeaderSize);
+	_header.codec = StreamCodecJpeg;
+	_header.flags = streamKeyframe;
+	_header.size = (uint32_t)streamLoad(data, legacyHeaderSize);
+      } else {
+	if (available < (qint64)streamHeaderSize)
+	  break ;
+	device->read(data, streamHeaderSize);
+	if (!decodeStreamHeader(data, _header)) {
+	  qDebug() << "Invalid stream frame";
+	  device->close();
+	  return decoded;
+	}
+	_tagged = true;
+      }
+      _headerRead = true;
+    }
+    if (device->bytesAvailable() < _header.size)
+      break ;
+    QByteArray payload = device->read(_header.size);
+    _headerRead = false;
+    // Every H.264 frame is decoded, the next ones refer to it
+    if (_decode(_header.codec, payload, image))
+      decoded = true;
+  }
+  return decoded;
+}
+
+bool StreamDecoder::_decode(uint8_t codec, QByteArray const& payload,
+			    QImage& image) {
+  if (codec == StreamCodecJpeg)
+    return image.loadFromData((const uchar*)payload.constData(),
+			      payload.size(), "JPEG");
+  if (codec == StreamCodecH264)
+    return _decodeH264(payload, image);
+  return false;
+}
+
+bool StreamDecoder::_decodeH264(QByteArray const& payload, QImage& image) {
+#ifdef REMOTE_HAVE_H264
+  bool decoded = false;
+
+  if (_context == NULL) {
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+
+    if (codec == NULL)
+      return false;
+    _context = avcodec_alloc_context3(codec);
+    // Each frame is shown as soon as it is received: no frame threads,
+    // which would hold frames back
+    _context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    _context->thread_type = FF_THREAD_SLICE;
+    if (avcodec_open2(_context, codec, NULL) < 0) {
+      avcodec_free_context(&_context);
+      return false;
+    }
+    _frame = av_frame_alloc();
+    _packet = av_packet_alloc();
+  }
+  _buffer.assign(payload.constData(), payload.constData() + payload.size());
+  _buffer.resize(payload.size() + AV_INPUT_BUFFER_PADDING_SIZE, 0);
+  _packet->data = &_buffer[0];
+  _packet->size = payload.size();
+  if (avcodec_send_packet(_context, _packet) < 0)
+    return false;
+  while (avcodec_receive_frame(_context, _frame) == 0) {
+    int width = _frame->width;
+    int height = _frame->height;
+
+    _scale = sws_getCachedContext(_scale, width, height,
+				  (AVPixelFormat)_frame->format,
+				  width, height, AV_PIX_FMT_RGB32,
+				  SWS_BILINEAR, NULL, NULL, NULL);
+    if (_scale == NULL)
+      break ;
+    if (image.width() != width || image.height() != height
+	|| image.format() != QImage::Format_RGB32)
+      image = QImage(width, height, QImage::Format_RGB32);
+    uint8_t* planes[1] = { image.bits() };
+    int strides[1] = { image.bytesPerLine() };
+    sws_scale(_scale, _frame->data, _frame->linesize, 0, height,
+	      planes, strides);
+    decoded = true;
+  }
+  return decoded;
+#else
+  (void)payload;
+  (void)image;
+  return false;
+#endif
+}
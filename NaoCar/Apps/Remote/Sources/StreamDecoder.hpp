@@ -0,0 +1,66 @@
+//
+// StreamDecoder.hpp
+// NaoCar Remote
+//
+
+#ifndef _STREAM_DECODER_HPP_
+# define _STREAM_DECODER_HPP_
+
+# include <QByteArray>
+# include <QIODevice>
+# include <QImage>
+
+# include <vector>
+
+# include "StreamProtocol.hpp"
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+//! Reads the frames of the stream server and decodes them
+/*!
+ Frames are in the legacy framing, a size and a JPEG, until the server
+ answers the codec request: then each starts with a StreamHeader. H.264 is
+ decoded with libavcodec when the client is built with REMOTE_HAVE_H264,
+ JPEG is requested otherwise.
+ */
+class StreamDecoder {
+public:
+  StreamDecoder();
+  ~StreamDecoder();
+
+  //! The line to send once connected, asking for the best codec decoded
+  static const char* codecRequest();
+
+  //! Forgets the frames of the previous connection
+  void reset();
+
+  //! Reads the complete frames of device
+  /*!
+   \return true if image has been replaced by a new frame
+   */
+  bool read(QIODevice* device, QImage& image);
+
+private:
+  StreamDecoder(StreamDecoder const&);
+  StreamDecoder& operator=(StreamDecoder const&);
+
+  bool _decode(uint8_t codec, QByteArray const& payload, QImage& image);
+  bool _decodeH264(QByteArray const& payload, QImage& image);
+
+  //! A StreamHeader has been received, frames are not size prefixed
+  bool		_tagged;
+  //! _header is the one of the frame being received
+  bool		_headerRead;
+  StreamHeader	_header;
+  AVCodecContext*	_context;
+  AVFrame*		_frame;
+  AVPacket*		_packet;
+  SwsContext*		_scale;
+  //! Payload followed by the padding libavcodec reads past it
+  std::vector<uint8_t>	_buffer;
+};
+
+#endif
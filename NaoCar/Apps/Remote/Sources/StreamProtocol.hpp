@@ -0,0 +1,93 @@
+//
+// StreamProtocol.hpp
+// NaoCar Remote
+//
+
+#ifndef __STREAM_PROTOCOL_HPP__
+# define __STREAM_PROTOCOL_HPP__
+
+# include <cstring>
+# include <stdint.h>
+
+//! Stream protocol
+/*!
+ A client connects to the stream port (given by the /get-stream-port
+ command) and receives the frames of the camera. By default each frame is
+ a JPEG prefixed by its size, as a little-endian uint64.
+
+ A client may send a line "codec <name>\n", name being "jpeg" or "h264".
+ Every frame written afterwards starts with a header telling its codec:
+
+ Header layout, 12 bytes, little-endian:
+   0  uint16  magic, streamMagic
+   2  uint8   version, streamVersion
+   3  uint8   codec, a StreamCodec
+   4  uint32  flags, streamKeyframe if the frame decodes on its own
+   8  uint32  size of the payload which follows
+
+ The server may answer a codec it cannot encode with another one: the
+ codec of each frame is the one to decode. OpenCV views are always JPEG.
+ H.264 payloads are access units in Annex B byte stream format; the first
+ one sent to a client is a keyframe, along with its parameter sets.
+ */
+
+static const uint16_t   streamMagic = 0x534e;
+static const uint8_t    streamVersion = 1;
+static const size_t     streamHeaderSize = 12;
+
+enum StreamCodec {
+    StreamCodecJpeg = 0,
+    StreamCodecH264
+};
+
+static const uint32_t   streamKeyframe = 1;
+
+struct StreamHeader {
+    uint8_t     codec;
+    uint32_t    flags;
+    uint32_t    size;
+};
+
+//! Name of the codec in a "codec" line, NULL if unknown
+inline const char*  streamCodecName(uint8_t codec) {
+    switch (codec) {
+    case StreamCodecJpeg: return "jpeg";
+    case StreamCodecH264: return "h264";
+    default: return NULL;
+    }
+}
+
+//! Stores the size low bytes of value at out, little-endian
+inline void     streamStore(char* out, uint64_t value, int size) {
+    for (int byte = 0; byte < size; ++byte)
+        out[byte] = (char)(value >> (8 * byte));
+}
+
+//! Loads a little-endian integer of size bytes
+inline uint64_t streamLoad(const char* in, int size) {
+    uint64_t value = 0;
+
+    for (int byte = size - 1; byte >= 0; --byte)
+        value = (value << 8) | (unsigned char)in[byte];
+    return value;
+}
+
+inline void     encodeStreamHeader(StreamHeader const& header, char* out) {
+    streamStore(out, streamMagic, 2);
+    streamStore(out + 2, streamVersion, 1);
+    streamStore(out + 3, header.codec, 1);
+    streamStore(out + 4, header.flags, 4);
+    streamStore(out + 8, header.size, 4);
+}
+
+//! Returns false if in does not start with the protocol magic and version
+inline bool     decodeStreamHeader(const char* in, StreamHeader& header) {
+    if (streamLoad(in, 2) != streamMagic || streamLoad(in + 2, 1) != streamVersion)
+        return false;
+    header.codec = (uint8_t)streamLoad(in + 3, 1);
+    header.flags = (uint32_t)streamLoad(in + 4, 4);
+    header.size = (uint32_t)streamLoad(in + 8, 4);
+    return true;
+}
+
+#endif
@@ -21,6 +21,7 @@
 
 #include "opencv2/opencv.hpp"
 #include "AutoDrive.hpp"
+#include "Log.hpp"
 
 using namespace cv;
 
@@ -69,7 +70,7 @@ void	AutoDrive::start()
   // _pipeline = gst_parse_launch("udpsrc port=8081 ! smokedec ! ffmpegcolorspace ! video/x-raw-rgb ! appsink", &error);
 
   if (!_pipeline || error) {
-    std::cerr << "Cannot create pipeline" << std::endl;
+    LOG_ERROR("Cannot create pipeline");
     return ;
   }
 
@@ -404,9 +405,8 @@ int		AutoDrive::thread()
       getNextState(state, direction, total);
     if (total == 0 && state == Up)
       state = Stop;
-    std::cout << "TOTAL " << total << std::endl;
-    std::cout << state << std::endl;
-    std::cout << direction << std::endl;
+    LOG_DEBUG("TOTAL " << total << " state " << state
+              << " direction " << direction);
 
     if (direction == Right)
       _proxy->turnRight();
@@ -622,7 +622,7 @@ void AutoDrive::getNextState(State &state, Direction &direction, double value)
       else
 	{
 	  clock_t end = clock();
-	  std::cout << "TIMER :" << ((double)end - start) / CLOCKS_PER_SEC << std::endl;
+	  LOG_DEBUG("TIMER :" << ((double)end - start) / CLOCKS_PER_SEC);
 	  if (((double)end - start) / CLOCKS_PER_SEC > 3.0)
 	    {
 	      isStart = false;
@@ -20,6 +20,7 @@
 #include <alcommon/altoolsmain.h>
 
 #include "Drive.hpp"
+#include "Log.hpp"
 
 #ifdef NAO_LOCAL_COMPILATION
 # define POSE_DIR "/home/nao/modules/Poses/"
@@ -62,7 +63,8 @@ std::map<std::string, Drive::Anim>	Drive::_animations =
 
 Drive::Drive(boost::shared_ptr<AL::ALBroker> broker,
 	     const std::string &name) :
-  AL::ALModule(broker, name), _poseManager(broker), _animThread(NULL), _voiceSpeaker(broker)
+  AL::ALModule(broker, name), _poseManager(broker), _animThread(NULL), _voiceSpeaker(broker),
+  _memory(broker), _publishMutex(), _publishedState()
 {
   setModuleDescription("The NaoCar Driving Module");
   functionName("begin", getName(), "Set the nao ready for starting");
@@ -140,6 +142,8 @@ void	Drive::init()
 
 void	Drive::begin()
 {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Vegetative) {
     _stopThread = false;
 
@@ -157,6 +161,8 @@ void	Drive::begin()
 
 void	Drive::end()
 {
+  StatePublisher	publisher(this);
+
   _stopThread = true;
   if (_animThread)
     {
@@ -172,6 +178,8 @@ void	Drive::end()
 
 void	Drive::goFrontwards()
 {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Ready && 
       _currentState.direction == Forward) {
     addAnim("TakeSteeringWheel");
@@ -215,6 +223,8 @@ void	Drive::goFrontwards()
 
 void	Drive::goBackwards()
 {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Ready && 
       _currentState.direction == Backward) {
     addAnim("TakeSteeringWheel");
@@ -258,6 +268,8 @@ void	Drive::goBackwards()
 
 void	Drive::turnLeft()
 {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Ready) {
     addAnim("TakeSteeringWheel");
     addAnim("TurnLeft");
@@ -274,6 +286,8 @@ void	Drive::turnLeft()
 
 void	Drive::turnRight()
 {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Ready
 ) {
     addAnim("TakeSteeringWheel");
@@ -291,6 +305,8 @@ void	Drive::turnRight()
 
 void	Drive::turnFront()
 {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Ready) {
     addAnim("TakeSteeringWheel");
     addAnim("TurnFront");
@@ -307,11 +323,15 @@ void	Drive::turnFront()
 
 void	Drive::stop()
 {
+  StatePublisher	publisher(this);
+
   addAnim("ReleaseGasPedal");
   _currentState.pedal = Released;
 }
 
 void	Drive::steeringWheelAction() {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Ready) {
     addAnim("TakeSteeringWheel");
     _currentState.position = DrivingFront;
@@ -323,6 +343,8 @@ void	Drive::steeringWheelAction() {
 }
 
 void	Drive::funAction() {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == DrivingFront) {
     addAnim("ReleaseSteeringWheel");
     addAnim("BeginNoHand");
@@ -337,6 +359,8 @@ void	Drive::funAction() {
 }
 
 void	Drive::carambarAction() {
+  StatePublisher	publisher(this);
+
   if (_currentState.pedal == Pushed)
     return;
   if (_currentState.position == DrivingFront ||
@@ -366,6 +390,8 @@ void	Drive::carambarAction() {
 }
 
 void	Drive::upShift() {
+  StatePublisher	publisher(this);
+
   if (_currentState.direction == Forward)
     return;
 
@@ -392,6 +418,8 @@ void	Drive::upShift() {
 }
 
 void	Drive::downShift() {
+  StatePublisher	publisher(this);
+
   if (_currentState.direction == Backward)
     return;
 
@@ -418,6 +446,8 @@ void	Drive::downShift() {
 }
 
 void	Drive::pushPedal() {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Vegetative)
     return;
   addAnim("PushGasPedal");
@@ -425,6 +455,8 @@ void	Drive::pushPedal() {
 }
 
 void	Drive::releasePedal() {
+  StatePublisher	publisher(this);
+
   if (_currentState.position == Vegetative)
     return;
   addAnim("ReleaseGasPedal");
@@ -493,6 +525,8 @@ void	Drive::animThread()
 
   while (_stopThread == false || _isAnimating == true)
     {
+      bool wasAnimating = _isAnimating;
+
       move = true;
       _animListMutex.lock();
       if (_animList.size() == 0)
@@ -515,10 +549,14 @@ void	Drive::animThread()
 	  move = true;
 	}
       _animListMutex.unlock();
+      if (wasAnimating != _isAnimating)
+	_publishState();
       if (move == true)
 	{
-	  std::cout << "Launching : " << current << std::endl;
+	  LOG_DEBUG("Launching : " << current);
 	  launch(current);
+	  // Pedal animations update the state
+	  _publishState();
 	}
       else
 	usleep(1000);
@@ -551,6 +589,30 @@ void	Drive::launch(std::string const& name)
     }
 }
 
+void	Drive::_publishState()
+{
+  int	state[] = {
+    isGasPedalPushed(),
+    isSteeringWheelTaken(),
+    steeringWheelDirection(),
+    speed(),
+    isAnimating()
+  };
+  std::vector<int>	value(state, state + sizeof(state) / sizeof(*state));
+  std::lock_guard<std::mutex>	lock(_publishMutex);
+
+  if (value == _publishedState)
+    return;
+  _publishedState = value;
+  try
+    {
+      _memory.raiseEvent(DRIVE_STATE_EVENT, value);
+    }
+  catch (...)
+    {
+    }
+}
+
 void	Drive::addAnim(std::string const& name)
 {
   _animListMutex.lock();
@@ -14,6 +14,7 @@
 # include <map>
 
 # include <alcommon/almodule.h>
+# include <alproxies/almemoryproxy.h>
 # include <PoseManager.hpp>
 # include <Animation.hpp>
 # include <atomic>
@@ -22,6 +23,15 @@
 
 # include "VoiceSpeaker.hpp"
 
+//! ALMemory event raised when the observable state of the car changes
+/*!
+ Its value is an array of ints: gas pedal pushed, steering wheel taken,
+ steering wheel direction, speed and animating.
+ */
+# ifndef DRIVE_STATE_EVENT
+#  define DRIVE_STATE_EVENT "NaoCarDriveState"
+# endif
+
 namespace AL
 {
   class ALBroker;
@@ -107,6 +117,17 @@ private:
   void	launch(std::string const& name);
   void	addAnim(std::string const& name);
 
+  //! Raises DRIVE_STATE_EVENT if the state changed since the last call
+  void	_publishState();
+
+  //! Publishes the state when an action returns, whatever the path taken
+  struct StatePublisher
+  {
+    StatePublisher(Drive* drive) : _drive(drive) {}
+    ~StatePublisher() { _drive->_publishState(); }
+    Drive*	_drive;
+  };
+
   struct Anim
   {
     Animation   _anim;
@@ -122,6 +143,9 @@ private:
   std::atomic<bool>			_stopThread;
 
   VoiceSpeaker				_voiceSpeaker;
+  AL::ALMemoryProxy			_memory;
+  std::mutex				_publishMutex;
+  std::vector<int>			_publishedState;
 };
 
 #endif
@@ -0,0 +1,274 @@
+//
+// Log.cpp
+// NaoCar Log
+//
+
+#include "Log.hpp"
+
+#include <atomic>
+#include <boost/thread/thread.hpp>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
+#include <time.h>
+
+namespace {
+
+    //! Bounded multi-producer, single-consumer queue of messages
+    /*!
+     Each slot has a sequence number telling whether it is free for the
+     producer at a given position, or filled for the consumer: producers
+     claim a position with a compare-and-swap, then publish the slot.
+     */
+    class Queue {
+    public:
+        static const size_t capacity = 1024;
+
+        struct Slot {
+            std::atomic<size_t> sequence;
+            Log::Level          level;
+            struct timeval      time;
+            size_t              size;
+            char                text[Log::maxMessageSize];
+        };
+
+        Queue() : _enqueuePos(0), _dequeuePos(0) {
+            for (size_t i = 0; i < capacity; ++i)
+                _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        bool    push(Log::Level level, const char* text, size_t size) {
+            size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+            Slot* slot;
+
+            for (;;) {
+                slot = &_slots[pos % capacity];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                if (diff == 0) {
+                    if (_enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                          std::memory_order_relaxed))
+                        break ;
+                } else if (diff < 0) {
+                    // Still holds the message queued one lap ago
+                    return false;
+                } else {
+                    pos = _enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            slot->level = level;
+            gettimeofday(&slot->time, NULL);
+            slot->size = size < Log::maxMessageSize ? size : Log::maxMessageSize;
+            memcpy(slot->text, text, slot->size);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        //! Returns the next filled slot, to be released, or NULL
+        Slot*   front() {
+            Slot* slot = &_slots[_dequeuePos % capacity];
+            if (slot->sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+                return NULL;
+            return slot;
+        }
+
+        void    pop() {
+            _slots[_dequeuePos % capacity].sequence.store(_dequeuePos + capacity,
+                                                          std::memory_order_release);
+            ++_dequeuePos;
+        }
+
+        //! Number of messages queued so far
+        size_t  pushed() const {
+            return _enqueuePos.load(std::memory_order_relaxed);
+        }
+
+    private:
+        Slot                _slots[capacity];
+        std::atomic<size_t> _enqueuePos;
+        //! Only used by the consumer
+        size_t              _dequeuePos;
+    };
+
+    class Writer {
+    public:
+        Writer() : _queue(), _dropped(0), _written(0), _stop(false), _thread(NULL) {
+            _thread = new boost::thread(&Writer::_run, this);
+        }
+
+        ~Writer() {
+            _stop = true;
+            _thread->join();
+            delete _thread;
+        }
+
+        bool    write(Log::Level level, const char* text, size_t size) {
+            if (_queue.push(level, text, size))
+                return true;
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        void    flush() {
+            size_t target = _queue.pushed();
+
+            while (_written.load(std::memory_order_acquire) < target && !_stop)
+                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+    private:
+        void    _run() {
+            size_t written = 0;
+            bool pending = false;
+
+            for (;;) {
+                Queue::Slot* slot = _queue.front();
+                if (slot != NULL) {
+                    _print(*slot);
+                    _queue.pop();
+                    ++written;
+                    pending = true;
+                    continue ;
+                }
+                // Only flushed when idle: a burst is written at once
+                if (pending) {
+                    fflush(stdout);
+                    fflush(stderr);
+                    pending = false;
+                    _written.store(written, std::memory_order_release);
+                }
+                size_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped > 0)
+                    fprintf(stderr, "[log] %lu messages dropped\n", (unsigned long)dropped);
+                if (_stop)
+                    return ;
+                boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+            }
+        }
+
+        void    _print(Queue::Slot const& slot) {
+            static const char* names[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+            struct tm date;
+            time_t seconds = slot.time.tv_sec;
+
+            localtime_r(&seconds, &date);
+            fprintf(slot.level >= Log::Warning ? stderr : stdout,
+                    "%02d:%02d:%02d.%03d %s %.*s\n",
+                    date.tm_hour, date.tm_min, date.tm_sec,
+                    (int)(slot.time.tv_usec / 1000), names[slot.level],
+                    (int)slot.size, slot.text);
+        }
+
+        Queue               _queue;
+        std::atomic<size_t> _dropped;
+        //! Messages written and flushed
+        std::atomic<size_t> _written;
+        std::atomic<bool>   _stop;
+        boost::thread*      _thread;
+    };
+
+    Writer& writer() {
+        static Writer writer;
+
+        return writer;
+    }
+
+}
+
+bool	Log::write(Level level, const char* text, size_t size) {
+    return writer().write(level, text, size);
+}
+
+void	Log::flush() {
+    writer().flush();
+}
+
+Log::Line::Line(Level level) : _level(level), _size(0) {
+}
+
+Log::Line::~Line() {
+    Log::write(_level, _text, _size);
+}
+
+Log::Line&	Log::Line::operator<<(const char* value) {
+    if (value == NULL)
+        value = "(null)";
+    _append(value, strlen(value));
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(std::string const& value) {
+    _append(value.data(), value.size());
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(char value) {
+    _append(&value, 1);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(bool value) {
+    // Like an ostream without boolalpha
+    _append(value ? "1" : "0", 1);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(int value) {
+    _format("%d", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(unsigned int value) {
+    _format("%u", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(long value) {
+    _format("%ld", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(unsigned long value) {
+    _format("%lu", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(long long value) {
+    _format("%lld", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(unsigned long long value) {
+    _format("%llu", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(double value) {
+    _format("%g", value);
+    return *this;
+}
+
+Log::Line&	Log::Line::operator<<(const void* value) {
+    _format("%p", value);
+    return *this;
+}
+
+void	Log::Line::_append(const char* data, size_t size) {
+    if (size > maxMessageSize - _size)
+        size = maxMessageSize - _size;
+    memcpy(_text + _size, data, size);
+    _size += size;
+}
+
+void	Log::Line::_format(const char* format, ...) {
+    va_list arguments;
+
+    // Numbers only: the buffer holds them along with the final null byte
+    char buffer[32];
+    va_start(arguments, format);
+    int size = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    if (size > 0)
+        _append(buffer, (size_t)size < sizeof(buffer) ? size : sizeof(buffer) - 1);
+}
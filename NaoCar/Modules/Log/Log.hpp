@@ -0,0 +1,100 @@
+//
+// Log.hpp
+// NaoCar Log
+//
+
+#ifndef __LOG_HPP__
+# define __LOG_HPP__
+
+# include <cstddef>
+# include <stdint.h>
+# include <string>
+
+//! Lowest level compiled in, the messages of lower levels cost nothing
+# ifndef NAOCAR_LOG_LEVEL
+#  define NAOCAR_LOG_LEVEL 1
+# endif
+
+//! Logging shared by the modules
+/*!
+ Messages are formatted in place by the calling thread and queued in a
+ lock-free ring buffer. A background thread writes them to stdout (Debug,
+ Info) or stderr (Warning, Error) and flushes once the queue is empty, so
+ a real-time loop never waits for the terminal. When the queue is full,
+ messages are dropped and counted rather than blocking.
+ */
+namespace Log {
+
+    enum Level {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    //! Maximum size of a message, longer ones are truncated
+    static const size_t maxMessageSize = 200;
+
+    //! Queues a message, never blocks
+    /*!
+     \return false if the queue is full and the message has been dropped
+     */
+    bool    write(Level level, const char* text, size_t size);
+
+    //! Waits until the messages queued so far are written
+    void    flush();
+
+    //! A message being formatted, queued when destroyed
+    /*!
+     Values are formatted without allocation, like an ostream would.
+     */
+    class Line {
+    public:
+        explicit Line(Level level);
+        ~Line();
+
+        Line&   operator<<(const char* value);
+        Line&   operator<<(std::string const& value);
+        Line&   operator<<(char value);
+        Line&   operator<<(bool value);
+        Line&   operator<<(int value);
+        Line&   operator<<(unsigned int value);
+        Line&   operator<<(long value);
+        Line&   operator<<(unsigned long value);
+        Line&   operator<<(long long value);
+        Line&   operator<<(unsigned long long value);
+        Line&   operator<<(double value);
+        Line&   operator<<(const void* value);
+
+    private:
+        Line(Line const&);
+        Line&   operator=(Line const&);
+
+        void    _append(const char* data, size_t size);
+        void    _format(const char* format, ...);
+
+        Level   _level;
+        size_t  _size;
+        char    _text[maxMessageSize];
+    };
+
+}
+
+//! Logs the values streamed in message, e.g. LOG_INFO("port " << port)
+/*!
+ The level is a constant: below NAOCAR_LOG_LEVEL the statement is a dead
+ branch, whose values are never evaluated and which the optimizer removes.
+ It is still compiled, so it must stay valid code.
+ */
+# define LOG_AT(level, message)                         \
+    do {                                                \
+        if ((level) >= NAOCAR_LOG_LEVEL)                \
+            Log::Line(level) << message;                \
+    } while (0)
+
+# define LOG_DEBUG(message)     LOG_AT(Log::Debug, message)
+# define LOG_INFO(message)      LOG_AT(Log::Info, message)
+# define LOG_WARNING(message)   LOG_AT(Log::Warning, message)
+# define LOG_ERROR(message)     LOG_AT(Log::Error, message)
+
+#endif
@@ -0,0 +1,100 @@
+//
+// AssetCache.cpp
+// NaoCar Remote Server
+//
+
+#include "AssetCache.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <stdint.h>
+#include <zlib.h>
+
+AssetCache::AssetCache() : _assets(), _paths() {
+}
+
+AssetCache::~AssetCache() {
+}
+
+bool	AssetCache::load(std::string const& path,
+                         std::string const& file,
+                         std::string const& contentType) {
+    std::ifstream stream(file.c_str(), std::ios::in | std::ios::binary);
+
+    if (!stream.is_open())
+        return false;
+    stream.seekg(0, stream.end);
+    std::streamoff length = stream.tellg();
+    stream.seekg(0, stream.beg);
+    if (length < 0)
+        return false;
+
+    _assets.push_back(Asset());
+    Asset& asset = _assets.back();
+    asset.contentType = contentType;
+    asset.raw.resize(length);
+    if (length > 0 && !stream.read(&asset.raw[0], length)) {
+        _assets.pop_back();
+        return false;
+    }
+    asset.etag = _computeEtag(asset.raw);
+    // Keep serving the raw content if compression fails
+    if (!_compress(asset.raw, asset.gzip))
+        asset.gzip.clear();
+    _paths[path] = &asset;
+    return true;
+}
+
+bool	AssetCache::alias(std::string const& alias, std::string const& path) {
+    Asset const* asset = find(path);
+
+    if (asset == NULL)
+        return false;
+    _paths[alias] = asset;
+    return true;
+}
+
+AssetCache::Asset const*	AssetCache::find(std::string const& path) const {
+    std::map<std::string, Asset const*>::const_iterator it = _paths.find(path);
+
+    if (it == _paths.end())
+        return NULL;
+    return it->second;
+}
+
+bool	AssetCache::_compress(std::vector<char> const& in,
+                              std::vector<char>& out) {
+    z_stream stream;
+
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // 15 + 16: maximum window size with a gzip header and trailer
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED,
+                     15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    out.resize(deflateBound(&stream, in.size()) + 32);
+    stream.next_in = (Bytef*)(in.empty() ? NULL : &in[0]);
+    stream.avail_in = in.size();
+    stream.next_out = (Bytef*)&out[0];
+    stream.avail_out = out.size();
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+std::string	AssetCache::_computeEtag(std::vector<char> const& data) {
+    // 64-bit FNV-1a over the raw content
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (std::vector<char>::const_iterator it = data.begin();
+         it != data.end(); ++it) {
+        hash ^= (unsigned char)*it;
+        hash *= 1099511628211ULL;
+    }
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%016llx-%lx\"",
+             (unsigned long long)hash, (unsigned long)data.size());
+    return etag;
+}
@@ -0,0 +1,62 @@
+//
+// AssetCache.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __ASSET_CACHE_HPP__
+# define __ASSET_CACHE_HPP__
+
+# include <list>
+# include <map>
+# include <string>
+# include <vector>
+
+//! Immutable in-memory cache of the web resources served by RemoteServer
+/*!
+ Every asset is read once, when the module starts, and kept both raw and
+ gzip-compressed along with a strong ETag computed from its content.
+ The cache must be filled before the network threads are started: lookups
+ are then read-only and need no locking.
+ */
+
+class AssetCache {
+public:
+
+    struct Asset {
+        std::string         contentType;
+        std::string         etag;
+        std::vector<char>   raw;
+        std::vector<char>   gzip;
+    };
+
+    AssetCache();
+    ~AssetCache();
+
+    //! Loads the given file and serves it under the given url path
+    /*!
+     \return false if the file cannot be read
+     */
+    bool            load(std::string const& path,
+                         std::string const& file,
+                         std::string const& contentType);
+
+    //! Serves the asset already loaded under path under alias too
+    /*!
+     \return false if nothing is served under path
+     */
+    bool            alias(std::string const& alias, std::string const& path);
+
+    //! Returns the asset served under the given path, or NULL
+    Asset const*    find(std::string const& path) const;
+
+private:
+    static bool     _compress(std::vector<char> const& in,
+                              std::vector<char>& out);
+    static std::string  _computeEtag(std::vector<char> const& data);
+
+    //! A list, so that the assets never move
+    std::list<Asset>                        _assets;
+    std::map<std::string, Asset const*>     _paths;
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include "AutoDriving.hpp"
+#include "Log.hpp"
 
 using namespace cv;
 using namespace std;
@@ -122,12 +123,11 @@ void KinectDevice::DepthCallback(void* data, uint32_t) {
         }
     }
 
-    std::cout << left << " " << middle << " " << right
+    LOG_DEBUG(left << " " << middle << " " << right
               << " push: " << _pushGazPedal << ", dir: "
               << (_bestDirection == Left ? "left"
                                          : _bestDirection == Right ? "right"
-                                                                   : "front")
-              << std::endl;
+                                                                   : "front"));
 
     // Transform depth data to rgb values
     for (int i = 0; i < 640*480; ++i) {
@@ -223,7 +223,7 @@ void KinectDevice::_floorCalibration(uint16_t* depth) {
     if (file.is_open()) {
         file.write((char*)_averages, sizeof(_averages));
         file.write((char*)_deviations, sizeof(_deviations));
-        std::cout << "Floor calibration successfull" << std::endl;
+        LOG_INFO("Floor calibration successfull");
     }
 }
 
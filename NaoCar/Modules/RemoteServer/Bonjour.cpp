@@ -12,6 +12,7 @@
 #include <signal.h>
 
 #include "BonjourDelegate.hpp"
+#include "Log.hpp"
 
 Bonjour::Bonjour(boost::asio::io_service& ioService, BonjourDelegate* delegate)
     : _ioService(ioService), _delegate(delegate), _avahiPid(-1),
@@ -21,7 +22,7 @@ Bonjour::Bonjour(boost::asio::io_service& ioService, BonjourDelegate* delegate)
 Bonjour::~Bonjour(void) {
     if (_avahiPid != -1) {
         kill(_avahiPid, SIGINT);
-        std::cout << "Unregistered Bonjour service" << std::endl;
+        LOG_INFO("Unregistered Bonjour service");
     }
 }
 
@@ -0,0 +1,152 @@
+//
+// Command.cpp
+// NaoCar Remote Server
+//
+
+#include "Command.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static bool urlDecode(const char* in, size_t size,
+                      char* out, size_t outSize, size_t& outLength);
+
+CommandArgs::CommandArgs() : present(0), floats(), ints(), textSize(0) {
+    text[0] = '\0';
+}
+
+bool	CommandArgs::isSet(int param) const {
+    return (present & (1u << param)) != 0;
+}
+
+CommandGroup	getCommandGroup(int command) {
+    switch (command) {
+    case TurnLeftCommand:
+    case TurnRightCommand:
+    case TurnFrontCommand:
+        return SteeringGroup;
+    case GoFrontwardsCommand:
+    case GoBackwardsCommand:
+    case StopCommand:
+        return MotionGroup;
+    case PushPedalCommand:
+    case ReleasePedalCommand:
+        return PedalGroup;
+    case SetHeadCommand:
+        return HeadGroup;
+    default:
+        return NoCommandGroup;
+    }
+}
+
+uint32_t	commandHash(const char* str, size_t size) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    return hash;
+}
+
+bool	parseCommandArgs(const char* query, size_t size,
+                         CommandParam const* params, CommandArgs& args) {
+    for (int i = 0; i < maxCommandParams && params[i].type != CommandParam::None; ++i) {
+        if (params[i].type == CommandParam::Float)
+            args.floats[params[i].slot] = params[i].defaultValue;
+        else if (params[i].type == CommandParam::Int)
+            args.ints[params[i].slot] = (int)params[i].defaultValue;
+    }
+
+    const char* end = query + size;
+    while (query < end) {
+        const char* pairEnd = (const char*)memchr(query, '&', end - query);
+        if (pairEnd == NULL)
+            pairEnd = end;
+        const char* equal = (const char*)memchr(query, '=', pairEnd - query);
+        const char* value = equal ? equal + 1 : pairEnd;
+
+        char key[32];
+        size_t keySize;
+        // Unknown keys are skipped, malformed ones are an error
+        if (!urlDecode(query, (equal ? equal : pairEnd) - query,
+                       key, sizeof(key), keySize))
+            return false;
+        for (int i = 0; i < maxCommandParams
+             && params[i].type != CommandParam::None; ++i) {
+            if (strcmp(params[i].name, key) != 0)
+                continue ;
+            if (params[i].type == CommandParam::Text) {
+                if (!urlDecode(value, pairEnd - value, args.text,
+                               sizeof(args.text), args.textSize))
+                    return false;
+            } else {
+                char number[32];
+                size_t numberSize;
+                char* numberEnd = NULL;
+                if (!urlDecode(value, pairEnd - value, number,
+                               sizeof(number), numberSize))
+                    return false;
+                // An empty value keeps the default one
+                if (numberSize == 0)
+                    break ;
+                if (params[i].type == CommandParam::Float)
+                    args.floats[params[i].slot] = strtod(number, &numberEnd);
+                else
+                    args.ints[params[i].slot] = strtol(number, &numberEnd, 10);
+                // strtod() accepts "nan" and "inf", no command expects them
+                if (*numberEnd != '\0'
+                    || (params[i].type == CommandParam::Float
+                        && !std::isfinite(args.floats[params[i].slot])))
+                    return false;
+            }
+            args.present |= 1u << i;
+            break ;
+        }
+        query = pairEnd + 1;
+    }
+    return true;
+}
+
+bool	setCommandArgs(float const* values, unsigned int present,
+                       CommandParam const* params, CommandArgs& args) {
+    for (int i = 0; i < maxCommandParams && params[i].type != CommandParam::None; ++i) {
+        float value = (present & (1u << i)) ? values[i] : params[i].defaultValue;
+
+        if (!std::isfinite(value))
+            return false;
+        if (params[i].type == CommandParam::Float)
+            args.floats[params[i].slot] = value;
+        else if (params[i].type == CommandParam::Int)
+            args.ints[params[i].slot] = (int)value;
+        else
+            continue ;
+        if (present & (1u << i))
+            args.present |= 1u << i;
+    }
+    return true;
+}
+
+//! Decodes into a null-terminated buffer, truncating to outSize - 1 bytes
+static bool urlDecode(const char* in, size_t size,
+                      char* out, size_t outSize, size_t& outLength)
+{
+    outLength = 0;
+    for (size_t i = 0; i < size; ++i) {
+        char c = in[i];
+
+        if (c == '%') {
+            if (i + 2 >= size || !isxdigit(in[i + 1]) || !isxdigit(in[i + 2]))
+                return false;
+            char hex[3] = { in[i + 1], in[i + 2], '\0' };
+            c = (char)strtol(hex, NULL, 16);
+            i += 2;
+        } else if (c == '+') {
+            c = ' ';
+        }
+        if (outLength + 1 < outSize)
+            out[outLength++] = c;
+    }
+    out[outLength] = '\0';
+    return true;
+}
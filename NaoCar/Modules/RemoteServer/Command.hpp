@@ -0,0 +1,107 @@
+//
+// Command.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __COMMAND_HPP__
+# define __COMMAND_HPP__
+
+# include <cstddef>
+# include <stdint.h>
+
+# include "ControlProtocol.hpp"
+
+//! Commands of a group replace each other
+/*!
+ When several commands of a group are waiting, only the latest one needs
+ to be executed.
+ */
+enum CommandGroup {
+    NoCommandGroup = -1,
+    SteeringGroup,
+    MotionGroup,
+    PedalGroup,
+    HeadGroup,
+    CommandGroupCount
+};
+
+//! Returns the group of the command, NoCommandGroup for unknown commands
+CommandGroup    getCommandGroup(int command);
+
+//! Maximum number of parameters of a command
+static const int maxCommandParams = 3;
+
+//! Describes a typed parameter of a command
+/*!
+ The value of the parameter is parsed into the slot of CommandArgs matching
+ its type: floats[slot], ints[slot] or text for a Text parameter.
+ */
+struct CommandParam {
+    enum Type {
+        None = 0,
+        Float,
+        Int,
+        Text
+    };
+
+    const char* name;
+    Type        type;
+    int         slot;
+    float       defaultValue;
+};
+
+//! Parsed parameters of a command
+/*!
+ Fixed size so that parsing a command never allocates.
+ */
+struct CommandArgs {
+    static const size_t maxTextSize = 256;
+
+    CommandArgs();
+
+    //! Whether the given parameter slot has been set by the client
+    bool    isSet(int param) const;
+
+    //! Bit i is set if the i-th parameter of the command was given
+    unsigned int    present;
+    float           floats[maxCommandParams];
+    int             ints[maxCommandParams];
+    //! Null-terminated, truncated to maxTextSize - 1 bytes
+    char            text[maxTextSize];
+    size_t          textSize;
+};
+
+constexpr uint32_t  commandHashStep(const char* str, uint32_t hash) {
+    return *str ? commandHashStep(str + 1, (hash ^ (unsigned char)*str) * 16777619u)
+                : hash;
+}
+
+//! 32-bit FNV-1a hash of a null-terminated string, usable at compile time
+constexpr uint32_t  commandHash(const char* str) {
+    return commandHashStep(str, 2166136261u);
+}
+
+//! Runtime FNV-1a hash of a string slice, same values as commandHash()
+uint32_t    commandHash(const char* str, size_t size);
+
+//! Parses an url-encoded query string into args
+/*!
+ Parameters that are not declared in params are ignored, declared
+ parameters that are absent keep their default value.
+ \param params Array of maxCommandParams descriptors, terminated by None
+ \return false if a key or a value could not be decoded, or if a number
+ is not finite
+ */
+bool        parseCommandArgs(const char* query, size_t size,
+                             CommandParam const* params, CommandArgs& args);
+
+//! Fills args from positional values, as sent by the control protocol
+/*!
+ values[i] is the value of the i-th parameter, used if bit i of present is
+ set. Text parameters are left empty.
+ \return false if a value is not finite
+ */
+bool        setCommandArgs(float const* values, unsigned int present,
+                           CommandParam const* params, CommandArgs& args);
+
+#endif
@@ -0,0 +1,129 @@
+//
+// CommandExecutor.cpp
+// NaoCar Remote Server
+//
+
+#include "CommandExecutor.hpp"
+
+#include <boost/bind.hpp>
+
+CommandExecutor::CommandExecutor(boost::asio::io_service* ioService) :
+    _ioService(ioService), _strand(*ioService), _thread(NULL), _mutex(), _condition(), _jobs(),
+    _stopped(false)
+{
+}
+
+CommandExecutor::~CommandExecutor() {
+    stop();
+}
+
+void	CommandExecutor::start() {
+    if (_thread != NULL)
+        return ;
+    _stopped = false;
+    _thread = new boost::thread(&CommandExecutor::_run, this);
+}
+
+void	CommandExecutor::stop() {
+    std::deque<JobPtr> dropped;
+
+    if (_thread == NULL)
+        return ;
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _stopped = true;
+        dropped.swap(_jobs);
+    }
+    _condition.notify_one();
+    _thread->join();
+    delete _thread;
+    _thread = NULL;
+    // Their timers are cancelled, nothing is left waiting in the io_service
+    for (size_t i = 0; i < dropped.size(); ++i)
+        _strand.post(boost::bind(&CommandExecutor::_finish, this, dropped[i],
+                                 ControlUnavailable, std::string()));
+}
+
+void	CommandExecutor::execute(Task const& task, CommandGroup group,
+                                 unsigned int timeout,
+                                 Completion const& completion) {
+    JobPtr job(new Job(*_ioService));
+    JobPtr superseded;
+    bool stopped;
+
+    job->task = task;
+    job->completion = completion;
+    job->group = group;
+    job->deadline = boost::posix_time::microsec_clock::universal_time()
+            + boost::posix_time::milliseconds(timeout);
+    job->timer.expires_at(job->deadline);
+    job->timer.async_wait(_strand.wrap(boost::bind(&CommandExecutor::_timeout, this, job,
+                                                   boost::asio::placeholders::error)));
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        stopped = _stopped;
+        if (!stopped && group != NoCommandGroup) {
+            // Latest wins: the newer command takes the place of the queued one
+            for (std::deque<JobPtr>::iterator it = _jobs.begin();
+                 it != _jobs.end(); ++it) {
+                if ((*it)->group == group) {
+                    superseded = *it;
+                    *it = job;
+                    break ;
+                }
+            }
+        }
+        if (!stopped && !superseded)
+            _jobs.push_back(job);
+    }
+    if (stopped)
+        _strand.post(boost::bind(&CommandExecutor::_finish, this, job,
+                                 ControlUnavailable, std::string()));
+    else if (superseded)
+        _strand.post(boost::bind(&CommandExecutor::_finish, this, superseded,
+                                 ControlSuperseded, std::string()));
+    else
+        _condition.notify_one();
+}
+
+void	CommandExecutor::_run() {
+    for (;;) {
+        JobPtr job;
+        {
+            boost::unique_lock<boost::mutex> lock(_mutex);
+            while (!_stopped && _jobs.empty())
+                _condition.wait(lock);
+            if (_stopped)
+                return ;
+            job = _jobs.front();
+            _jobs.pop_front();
+        }
+        // Its timer has expired or is about to: the command is dropped
+        if (boost::posix_time::microsec_clock::universal_time() >= job->deadline)
+            continue ;
+        ControlStatus status = job->task(job->response);
+        _strand.post(boost::bind(&CommandExecutor::_executed, this, job, status));
+    }
+}
+
+void	CommandExecutor::_executed(JobPtr const& job, ControlStatus status) {
+    // The worker is done with the job, its response can be read
+    _finish(job, status, job->response);
+}
+
+void	CommandExecutor::_finish(JobPtr const& job, ControlStatus status,
+                                 std::string const& response) {
+    if (job->finished)
+        return ;
+    job->finished = true;
+    job->timer.cancel();
+    job->completion(status, response);
+    job->completion.clear();
+}
+
+void	CommandExecutor::_timeout(JobPtr const& job,
+                                  boost::system::error_code const& error) {
+    if (error == boost::asio::error::operation_aborted)
+        return ;
+    _finish(job, ControlTimeout, std::string());
+}
@@ -0,0 +1,99 @@
+//
+// CommandExecutor.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __COMMAND_EXECUTOR_HPP__
+# define __COMMAND_EXECUTOR_HPP__
+
+# include <boost/asio.hpp>
+# include <boost/function.hpp>
+# include <boost/shared_ptr.hpp>
+# include <boost/thread/condition_variable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+# include <deque>
+# include <string>
+
+# include "Command.hpp"
+
+//! Runs the robot side of the commands on a worker thread
+/*!
+ Commands are queued by the network threads and executed one at a time, in
+ order, so that a slow NAOqi call never blocks the sockets. The completion
+ of each command is posted back to the io_service: callers wrap it in
+ their strand.
+
+ A command is given a timeout: if it is not finished in time, it completes
+ with ControlTimeout. A command which has not started by then is not
+ executed at all; a running one cannot be interrupted, its result is
+ dropped. A queued command of a group (steering, motion, pedal, head) is
+ superseded by a newer command of the same group.
+ */
+
+class CommandExecutor
+{
+public:
+    //! Runs the command on the worker thread and fills the response
+    typedef boost::function<ControlStatus (std::string& response)>   Task;
+    //! Called by a network thread, exactly once per command
+    typedef boost::function<void (ControlStatus status,
+                                  std::string const& response)>     Completion;
+
+    CommandExecutor(boost::asio::io_service* ioService);
+    virtual ~CommandExecutor();
+
+    void    start();
+    //! Waits for the running command, the queued ones are dropped
+    /*!
+     The dropped commands, and the ones queued afterwards, complete with
+     ControlUnavailable once the io_service runs their completion.
+     */
+    void    stop();
+
+    //! Queues a command, may be called from any thread
+    /*!
+     \param group Queued commands of the same group are superseded,
+     NoCommandGroup if the command must always be executed
+     \param timeout In milliseconds
+     */
+    void    execute(Task const& task, CommandGroup group,
+                    unsigned int timeout, Completion const& completion);
+
+private:
+    //! A command, shared between the queue, the timer and the completion
+    struct Job {
+        Job(boost::asio::io_service& ioService) :
+            task(), completion(), group(NoCommandGroup), deadline(),
+            timer(ioService), response(), finished(false) {}
+
+        Task                            task;
+        Completion                      completion;
+        CommandGroup                    group;
+        boost::posix_time::ptime        deadline;
+        boost::asio::deadline_timer     timer;
+        //! Written by the worker, read by the completion
+        std::string                     response;
+        //! Whether the completion has been called, only used in the strand
+        bool                            finished;
+    };
+
+    typedef boost::shared_ptr<Job>  JobPtr;
+
+    void    _run();
+    void    _executed(JobPtr const& job, ControlStatus status);
+    void    _finish(JobPtr const& job, ControlStatus status,
+                    std::string const& response);
+    void    _timeout(JobPtr const& job, boost::system::error_code const& error);
+
+    boost::asio::io_service*    _ioService;
+    //! Decides between the completion and the timeout of the jobs
+    boost::asio::io_service::strand _strand;
+    boost::thread*              _thread;
+    boost::mutex                _mutex;
+    boost::condition_variable   _condition;
+    std::deque<JobPtr>          _jobs;
+    bool                        _stopped;
+};
+
+#endif
@@ -0,0 +1,131 @@
+//
+// ControlProtocol.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __CONTROL_PROTOCOL_HPP__
+# define __CONTROL_PROTOCOL_HPP__
+
+# include <cstring>
+# include <stdint.h>
+
+//! Commands understood by RemoteServer
+/*!
+ The values are sent on the wire by the binary control protocol: new
+ commands must only be appended.
+ */
+enum CommandId {
+    GetStreamPortCommand,
+    BeginCommand,
+    EndCommand,
+    GoFrontwardsCommand,
+    GoBackwardsCommand,
+    TurnLeftCommand,
+    TurnRightCommand,
+    TurnFrontCommand,
+    StopCommand,
+    SteeringWheelActionCommand,
+    FunActionCommand,
+    CarambarActionCommand,
+    SetHeadCommand,
+    TalkCommand,
+    ChangeViewCommand,
+    AutoDrivingCommand,
+    UpShiftCommand,
+    DownShiftCommand,
+    PushPedalCommand,
+    ReleasePedalCommand,
+    GetControlPortCommand,
+    CommandCount
+};
+
+//! Binary control protocol
+/*!
+ Clients send fixed-size frames on a persistent TCP connection to the
+ control port (given by the /get-control-port command). Every frame is
+ answered by a frame echoing its command, sequence and timestamp, with the
+ status in the flags field, so that clients can measure the round trip.
+
+ Frame layout, 32 bytes, little-endian:
+   0  uint16  magic, controlMagic
+   2  uint8   version, controlVersion
+   3  uint8   command, a CommandId
+   4  uint32  sequence, incremented by the client for every frame
+   8  uint64  timestamp, in client time, echoed untouched
+   16 float   args[3], the float or int parameters of the command, in order
+   28 uint32  flags: bit i is set if args[i] is given (request),
+              or a ControlStatus (response)
+
+ Commands taking a text parameter can be sent but the text is left empty.
+ */
+
+static const uint16_t   controlMagic = 0x434e;
+static const uint8_t    controlVersion = 1;
+static const size_t     controlFrameSize = 32;
+static const int        controlFrameArgs = 3;
+
+enum ControlStatus {
+    ControlOk = 0,
+    //! The command could not be executed, as a 503 answer
+    ControlUnavailable,
+    ControlError,
+    ControlUnknownCommand,
+    //! Dropped because a newer frame of the same kind was received
+    ControlSuperseded,
+    //! Not executed or not finished within the time allowed to the command
+    ControlTimeout
+};
+
+struct ControlFrame {
+    uint8_t     command;
+    uint32_t    sequence;
+    uint64_t    timestamp;
+    float       args[controlFrameArgs];
+    uint32_t    flags;
+};
+
+//! Stores the size low bytes of value at out, little-endian
+inline void     controlStore(char* out, uint64_t value, int size) {
+    for (int byte = 0; byte < size; ++byte)
+        out[byte] = (char)(value >> (8 * byte));
+}
+
+//! Loads a little-endian integer of size bytes
+inline uint64_t controlLoad(const char* in, int size) {
+    uint64_t value = 0;
+
+    for (int byte = size - 1; byte >= 0; --byte)
+        value = (value << 8) | (unsigned char)in[byte];
+    return value;
+}
+
+inline void     encodeControlFrame(ControlFrame const& frame, char* out) {
+    controlStore(out, controlMagic, 2);
+    controlStore(out + 2, controlVersion, 1);
+    controlStore(out + 3, frame.command, 1);
+    controlStore(out + 4, frame.sequence, 4);
+    controlStore(out + 8, frame.timestamp, 8);
+    for (int i = 0; i < controlFrameArgs; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &frame.args[i], sizeof(bits));
+        controlStore(out + 16 + 4 * i, bits, 4);
+    }
+    controlStore(out + 28, frame.flags, 4);
+}
+
+//! Returns false if in does not start with the protocol magic and version
+inline bool     decodeControlFrame(const char* in, ControlFrame& frame) {
+    if (controlLoad(in, 2) != controlMagic || controlLoad(in + 2, 1) != controlVersion)
+        return false;
+    frame.command = (uint8_t)controlLoad(in + 3, 1);
+    frame.sequence = (uint32_t)controlLoad(in + 4, 4);
+    frame.timestamp = controlLoad(in + 8, 8);
+    for (int i = 0; i < controlFrameArgs; ++i) {
+        uint32_t bits = (uint32_t)controlLoad(in + 16 + 4 * i, 4);
+        memcpy(&frame.args[i], &bits, sizeof(bits));
+    }
+    frame.flags = (uint32_t)controlLoad(in + 28, 4);
+    return true;
+}
+
+#endif
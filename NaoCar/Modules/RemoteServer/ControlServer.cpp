@@ -0,0 +1,233 @@
+//
+// ControlServer.cpp
+// NaoCar Remote Server
+//
+
+#include "ControlServer.hpp"
+
+#include <boost/bind.hpp>
+#include <cstring>
+
+#include "ControlServerDelegate.hpp"
+#include "Log.hpp"
+
+ControlServer::ControlServer(boost::asio::io_service* ioService,
+                             ControlServerDelegate* delegate) :
+    _ioService(ioService), _strand(*ioService), _delegate(delegate), _tcpServer(NULL),
+    _clients(), _freeReplies()
+{
+}
+
+ControlServer::~ControlServer() {
+    close();
+    // The pending completions use the clients and their sockets
+    Network::BoostTcpServer::drain(_ioService);
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it)
+        _tcpServer->release(it->second->socket);
+    // The sockets are recycled before their server is destroyed
+    Network::BoostTcpServer::drain(_ioService);
+    delete _tcpServer;
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it) {
+        for (size_t i = 0; i < it->second->replies.size(); ++i)
+            delete it->second->replies[i];
+        delete it->second;
+    }
+    for (size_t i = 0; i < _freeReplies.size(); ++i)
+        delete _freeReplies[i];
+}
+
+void	ControlServer::close() {
+    if (_tcpServer)
+        _tcpServer->close();
+    // Nothing is read anymore, and no reply is freed behind the completions
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it)
+        it->second->socket->setDelegate(NULL);
+}
+
+int	ControlServer::run() {
+    if (_tcpServer == NULL) {
+        _tcpServer = new Network::BoostTcpServer(_ioService);
+        _tcpServer->setDelegate(this);
+        _tcpServer->setStrand(&_strand);
+        if (_tcpServer->listen(0, "") == false) {
+            LOG_ERROR("could not listen on this port");
+            delete _tcpServer;
+            _tcpServer = NULL;
+            return (0);
+        }
+        LOG_INFO("Control: " << _tcpServer->getPort());
+    }
+    return (_tcpServer->getPort());
+}
+
+void	ControlServer::newConnection(Network::ATcpServer* sender,
+                                     Network::ATcpSocket* socket) {
+    if (_tcpServer != sender)
+        return ;
+    // Frames are tiny and latency matters more than throughput
+    socket->setNoDelay(true);
+    // A client which vanished without closing is noticed while idle
+    socket->setKeepAlive(controlKeepAlive);
+    Client* client = new Client();
+    client->socket = socket;
+    socket->setDelegate(this);
+    _clients[socket] = client;
+    LOG_INFO("Control Connection " << _clients.size());
+    socket->read(client->buffer, sizeof(client->buffer), false);
+}
+
+void	ControlServer::connected(Network::ASocket*,
+                                 Network::ASocket::Error) {
+}
+
+void	ControlServer::readFinished(Network::ASocket* sender,
+                                    Network::ASocket::Error error,
+                                    size_t bytesRead) {
+    std::map<Network::ASocket*, Client*>::iterator it = _clients.find(sender);
+
+    if (it == _clients.end())
+        return ;
+    Client* client = it->second;
+    if (error) {
+        _closeClient(client);
+        return ;
+    }
+    client->size += bytesRead;
+    _handleFrames(client);
+}
+
+void	ControlServer::readFinished(Network::ASocket*,
+                                    Network::ASocket::Error,
+                                    Network::ASocket::Buffer const&) {
+}
+
+void	ControlServer::writeFinished(Network::ASocket* sender,
+                                     Network::ASocket::Error error,
+                                     size_t) {
+    std::map<Network::ASocket*, Client*>::iterator it = _clients.find(sender);
+
+    if (it == _clients.end() || it->second->written == 0)
+        return ;
+    Client* client = it->second;
+    _freeReplies.push_back(client->replies.front());
+    client->replies.pop_front();
+    --client->written;
+    if (error)
+        client->closing = true;
+    if (client->closing && client->replies.empty())
+        _destroyClient(client);
+}
+
+void	ControlServer::_handleFrames(Client* client) {
+    size_t count = client->size / controlFrameSize;
+    int last[CommandGroupCount];
+    Reply* reply;
+
+    if (count == 0) {
+        client->socket->read(client->buffer + client->size,
+                             sizeof(client->buffer) - client->size, false);
+        return ;
+    }
+    if (_freeReplies.empty()) {
+        reply = new Reply();
+    } else {
+        reply = _freeReplies.back();
+        _freeReplies.pop_back();
+    }
+    for (int i = 0; i < CommandGroupCount; ++i)
+        last[i] = -1;
+    for (size_t i = 0; i < count; ++i) {
+        // The stream cannot be resynchronized after a corrupted frame
+        if (!decodeControlFrame(client->buffer + i * controlFrameSize,
+                                reply->frames[i])) {
+            LOG_WARNING("Invalid control frame");
+            _freeReplies.push_back(reply);
+            _closeClient(client);
+            return ;
+        }
+        CommandGroup group = getCommandGroup(reply->frames[i].command);
+        if (group != NoCommandGroup)
+            last[group] = i;
+    }
+
+    reply->count = count;
+    // Held until every frame is dispatched, some complete right away
+    reply->pending = 1;
+    client->replies.push_back(reply);
+    for (size_t i = 0; i < count; ++i) {
+        ControlFrame& frame = reply->frames[i];
+        CommandGroup group = getCommandGroup(frame.command);
+
+        if (frame.command >= CommandCount) {
+            frame.flags = ControlUnknownCommand;
+        } else if (group != NoCommandGroup
+                   && (last[group] != (int)i
+                       || (client->hasSequence[group]
+                           && (int32_t)(frame.sequence - client->lastSequence[group]) <= 0))) {
+            frame.flags = ControlSuperseded;
+        } else {
+            if (group != NoCommandGroup) {
+                client->lastSequence[group] = frame.sequence;
+                client->hasSequence[group] = true;
+            }
+            ++reply->pending;
+            _delegate->controlCommand((CommandId)frame.command,
+                                      frame.args, frame.flags,
+                                      _strand.wrap(boost::bind(&ControlServer::_frameFinished,
+                                                               this, client, reply, i, _1)));
+        }
+    }
+    _frameFinished(client, reply, count, ControlOk);
+
+    // Keep the beginning of the next frame for the next read
+    size_t used = count * controlFrameSize;
+    memmove(client->buffer, client->buffer + used, client->size - used);
+    client->size -= used;
+    if (client->closing)
+        return ;
+    client->socket->read(client->buffer + client->size,
+                         sizeof(client->buffer) - client->size, false);
+}
+
+void	ControlServer::_frameFinished(Client* client, Reply* reply,
+                                      size_t index, ControlStatus status) {
+    // index == count releases the hold of _handleFrames
+    if (index < reply->count)
+        reply->frames[index].flags = status;
+    if (--reply->pending > 0)
+        return ;
+    reply->size = 0;
+    for (size_t i = 0; i < reply->count; ++i) {
+        for (int arg = 0; arg < controlFrameArgs; ++arg)
+            reply->frames[i].args[arg] = 0;
+        encodeControlFrame(reply->frames[i], reply->data + reply->size);
+        reply->size += controlFrameSize;
+    }
+    _flushReplies(client);
+}
+
+void	ControlServer::_flushReplies(Client* client) {
+    while (client->written < client->replies.size()
+           && client->replies[client->written]->pending == 0) {
+        Reply* reply = client->replies[client->written];
+        client->socket->write(reply->data, reply->size);
+        ++client->written;
+    }
+}
+
+void	ControlServer::_closeClient(Client* client) {
+    client->closing = true;
+    if (client->replies.empty())
+        _destroyClient(client);
+}
+
+void	ControlServer::_destroyClient(Client* client) {
+    _clients.erase(client->socket);
+    // Closed, and kept for the next connection
+    _tcpServer->release(client->socket);
+    delete client;
+    LOG_INFO("Control Deconnection " << _clients.size());
+}
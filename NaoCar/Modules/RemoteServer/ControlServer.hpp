@@ -0,0 +1,117 @@
+//
+// ControlServer.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __CONTROL_SERVER_HPP__
+# define __CONTROL_SERVER_HPP__
+
+# include <boost/asio.hpp>
+# include <deque>
+# include <map>
+# include <vector>
+
+# include "Command.hpp"
+# include "ControlProtocol.hpp"
+# include "Network/BoostTcpServer.h"
+# include "Network/BoostTcpSocket.h"
+# include "Network/ITcpServerDelegate.h"
+# include "Network/ITcpSocketDelegate.h"
+
+class ControlServerDelegate;
+
+//! Server of the binary control protocol
+/*!
+ Frames are handed to the delegate as soon as they are read. All the frames
+ available in a single read form a batch: within a batch, only the last
+ frame of each group of exclusive commands (steering, motion, pedal, head)
+ is executed, the previous ones are superseded by it. Frames older than the
+ last executed one of their group are dropped as well.
+ The answers of a batch are sent with a single write, once all its commands
+ are done. Batches are answered in order.
+ The handlers of all the control connections run in one strand.
+ The server is destroyed once the io_service is stopped.
+ */
+
+class ControlServer : public Network::ITcpServerDelegate,
+        public Network::ITcpSocketDelegate
+{
+public:
+    ControlServer(boost::asio::io_service* ioService,
+                  ControlServerDelegate* delegate);
+    virtual ~ControlServer();
+
+    //! Starts listening and returns the control port, or 0 on error
+    int     run();
+    //! Stops accepting, the clients are no longer served
+    /*!
+     Called once the io_service is stopped. The completions of the commands
+     still write their replies, until the server is destroyed.
+     */
+    void    close();
+
+    virtual void	newConnection(Network::ATcpServer* sender,
+                                  Network::ATcpSocket* socket);
+    virtual void	connected(Network::ASocket* sender,
+                              Network::ASocket::Error error);
+    virtual void	readFinished(Network::ASocket* sender,
+                                 Network::ASocket::Error error,
+                                 size_t bytesRead);
+    virtual void	readFinished(Network::ASocket* sender,
+                                 Network::ASocket::Error error,
+                                 Network::ASocket::Buffer const& line);
+    virtual void	writeFinished(Network::ASocket* sender,
+                                  Network::ASocket::Error error,
+                                  size_t bytesWritten);
+
+private:
+    //! Maximum number of frames handled in one batch
+    static const size_t maxBatchFrames = 64;
+    //! Seconds a connection stays silent before it is probed
+    static const unsigned int controlKeepAlive = 10;
+
+    //! Answers to a batch
+    struct Reply {
+        ControlFrame    frames[maxBatchFrames];
+        size_t          count;
+        //! Number of commands of the batch not done yet
+        size_t          pending;
+        char            data[maxBatchFrames * controlFrameSize];
+        size_t          size;
+    };
+
+    struct Client {
+        Client() : socket(NULL), size(0), replies(), written(0),
+                   lastSequence(), hasSequence(), closing(false) {}
+
+        Network::ATcpSocket*    socket;
+        char                    buffer[maxBatchFrames * controlFrameSize];
+        size_t                  size;
+        //! Replies in batch order, the first ones are queued on the socket
+        std::deque<Reply*>      replies;
+        //! Number of replies queued on the socket
+        size_t                  written;
+        //! Sequence of the last executed frame of each group
+        uint32_t                lastSequence[CommandGroupCount];
+        bool                    hasSequence[CommandGroupCount];
+        bool                    closing;
+    };
+
+    void            _handleFrames(Client* client);
+    //! Called by the delegate once the command of a frame is done
+    void            _frameFinished(Client* client, Reply* reply,
+                                   size_t index, ControlStatus status);
+    void            _flushReplies(Client* client);
+    void            _closeClient(Client* client);
+    void            _destroyClient(Client* client);
+
+    boost::asio::io_service*    _ioService;
+    boost::asio::io_service::strand _strand;
+    ControlServerDelegate*      _delegate;
+    Network::BoostTcpServer*    _tcpServer;
+    std::map<Network::ASocket*, Client*>    _clients;
+    //! Written replies, kept to be reused
+    std::vector<Reply*>         _freeReplies;
+};
+
+#endif
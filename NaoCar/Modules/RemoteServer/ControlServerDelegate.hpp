@@ -0,0 +1,32 @@
+//
+// ControlServerDelegate.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __CONTROL_SERVER_DELEGATE_HPP__
+# define __CONTROL_SERVER_DELEGATE_HPP__
+
+# include <boost/function.hpp>
+
+# include "ControlProtocol.hpp"
+
+//! Called once a control command is done, possibly by another thread
+typedef boost::function<void (ControlStatus status)>   ControlCompletion;
+
+class ControlServerDelegate {
+public:
+    virtual ~ControlServerDelegate(void) {}
+
+    //! Executes a command received on the control port
+    /*!
+     The command may complete later, completion must be called exactly once.
+     \param values The positional parameters of the command
+     \param present Bit i is set if values[i] has been given
+     */
+    virtual void    controlCommand(CommandId command,
+                                   float const* values,
+                                   unsigned int present,
+                                   ControlCompletion const& completion) = 0;
+};
+
+#endif
@@ -0,0 +1,167 @@
+//
+// HttpParser.cpp
+// NaoCar Remote Server
+//
+
+#include "HttpParser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <boost/algorithm/string/predicate.hpp>
+
+std::string const&	HttpRequest::getHeader(std::string const& name) const {
+    static const std::string empty;
+    std::map<std::string, std::string>::const_iterator it = headers.find(name);
+
+    if (it == headers.end())
+        return empty;
+    return it->second;
+}
+
+HttpParser::HttpParser() : _state(RequestLine), _request(), _bodyLeft(0),
+                           _headerCount(0), _headerSize(0) {
+    reset();
+}
+
+HttpParser::~HttpParser() {
+}
+
+HttpRequest const&	HttpParser::getRequest() const {
+    return _request;
+}
+
+void	HttpParser::reset() {
+    _state = RequestLine;
+    _request.method.clear();
+    _request.path.clear();
+    _request.query.clear();
+    _request.versionMajor = 1;
+    _request.versionMinor = 1;
+    _request.headers.clear();
+    _request.body.clear();
+    _request.keepAlive = true;
+    _bodyLeft = 0;
+    _headerCount = 0;
+    _headerSize = 0;
+}
+
+HttpParser::Status	HttpParser::parse(const char* data, size_t size,
+                                          size_t& consumed) {
+    consumed = 0;
+    while (consumed < size) {
+        const char* begin = data + consumed;
+
+        if (_state == Body) {
+            size_t len = size - consumed;
+            if (len > _bodyLeft)
+                len = _bodyLeft;
+            _request.body.append(begin, len);
+            _bodyLeft -= len;
+            consumed += len;
+            if (_bodyLeft == 0)
+                return Complete;
+            continue ;
+        }
+
+        // Only complete lines are consumed, the rest stays in the buffer
+        const char* newline = (const char*)memchr(begin, '\n', size - consumed);
+        if (newline == NULL)
+            return Incomplete;
+        consumed += newline - begin + 1;
+        const char* end = newline;
+        if (end > begin && end[-1] == '\r')
+            --end;
+
+        if (_state == RequestLine) {
+            // Robustness: ignore empty lines preceding a request
+            if (end == begin)
+                continue ;
+            if (!_parseRequestLine(begin, end))
+                return Invalid;
+            _state = Headers;
+        } else if (end == begin) {
+            if (!_headersFinished())
+                return Invalid;
+            if (_bodyLeft == 0)
+                return Complete;
+            _state = Body;
+        } else {
+            // Repeated names are merged: only the lines bound the memory
+            _headerSize += end - begin;
+            if (++_headerCount > maxHeaderCount || _headerSize > maxHeaderSize)
+                return TooLarge;
+            if (!_parseHeader(begin, end))
+                return Invalid;
+        }
+    }
+    return Incomplete;
+}
+
+bool	HttpParser::_parseRequestLine(const char* begin, const char* end) {
+    const char* methodEnd = std::find(begin, end, ' ');
+    if (methodEnd == end || methodEnd == begin)
+        return false;
+    const char* targetBegin = methodEnd + 1;
+    const char* targetEnd = std::find(targetBegin, end, ' ');
+    if (targetEnd == end || targetEnd == targetBegin)
+        return false;
+    std::string version(targetEnd + 1, end);
+    if (version.size() != 8 || version.compare(0, 5, "HTTP/") != 0
+            || !isdigit(version[5]) || version[6] != '.' || !isdigit(version[7]))
+        return false;
+
+    _request.method.assign(begin, methodEnd);
+    const char* query = std::find(targetBegin, targetEnd, '?');
+    _request.path.assign(targetBegin, query);
+    if (query != targetEnd)
+        _request.query.assign(query + 1, targetEnd);
+    _request.versionMajor = version[5] - '0';
+    _request.versionMinor = version[7] - '0';
+    return true;
+}
+
+bool	HttpParser::_parseHeader(const char* begin, const char* end) {
+    // Folded header lines are obsolete and not supported
+    if (*begin == ' ' || *begin == '\t')
+        return false;
+    const char* colon = std::find(begin, end, ':');
+    if (colon == end || colon == begin)
+        return false;
+    std::string name(begin, colon);
+    for (std::string::iterator it = name.begin(); it != name.end(); ++it)
+        *it = tolower(*it);
+    const char* value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t'))
+        ++value;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    std::string& field = _request.headers[name];
+    if (!field.empty())
+        field += ", ";
+    field.append(value, end);
+    return true;
+}
+
+bool	HttpParser::_headersFinished() {
+    std::string const& connection = _request.getHeader("connection");
+
+    if (_request.versionMajor == 1 && _request.versionMinor >= 1)
+        _request.keepAlive = !boost::icontains(connection, "close");
+    else
+        _request.keepAlive = boost::icontains(connection, "keep-alive");
+
+    if (!_request.getHeader("transfer-encoding").empty())
+        return false;
+    std::string const& length = _request.getHeader("content-length");
+    if (!length.empty()) {
+        char* lengthEnd = NULL;
+        unsigned long value = strtoul(length.c_str(), &lengthEnd, 10);
+        if (*lengthEnd != '\0' || !isdigit(length[0]) || value > maxBodySize)
+            return false;
+        _bodyLeft = value;
+        _request.body.reserve(value);
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+//
+// HttpParser.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __HTTP_PARSER_HPP__
+# define __HTTP_PARSER_HPP__
+
+# include <map>
+# include <string>
+
+//! A parsed HTTP request
+struct HttpRequest {
+    std::string                         method;
+    std::string                         path;
+    std::string                         query;
+    int                                 versionMajor;
+    int                                 versionMinor;
+    //! Header names are lower-cased
+    std::map<std::string, std::string>  headers;
+    std::string                         body;
+    bool                                keepAlive;
+
+    //! Returns the value of the given (lower-case) header, or an empty string
+    std::string const&  getHeader(std::string const& name) const;
+};
+
+//! Incremental HTTP/1.x request parser
+/*!
+ The parser works directly on a connection receive buffer: parse() is given
+ everything that has been received and not consumed yet, and reports how
+ many bytes it consumed. Incomplete lines are left in the buffer and are
+ parsed again once more data arrived, so requests may be split across reads
+ and several pipelined requests may be contained in a single read.
+ After a Complete status, the request is available through getRequest()
+ until reset() is called.
+ */
+
+class HttpParser {
+public:
+
+    enum Status {
+        Incomplete,
+        Complete,
+        Invalid,
+        //! The header fields exceed maxHeaderSize or maxHeaderCount
+        TooLarge
+    };
+
+    //! Maximum accepted request body size
+    static const size_t maxBodySize = 64 * 1024;
+    //! Maximum accepted size of the header fields, all lines together
+    static const size_t maxHeaderSize = 16 * 1024;
+    //! Maximum accepted number of header lines
+    static const size_t maxHeaderCount = 64;
+
+    HttpParser();
+    ~HttpParser();
+
+    //! Parses the given data
+    /*!
+     \param data The received bytes not consumed yet
+     \param size The number of bytes in data
+     \param consumed Set to the number of bytes used by the parser
+     \return Complete as soon as a whole request has been parsed
+     */
+    Status              parse(const char* data, size_t size, size_t& consumed);
+
+    HttpRequest const&  getRequest() const;
+
+    //! Prepares the parser for the next request of the connection
+    void                reset();
+
+private:
+    enum State {
+        RequestLine,
+        Headers,
+        Body
+    };
+
+    bool        _parseRequestLine(const char* begin, const char* end);
+    bool        _parseHeader(const char* begin, const char* end);
+    bool        _headersFinished();
+
+    State       _state;
+    HttpRequest _request;
+    size_t      _bodyLeft;
+    //! Header lines and bytes of the request, repeated names included
+    size_t      _headerCount;
+    size_t      _headerSize;
+};
+
+#endif
@@ -0,0 +1,72 @@
+//
+// LatencyHistogram.cpp
+// NaoCar Remote Server
+//
+
+#include "LatencyHistogram.hpp"
+
+#include <sstream>
+#include <time.h>
+
+LatencyHistogram::LatencyHistogram() : _count(0), _max(0) {
+    reset();
+}
+
+uint64_t	LatencyHistogram::now() {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+void	LatencyHistogram::record(uint64_t microseconds) {
+    unsigned int bucket = 0;
+
+    while (bucket + 1 < bucketCount && (microseconds >> bucket) != 0)
+        ++bucket;
+    ++_buckets[bucket];
+    ++_count;
+    if (microseconds > _max)
+        _max = microseconds;
+}
+
+void	LatencyHistogram::reset() {
+    for (unsigned int i = 0; i < bucketCount; ++i)
+        _buckets[i] = 0;
+    _count = 0;
+    _max = 0;
+}
+
+uint64_t	LatencyHistogram::getCount() const {
+    return _count;
+}
+
+uint64_t	LatencyHistogram::getMax() const {
+    return _max;
+}
+
+uint64_t	LatencyHistogram::getPercentile(double percentile) const {
+    uint64_t rank = (uint64_t)(_count * percentile / 100);
+    uint64_t seen = 0;
+
+    for (unsigned int i = 0; i < bucketCount; ++i) {
+        seen += _buckets[i];
+        if (seen > rank)
+            return i + 1 < bucketCount ? (uint64_t)1 << i : _max;
+    }
+    return _max;
+}
+
+std::string	LatencyHistogram::toString() const {
+    std::ostringstream line;
+
+    line << "n=" << _count
+         << " p50<=" << getPercentile(50) << "us"
+         << " p90<=" << getPercentile(90) << "us"
+         << " p99<=" << getPercentile(99) << "us"
+         << " max=" << _max << "us |";
+    for (unsigned int i = 0; i < bucketCount; ++i)
+        if (_buckets[i] != 0)
+            line << " <" << ((uint64_t)1 << i) << ":" << _buckets[i];
+    return line.str();
+}
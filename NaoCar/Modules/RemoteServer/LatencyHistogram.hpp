@@ -0,0 +1,48 @@
+//
+// LatencyHistogram.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __LATENCY_HISTOGRAM_HPP__
+# define __LATENCY_HISTOGRAM_HPP__
+
+# include <stdint.h>
+# include <string>
+
+//! Distribution of durations, in power of two buckets of microseconds
+/*!
+ Recording is a few instructions and never allocates, so it can be done on
+ every frame. Bucket i counts the durations below 2^i microseconds which
+ are not in bucket i - 1, the last one everything longer. Percentiles are
+ therefore upper bounds, within a factor of two.
+ Not thread safe: a histogram is recorded and read by a single thread.
+ */
+
+class LatencyHistogram {
+public:
+    //! Buckets up to about 8 seconds
+    static const unsigned int bucketCount = 24;
+
+    LatencyHistogram();
+
+    //! Microseconds of a monotonic clock
+    static uint64_t now();
+
+    void        record(uint64_t microseconds);
+    void        reset();
+
+    uint64_t    getCount() const;
+    uint64_t    getMax() const;
+    //! Upper bound of the bucket of the given percentile, from 0 to 100
+    uint64_t    getPercentile(double percentile) const;
+
+    //! Count, percentiles and non-empty buckets, on a single line
+    std::string toString() const;
+
+private:
+    uint64_t    _buckets[bucketCount];
+    uint64_t    _count;
+    uint64_t    _max;
+};
+
+#endif
@@ -95,11 +95,36 @@ namespace Network {
          When the write operation, writeFinished() function of the delegate is
          called. If an error occured, the number of byte written before the error
          is written.
+         A write may be issued while previous ones are in progress: each socket
+         queues its own writes and sends them in order, so a slow peer never
+         delays the other sockets. writeFinished() is called once per write,
+         in the same order. The buffer must stay valid until then.
+         Writes may be issued from any thread.
          */
         virtual void        write(const void* buffer, uint32_t size) = 0;
 
         virtual void        write(std::string string);
 
+        //! A memory segment of a gathered write
+        struct Buffer {
+            const void* data;
+            uint32_t    size;
+        };
+
+        //! Maximum number of segments of a gathered write
+        static const size_t maxWriteBuffers = 8;
+
+        //! Asynchronously write several buffers in a single operation
+        /*!
+         The buffers are sent in order with a single gathered write (writev),
+         as if they were contiguous. Their content is not copied: the memory
+         they point to must stay valid until writeFinished() is called, once,
+         with the total number of bytes written.
+         \param buffers An array of count buffers
+         \param count The number of buffers, at most maxWriteBuffers
+         */
+        virtual void        write(Buffer const* buffers, size_t count) = 0;
+
         //! Returns the IP the socket is connected to
         /*!
         Returns an empty string if an error occured.
@@ -11,7 +11,7 @@
 #include "ITcpServerDelegate.h"
 
 Network::ATcpServer::ATcpServer() :
-    _maxPendingConnections(maxPendingConnectionsDefault)
+    _delegate(NULL), _maxPendingConnections(maxPendingConnectionsDefault)
 {
     
 }
@@ -41,10 +41,20 @@ void Network::ATcpServer::setDelegate(ITcpServerDelegate* delegate)
     _delegate = delegate;
 }
 
+void Network::ATcpServer::release(ATcpSocket* socket)
+{
+    delete socket;
+}
+
 void Network::ATcpServer::_newConnection(ATcpSocket* socket)
 {
     if (_delegate)
     {
         _delegate->newConnection(this, socket);
     }
+    else
+    {
+        // Accepted before the server was closed
+        release(socket);
+    }
 }
\ No newline at end of file
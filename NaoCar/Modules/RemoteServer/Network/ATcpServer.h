@@ -43,6 +43,15 @@ namespace Network {
         
         // Returns the address on wich the server is listening
         virtual uint16_t getPort() const = 0;
+
+        //! Stops accepting connections
+        /*!
+         The pending accept is aborted, and the delegate is no longer called:
+         a connection accepted meanwhile is released. The sockets already
+         accepted are left open. Not thread safe: called once the threads
+         serving the server are stopped, before it is destroyed.
+         */
+        virtual void close() = 0;
         
         //! Returns the maximum number of pending connections
         int     getMaxPendingConnections() const;
@@ -50,6 +59,14 @@ namespace Network {
         
         ITcpServerDelegate* getDelegate() const;
         void                setDelegate(ITcpServerDelegate* delegate);
+
+        //! Gives back a socket accepted by the server
+        /*!
+         To be called instead of deleting the socket, once it is no longer
+         used and none of its operations is in progress. The server may
+         reuse it for a later connection.
+         */
+        virtual void        release(ATcpSocket* socket);
         
     protected:
         void    _newConnection(ATcpSocket* socket);
@@ -11,7 +11,8 @@
 #include "ITcpSocketDelegate.h"
 
 Network::ATcpSocket::ATcpSocket() :
-    ASocket(ASocket::TcpSocket), _delegate(NULL)
+    ASocket(ASocket::TcpSocket), _delegate(NULL), _queuedBytes(0),
+    _lowWatermark(0), _highWatermark(0), _aboveHighWatermark(false)
 {    
 }
 
@@ -29,6 +30,17 @@ void Network::ATcpSocket::setDelegate(ITcpSocketDelegate* delegate)
     _delegate = delegate;
 }
 
+void Network::ATcpSocket::setWriteWatermarks(size_t low, size_t high)
+{
+    _lowWatermark = low < high ? low : high;
+    _highWatermark = high;
+}
+
+size_t Network::ATcpSocket::getQueuedBytes() const
+{
+    return _queuedBytes.load(std::memory_order_relaxed);
+}
+
 void Network::ATcpSocket::_connected(ASocket::Error error)
 {
     if (_delegate)
@@ -45,4 +57,43 @@ void Network::ATcpSocket::_writeFinished(ASocket::Error error, size_t bytesWritt
 {
     if (_delegate)
         _delegate->writeFinished(this, error, bytesWritten);
-}
\ No newline at end of file
+}
+
+void Network::ATcpSocket::_timedOut(Timeout timeout)
+{
+    if (_delegate)
+        _delegate->timedOut(this, timeout);
+}
+
+void Network::ATcpSocket::_writeQueued(size_t bytes)
+{
+    size_t queued = _queuedBytes.load(std::memory_order_relaxed) + bytes;
+
+    _queuedBytes.store(queued, std::memory_order_relaxed);
+    if (_highWatermark == 0 || _aboveHighWatermark || queued < _highWatermark)
+        return ;
+    _aboveHighWatermark = true;
+    if (_delegate)
+        _delegate->writeQueueHigh(this, queued);
+}
+
+void Network::ATcpSocket::_writeDequeued(size_t bytes)
+{
+    size_t queued = _queuedBytes.load(std::memory_order_relaxed);
+
+    queued = bytes < queued ? queued - bytes : 0;
+    _queuedBytes.store(queued, std::memory_order_relaxed);
+    if (!_aboveHighWatermark || queued > _lowWatermark)
+        return ;
+    _aboveHighWatermark = false;
+    if (_delegate)
+        _delegate->writeQueueLow(this, queued);
+}
+
+void Network::ATcpSocket::_clearWriteQueue()
+{
+    _queuedBytes.store(0, std::memory_order_relaxed);
+    _lowWatermark = 0;
+    _highWatermark = 0;
+    _aboveHighWatermark = false;
+}
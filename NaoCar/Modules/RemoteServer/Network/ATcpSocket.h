@@ -11,12 +11,27 @@
 
 #include "ASocket.h"
 
+#include <atomic>
+
+#include "SharedBuffer.h"
+
 namespace Network {
 
     //! Abstraction of a TCP socket
 
     class ATcpSocket : public ASocket {
     public:
+        //! Deadlines of a socket
+        enum Timeout {
+            //! A read must finish in time
+            ReadTimeout,
+            //! A write must finish in time, or the next queued one start
+            WriteTimeout,
+            //! Some data must be read or written in time
+            IdleTimeout,
+            TimeoutCount
+        };
+
         
         //! Constructs a TCP socket
         ATcpSocket();
@@ -27,8 +42,69 @@ namespace Network {
         //! Returns the delegate
         ITcpSocketDelegate* getDelegate() const;
 
+        //! Asynchronously read until the given delimiter
+        /*!
+         When the delimiter is received, readFinished() is called with the
+         data up to and including it. Data received after the delimiter
+         stays buffered for the next readUntil().
+         */
 	virtual void readUntil(std::string const& delim) = 0;
 
+        using ASocket::write;
+
+        //! Asynchronously write a shared buffer
+        /*!
+         The socket holds a copy of the buffer until writeFinished() is
+         called: the same buffer can be written to many sockets, it is
+         neither copied nor needs to be kept by the caller.
+         */
+        virtual void write(SharedBuffer const& buffer) = 0;
+
+        //! Sets a deadline of the socket, in milliseconds, 0 to disable it
+        /*!
+         When a deadline expires, timedOut() is called on the delegate. The
+         read and write timeouts apply to the operations started after
+         this call, the idle timeout starts right away.
+         */
+        virtual void setTimeout(Timeout timeout, unsigned int milliseconds) = 0;
+
+        //! Options of a connected socket
+        /*!
+         Each returns false if the option could not be set, or is not
+         supported by the system.
+         */
+
+        //! Sends small writes right away instead of merging them (Nagle)
+        virtual bool setNoDelay(bool enabled) = 0;
+        //! Size of the kernel buffers, in bytes
+        virtual bool setSendBufferSize(int size) = 0;
+        virtual bool setReceiveBufferSize(int size) = 0;
+        //! Unsent bytes above which the socket is not writable, 0 to disable
+        /*!
+         Keeps the data the peer has not acknowledged in the queue of the
+         socket, where it can still be dropped or replaced, rather than in
+         the kernel.
+         */
+        virtual bool setNotSentLowWatermark(int size) = 0;
+        //! Probes an idle connection after the given seconds, 0 to disable
+        virtual bool setKeepAlive(unsigned int idleSeconds) = 0;
+
+        //! Watermarks of the write queue, in bytes, high at 0 to disable them
+        /*!
+         writeQueueHigh() is called on the delegate when the bytes queued
+         reach high, then writeQueueLow() once they are down to low. A
+         producer can stop writing in between, and the memory held by a slow
+         peer stays bounded. To be set before writing.
+         */
+        void    setWriteWatermarks(size_t low, size_t high);
+
+        //! Returns the bytes of the writes which are not finished
+        /*!
+         May be called from any thread. Writes requested outside of the
+         strand of the socket are counted once they are queued.
+         */
+        size_t  getQueuedBytes() const;
+
         //! Set the delegate
         void setDelegate(ITcpSocketDelegate* delegate);
         
@@ -36,9 +112,21 @@ namespace Network {
         virtual void _connected(ASocket::Error error);
         virtual void _readFinished(ASocket::Error error, size_t bytesRead);
         virtual void _writeFinished(ASocket::Error error, size_t bytesWritten);
+        virtual void _timedOut(Timeout timeout);
+        //! Counts a write queued or finished, and notifies the crossings of
+        //! the watermarks. To be called in the strand of the socket.
+        void    _writeQueued(size_t bytes);
+        void    _writeDequeued(size_t bytes);
+        //! Forgets the queued writes and the watermarks
+        void    _clearWriteQueue();
         
     private:
         ITcpSocketDelegate*    _delegate;
+        std::atomic<size_t>    _queuedBytes;
+        size_t                 _lowWatermark;
+        size_t                 _highWatermark;
+        //! writeQueueHigh() was called, and not writeQueueLow() yet
+        bool                   _aboveHighWatermark;
     };
 
 }
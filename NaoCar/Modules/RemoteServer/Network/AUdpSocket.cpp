@@ -0,0 +1,53 @@
+//
+//  AUdpSocket.cpp
+//  Babel Server
+//
+
+#include "AUdpSocket.h"
+
+#include "IUdpSocketDelegate.h"
+
+Network::AUdpSocket::AUdpSocket() :
+    ASocket(ASocket::UdpSocket), _delegate(NULL)
+{
+}
+
+Network::AUdpSocket::~AUdpSocket()
+{
+}
+
+Network::IUdpSocketDelegate* Network::AUdpSocket::getDelegate() const
+{
+    return _delegate;
+}
+
+void Network::AUdpSocket::setDelegate(IUdpSocketDelegate* delegate)
+{
+    _delegate = delegate;
+}
+
+void Network::AUdpSocket::_connected(ASocket::Error error)
+{
+    if (_delegate)
+        _delegate->connected(this, error);
+}
+
+void Network::AUdpSocket::_readFinished(ASocket::Error error, size_t bytesRead)
+{
+    if (_delegate)
+        _delegate->readFinished(this, error, bytesRead);
+}
+
+void Network::AUdpSocket::_datagramsReceived(ASocket::Error error,
+                                             Datagram const* datagrams,
+                                             size_t count)
+{
+    if (_delegate)
+        _delegate->datagramsReceived(this, error, datagrams, count);
+}
+
+void Network::AUdpSocket::_writeFinished(ASocket::Error error, size_t bytesWritten)
+{
+    if (_delegate)
+        _delegate->writeFinished(this, error, bytesWritten);
+}
@@ -0,0 +1,93 @@
+//
+//  AUdpSocket.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__AUdpSocket__
+# define __Babel_Server__AUdpSocket__
+
+# include "ASocket.h"
+
+namespace Network {
+
+    class IUdpSocketDelegate;
+
+    //! Abstraction of a UDP socket
+    /*!
+     Datagram boundaries are preserved: each write() sends one datagram and
+     each read() receives one. Datagrams may be lost or reordered, nothing
+     is retransmitted.
+     connect() only sets the default peer of the socket: write() and read()
+     use it. send() and receive() work in batches, with any peer.
+     */
+    class AUdpSocket : public ASocket {
+    public:
+        //! A datagram and the peer it is sent to or received from
+        struct Datagram {
+            const void* data;
+            uint32_t    size;
+            //! IPv4 address in host order, 0 for the connected peer
+            uint32_t    ip;
+            uint16_t    port;
+        };
+
+        //! Maximum number of datagrams sent or received at once
+        static const size_t maxDatagrams = 32;
+
+        //! Constructs a UDP socket
+        AUdpSocket();
+        //! Destroys the socket
+        virtual ~AUdpSocket();
+
+        //! Binds the socket to a local address
+        /*!
+         \param port If zero, the port is choosen automatically
+         \param address If empty, datagrams are received on any address
+         */
+        virtual bool        bind(uint16_t port = 0, std::string address = "") = 0;
+
+        //! Returns the local port of the socket
+        virtual uint16_t    getLocalPort() const = 0;
+
+        //! Asynchronously receive the datagrams available
+        /*!
+         Waits for at least one datagram, then receives all those available,
+         up to maxDatagrams, and calls datagramsReceived() once with them.
+         The datagrams point to the buffer of the socket: they are only
+         valid until the next receive().
+         \param maxSize Size of the largest datagram, larger ones are
+         truncated
+         */
+        virtual void        receive(uint32_t maxSize) = 0;
+
+        //! Asynchronously send several datagrams
+        /*!
+         The datagrams are sent in order, with as few system calls as
+         possible. Their content is not copied: it must stay valid until
+         writeFinished() is called, once, with the total number of bytes
+         sent.
+         \param datagrams An array of count datagrams
+         \param count The number of datagrams, at most maxDatagrams
+         */
+        virtual void        send(Datagram const* datagrams, size_t count) = 0;
+
+        //! Returns the delegate
+        IUdpSocketDelegate* getDelegate() const;
+
+        //! Set the delegate
+        void setDelegate(IUdpSocketDelegate* delegate);
+
+    protected:
+        virtual void _connected(ASocket::Error error);
+        virtual void _readFinished(ASocket::Error error, size_t bytesRead);
+        virtual void _datagramsReceived(ASocket::Error error,
+                                        Datagram const* datagrams, size_t count);
+        virtual void _writeFinished(ASocket::Error error, size_t bytesWritten);
+
+    private:
+        IUdpSocketDelegate* _delegate;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__AUdpSocket__) */
@@ -0,0 +1,129 @@
+//
+//  BoostLocalServer.cpp
+//  Babel Server
+//
+
+#include "BoostLocalServer.h"
+#include "ITcpServerDelegate.h"
+
+#include <boost/bind.hpp>
+#include <unistd.h>
+
+Network::BoostLocalServer::BoostLocalServer(boost::asio::io_service* service) :
+  _acceptor(*service), _peer(*service), _ioService(service),
+  _ownStrand(*service), _strand(&_ownStrand), _path(), _pool(), _poolMutex()
+{
+    _pool.reserve(maxPooledSockets);
+}
+
+Network::BoostLocalServer::~BoostLocalServer()
+{
+    close();
+    if (!_path.empty())
+        ::unlink(_path.c_str());
+    for (size_t i = 0; i < _pool.size(); ++i)
+        delete _pool[i];
+}
+
+bool Network::BoostLocalServer::listen(uint16_t, std::string address)
+{
+    if (_acceptor.is_open() || address.empty())
+        return false;
+    try {
+        boost::asio::local::stream_protocol::endpoint endpoint(address);
+
+        // Left by a previous run which did not exit cleanly
+        ::unlink(address.c_str());
+        _acceptor.open(endpoint.protocol());
+        _acceptor.bind(endpoint);
+        _path = address;
+        _acceptor.listen(getMaxPendingConnections());
+        _startAccept();
+    }
+    catch (boost::system::system_error const& error) {
+        boost::system::error_code ignored;
+
+        _acceptor.close(ignored);
+        return false;
+    }
+    return true;
+}
+
+void Network::BoostLocalServer::_startAccept()
+{
+    _acceptor.async_accept(_peer,
+                           _strand->wrap(boost::bind(&Network::BoostLocalServer::_acceptHandler,
+                                                     this,
+                                                     boost::asio::placeholders::error)));
+}
+
+void Network::BoostLocalServer::_acceptHandler(const boost::system::error_code& error)
+{
+    // The acceptor is closed
+    if (error == boost::asio::error::operation_aborted)
+        return ;
+    if (!error) {
+        BoostLocalSocket* socket = NULL;
+        {
+            boost::mutex::scoped_lock lock(_poolMutex);
+            if (!_pool.empty()) {
+                socket = _pool.back();
+                _pool.pop_back();
+            }
+        }
+        if (socket == NULL)
+            socket = new BoostLocalSocket(_ioService);
+        if (_strand != &_ownStrand)
+            socket->setStrand(_strand);
+        if (socket->adopt(_peer))
+            _newConnection(socket);
+        else
+            release(socket);
+    }
+    _startAccept();
+}
+
+void Network::BoostLocalServer::close()
+{
+    boost::system::error_code error;
+
+    setDelegate(NULL);
+    _acceptor.close(error);
+}
+
+void Network::BoostLocalServer::release(ATcpSocket* socket)
+{
+    BoostLocalSocket* localSocket = dynamic_cast<BoostLocalSocket*>(socket);
+
+    if (localSocket == NULL) {
+        delete socket;
+        return ;
+    }
+    // Pooled once the handlers of its pending operations have run
+    localSocket->recycle(boost::bind(&Network::BoostLocalServer::_recycled, this, localSocket));
+}
+
+void Network::BoostLocalServer::_recycled(BoostLocalSocket* socket)
+{
+    boost::mutex::scoped_lock lock(_poolMutex);
+
+    if (_pool.size() < maxPooledSockets)
+        _pool.push_back(socket);
+    else
+        delete socket;
+}
+
+void Network::BoostLocalServer::setStrand(boost::asio::io_service::strand* strand)
+{
+    _strand = strand;
+}
+
+std::string Network::BoostLocalServer::getAddress() const
+{
+    return _path;
+}
+
+uint16_t Network::BoostLocalServer::getPort() const
+{
+    return 0;
+}
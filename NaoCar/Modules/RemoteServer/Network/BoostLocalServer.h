@@ -0,0 +1,74 @@
+//
+//  BoostLocalServer.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__BoostLocalServer__
+# define __Babel_Server__BoostLocalServer__
+
+# include <boost/asio.hpp>
+# include <boost/thread/mutex.hpp>
+# include <vector>
+
+# include "ATcpServer.h"
+# include "BoostLocalSocket.h"
+
+namespace Network {
+
+    //! Boost implementation of a stream server over AF_UNIX
+    /*!
+     Accepts the processes of the same host on a socket file, and hands
+     them BoostLocalSockets: the delegate serves them like TCP clients.
+     The address given to listen() is the path of the socket file, the port
+     is unused. A file left by a previous run is replaced, the file is
+     removed when the server is destroyed.
+     Released sockets are kept in a pool, as by BoostTcpServer.
+     */
+
+    class BoostLocalServer : public ATcpServer {
+    public:
+
+        BoostLocalServer(boost::asio::io_service* service);
+        virtual ~BoostLocalServer();
+
+        virtual bool listen(uint16_t port, std::string address);
+        //! Returns the path of the socket file
+        virtual std::string getAddress() const;
+        //! Returns 0, there is no port
+        virtual uint16_t getPort() const;
+        virtual void close();
+
+        //! Accepts and runs the handlers of the accepted sockets in strand
+        /*!
+         Must be called before listen(). By default each socket has its own
+         strand.
+         */
+        void setStrand(boost::asio::io_service::strand* strand);
+
+        //! Keeps the socket for a later connection, may be called from any thread
+        virtual void release(ATcpSocket* socket);
+
+        //! Maximum number of sockets kept for reuse
+        static const size_t maxPooledSockets = 16;
+
+    private:
+
+        void _startAccept();
+        //! Called once the aborted operations of a released socket are done
+        void _recycled(BoostLocalSocket* socket);
+        void _acceptHandler(const boost::system::error_code& error);
+
+        boost::asio::local::stream_protocol::acceptor   _acceptor;
+        //! Connection being accepted, adopted by a BoostLocalSocket
+        boost::asio::local::stream_protocol::socket     _peer;
+        boost::asio::io_service*        _ioService;
+        boost::asio::io_service::strand _ownStrand;
+        boost::asio::io_service::strand*    _strand;
+        std::string                     _path;
+        std::vector<BoostLocalSocket*>  _pool;
+        boost::mutex                    _poolMutex;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__BoostLocalServer__) */
@@ -0,0 +1,95 @@
+//
+//  BoostLocalSocket.cpp
+//  Babel Server
+//
+
+#include "BoostLocalSocket.h"
+
+#include <boost/bind.hpp>
+#include <unistd.h>
+
+Network::BoostLocalSocket::BoostLocalSocket(boost::asio::io_service* service) :
+    BoostTcpSocket(service), _connecting(*service)
+{
+}
+
+Network::BoostLocalSocket::~BoostLocalSocket()
+{
+}
+
+void Network::BoostLocalSocket::connect(std::string host, uint16_t)
+{
+    boost::system::error_code error;
+
+    _connecting.close(error);
+    try {
+        _beginOperation();
+        _connecting.async_connect(boost::asio::local::stream_protocol::endpoint(host),
+                                  getStrand().wrap(boost::bind(&Network::BoostLocalSocket::_localConnectHandler,
+                                                               this,
+                                                               boost::asio::placeholders::error)));
+    }
+    catch (boost::system::system_error const& e) {
+        // The path is too long for a socket address
+        _operationCompleted();
+        _connected(ASocket::HostNotFound);
+    }
+}
+
+void Network::BoostLocalSocket::_localConnectHandler(const boost::system::error_code& ec)
+{
+    if (!_operationCompleted())
+        return ;
+    if (!ec && adopt(_connecting))
+        _connected(ASocket::NoError);
+    else
+        _connected(ASocket::HostUnreachable);
+}
+
+bool Network::BoostLocalSocket::adopt(boost::asio::local::stream_protocol::socket& socket)
+{
+    boost::system::error_code error;
+    // Old versions of Boost cannot release a descriptor from its socket,
+    // it is duplicated instead
+    int fd = ::dup(socket.native_handle());
+
+    socket.close(error);
+    if (fd < 0)
+        return false;
+    getBoostSocket()->assign(boost::asio::ip::tcp::v4(), fd, error);
+    if (error) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+}
+
+std::string Network::BoostLocalSocket::getRemoteIp() const
+{
+    return "";
+}
+
+uint32_t Network::BoostLocalSocket::getBinaryRemoteIp() const
+{
+    return 0;
+}
+
+uint16_t    Network::BoostLocalSocket::getRemotePort() const
+{
+    return 0;
+}
+
+bool Network::BoostLocalSocket::setNoDelay(bool enabled)
+{
+    return enabled;
+}
+
+bool Network::BoostLocalSocket::setNotSentLowWatermark(int)
+{
+    return false;
+}
+
+bool Network::BoostLocalSocket::setKeepAlive(unsigned int idleSeconds)
+{
+    return idleSeconds == 0;
+}
@@ -0,0 +1,54 @@
+//
+//  BoostLocalSocket.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__BoostLocalSocket__
+#define __Babel_Server__BoostLocalSocket__
+
+#include "BoostTcpSocket.h"
+
+#include <boost/asio.hpp>
+
+namespace Network {
+
+    //! Boost implementation of a stream socket over AF_UNIX
+    /*!
+     Connects processes of the same host without going through the TCP
+     stack. The connected descriptor is driven by the BoostTcpSocket, which
+     only reads and writes it: strands, timeouts and write queue work the
+     same way.
+     The host given to connect() is the path of the socket, the port is
+     unused. There is no IP, port, Nagle or keep-alive on a local socket.
+     */
+
+    class BoostLocalSocket : public BoostTcpSocket {
+    public:
+        BoostLocalSocket(boost::asio::io_service* service);
+        virtual ~BoostLocalSocket();
+
+        virtual void connect(std::string host, uint16_t port);
+
+        virtual std::string getRemoteIp() const;
+        virtual uint32_t    getBinaryRemoteIp() const;
+        virtual uint16_t    getRemotePort() const;
+
+        //! Writes are never delayed, enabling it always succeeds
+        virtual bool setNoDelay(bool enabled);
+        virtual bool setNotSentLowWatermark(int size);
+        //! A vanished peer is noticed at once, disabling it always succeeds
+        virtual bool setKeepAlive(unsigned int idleSeconds);
+
+        //! Takes over the connection of socket, which is left closed
+        bool    adopt(boost::asio::local::stream_protocol::socket& socket);
+
+    private:
+        void _localConnectHandler(const boost::system::error_code& ec);
+
+        //! Socket being connected, its descriptor is then adopted
+        boost::asio::local::stream_protocol::socket _connecting;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__BoostLocalSocket__) */
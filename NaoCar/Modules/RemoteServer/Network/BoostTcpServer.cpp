@@ -12,14 +12,19 @@
 #include <boost/bind.hpp>
 
 Network::BoostTcpServer::BoostTcpServer(boost::asio::io_service* service) :
-  _acceptor(NULL), _ioService(service)
+  _acceptor(NULL), _ioService(service), _ownStrand(*service),
+  _strand(&_ownStrand), _pool(), _poolMutex()
 {
     _acceptor = new boost::asio::ip::tcp::acceptor(*service);
+    _pool.reserve(maxPooledSockets);
 }
 
 Network::BoostTcpServer::~BoostTcpServer()
 {
+    close();
     delete _acceptor;
+    for (size_t i = 0; i < _pool.size(); ++i)
+        delete _pool[i];
 }
 
 bool Network::BoostTcpServer::listen(uint16_t port, std::string address)
@@ -45,12 +50,23 @@ bool Network::BoostTcpServer::listen(uint16_t port, std::string address)
 
 void Network::BoostTcpServer::_startAccept()
 {
-    BoostTcpSocket* socket = new BoostTcpSocket(_ioService);
+    BoostTcpSocket* socket = NULL;
+    {
+        boost::mutex::scoped_lock lock(_poolMutex);
+        if (!_pool.empty()) {
+            socket = _pool.back();
+            _pool.pop_back();
+        }
+    }
+    if (socket == NULL)
+        socket = new BoostTcpSocket(_ioService);
+    if (_strand != &_ownStrand)
+        socket->setStrand(_strand);
     _acceptor->async_accept(*socket->getBoostSocket(),
-                            boost::bind(&Network::BoostTcpServer::_acceptHandler,
-                                        this,
-                                        boost::asio::placeholders::error,
-                                        socket));
+                            _strand->wrap(boost::bind(&Network::BoostTcpServer::_acceptHandler,
+                                                      this,
+                                                      boost::asio::placeholders::error,
+                                                      socket)));
 }
 
 void Network::BoostTcpServer::_acceptHandler(const boost::system::error_code& error,
@@ -58,9 +74,54 @@ void Network::BoostTcpServer::_acceptHandler(const boost::system::error_code& er
 {
     if (!error)
         _newConnection(socket);
+    else
+        release(socket);
+    // Aborted by close()
+    if (_acceptor->is_open())
+        _startAccept();
+}
+
+void Network::BoostTcpServer::close()
+{
+    boost::system::error_code error;
+
+    setDelegate(NULL);
+    _acceptor->close(error);
+}
+
+void Network::BoostTcpServer::drain(boost::asio::io_service* service)
+{
+    // A handler may post others, such as the end of a recycle
+    service->reset();
+    while (service->poll() > 0)
+        ;
+}
+
+void Network::BoostTcpServer::release(ATcpSocket* socket)
+{
+    BoostTcpSocket* boostSocket = dynamic_cast<BoostTcpSocket*>(socket);
+
+    if (boostSocket == NULL) {
+        delete socket;
+        return ;
+    }
+    // Pooled once the handlers of its pending operations have run
+    boostSocket->recycle(boost::bind(&Network::BoostTcpServer::_recycled, this, boostSocket));
+}
+
+void Network::BoostTcpServer::_recycled(BoostTcpSocket* socket)
+{
+    boost::mutex::scoped_lock lock(_poolMutex);
+
+    if (_pool.size() < maxPooledSockets)
+        _pool.push_back(socket);
     else
         delete socket;
-    _startAccept();
+}
+
+void Network::BoostTcpServer::setStrand(boost::asio::io_service::strand* strand)
+{
+    _strand = strand;
 }
 
 std::string Network::BoostTcpServer::getAddress() const
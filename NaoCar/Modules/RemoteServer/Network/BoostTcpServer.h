@@ -10,6 +10,8 @@
 # define __Babel_Server__BoostTcpServer__
 
 # include <boost/asio.hpp>
+# include <boost/thread/mutex.hpp>
+# include <vector>
 
 # include "ATcpServer.h"
 # include "BoostTcpSocket.h"
@@ -17,6 +19,12 @@
 namespace Network {
     
     //! Boost implementation of a Tcp Server
+    /*!
+     Released sockets are kept in a pool and reused by the next accepts, so
+     a client connecting again does not allocate a socket.
+     The server and its sockets are destroyed once the io_service is stopped,
+     closed and drained: their pending handlers use them.
+     */
     
     class BoostTcpServer : public ATcpServer {
     public:
@@ -27,15 +35,43 @@ namespace Network {
         virtual bool listen(uint16_t port, std::string address);
         virtual std::string getAddress() const;
         virtual uint16_t getPort() const;
+        virtual void close();
+
+        //! Accepts and runs the handlers of the accepted sockets in strand
+        /*!
+         Must be called before listen(). By default each socket has its own
+         strand.
+         */
+        void setStrand(boost::asio::io_service::strand* strand);
+
+        //! Keeps the socket for a later connection, may be called from any thread
+        virtual void release(ATcpSocket* socket);
+
+        //! Maximum number of sockets kept for reuse
+        static const size_t maxPooledSockets = 16;
+
+        //! Runs the handlers left in a stopped io_service
+        /*!
+         The aborted operations of the released sockets complete and the
+         sockets are recycled. Once it returns, the servers, sockets and
+         objects bound to the handlers may be destroyed.
+         */
+        static void drain(boost::asio::io_service* service);
         
     private:
         
         void _startAccept();
+        //! Called once the aborted operations of a released socket are done
+        void _recycled(BoostTcpSocket* socket);
         void _acceptHandler(const boost::system::error_code& error,
                             BoostTcpSocket* socket);
         
         boost::asio::ip::tcp::acceptor* _acceptor;
 	boost::asio::io_service*	_ioService;
+        boost::asio::io_service::strand _ownStrand;
+        boost::asio::io_service::strand*    _strand;
+        std::vector<BoostTcpSocket*>    _pool;
+        boost::mutex                    _poolMutex;
     };
     
 }
@@ -8,21 +8,32 @@
 
 #include "BoostTcpSocket.h"
 
+#include <cassert>
 #include <sstream>
+#include <boost/array.hpp>
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/asio.hpp>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include "ITcpSocketDelegate.h"
 
 Network::BoostTcpSocket::BoostTcpSocket(boost::asio::io_service* service) :
-    ATcpSocket(), _socket(NULL), _ioService(service)
+    ATcpSocket(), _socket(NULL), _ioService(service), _ownStrand(*service),
+    _strand(&_ownStrand), _writeQueue(4), _deadlineTimer(*service),
+    _deadlineTimerExpiry(), _outstanding(0), _recycled()
 {
   _socket = new boost::asio::ip::tcp::socket(*_ioService);
+  for (int i = 0; i < TimeoutCount; ++i)
+      _timeouts[i] = 0;
 }
 
 Network::BoostTcpSocket::~BoostTcpSocket()
 {
+    // The pending handlers are allocated in the socket: it is recycled, and
+    // they have run, before it is destroyed
+    assert(_outstanding == 0);
     delete _socket;
 }
 
@@ -35,12 +46,13 @@ void Network::BoostTcpSocket::connect(std::string host, uint16_t port)
     boost::shared_ptr<boost::asio::ip::tcp::resolver>
         resolver(new boost::asio::ip::tcp::resolver(*_ioService));
     
+    _beginOperation();
     resolver->async_resolve(resolverQuery,
-                           boost::bind(&Network::BoostTcpSocket::_resolveHandler,
-                                       this,
-                                        resolver,
-                                        boost::asio::placeholders::error,
-                                        boost::asio::placeholders::iterator));
+                            _strand->wrap(boost::bind(&Network::BoostTcpSocket::_resolveHandler,
+                                                      this,
+                                                      resolver,
+                                                      boost::asio::placeholders::error,
+                                                      boost::asio::placeholders::iterator)));
 }
 
 void Network::BoostTcpSocket::close()
@@ -52,12 +64,15 @@ void Network::BoostTcpSocket::_resolveHandler(boost::shared_ptr<boost::asio::ip:
                                               const boost::system::error_code& ec,
                                               boost::asio::ip::tcp::resolver::iterator endpoints)
 {
+    if (!_operationCompleted())
+        return ;
     if (!ec)
     {
+      _beginOperation();
       _socket->async_connect((*endpoints).endpoint(),
-			     boost::bind(&Network::BoostTcpSocket::_connectHandler,
-					 this,
-					 boost::asio::placeholders::error));
+			     _strand->wrap(boost::bind(&Network::BoostTcpSocket::_connectHandler,
+						       this,
+						       boost::asio::placeholders::error)));
     }
     else
         _connected(ASocket::HostNotFound);
@@ -65,6 +80,8 @@ void Network::BoostTcpSocket::_resolveHandler(boost::shared_ptr<boost::asio::ip:
 
 void Network::BoostTcpSocket::_connectHandler(const boost::system::error_code& ec)
 {
+    if (!_operationCompleted())
+        return ;
     if (!ec)
         _connected(ASocket::NoError);
     else
@@ -73,32 +90,51 @@ void Network::BoostTcpSocket::_connectHandler(const boost::system::error_code& e
 
 void Network::BoostTcpSocket::read(void* buffer, uint32_t size, bool all)
 {
+    if (_timeouts[ReadTimeout] != 0) {
+        _beginOperation();
+        _strand->dispatch(boost::bind(&Network::BoostTcpSocket::_startDeadlineHandler,
+                                      this, ReadTimeout));
+    }
+    _beginOperation();
     if (all)
         boost::asio::async_read(*_socket, boost::asio::buffer(buffer, size),
-                                boost::bind(&Network::BoostTcpSocket::_readHandler,
-                                            this,
-                                            boost::asio::placeholders::error,
-                                            boost::asio::placeholders::bytes_transferred));
+                                _strand->wrap(makeAllocatedHandler(_readAllocator,
+                                                                   boost::bind(&Network::BoostTcpSocket::_readHandler,
+                                                                               this,
+                                                                               boost::asio::placeholders::error,
+                                                                               boost::asio::placeholders::bytes_transferred))));
     else
         _socket->async_read_some(boost::asio::buffer(buffer, size),
-                                 boost::bind(&Network::BoostTcpSocket::_readHandler,
-                                             this,
-                                             boost::asio::placeholders::error,
-                                             boost::asio::placeholders::bytes_transferred));
+                                 _strand->wrap(makeAllocatedHandler(_readAllocator,
+                                                                    boost::bind(&Network::BoostTcpSocket::_readHandler,
+                                                                                this,
+                                                                                boost::asio::placeholders::error,
+                                                                                boost::asio::placeholders::bytes_transferred))));
 }
 
 void Network::BoostTcpSocket::readUntil(std::string const& delim) {
+  if (_timeouts[ReadTimeout] != 0) {
+    _beginOperation();
+    _strand->dispatch(boost::bind(&Network::BoostTcpSocket::_startDeadlineHandler,
+                                  this, ReadTimeout));
+  }
+  _beginOperation();
   boost::asio::async_read_until(*_socket, _readUntilBuffer, delim,
-				boost::bind(&Network::BoostTcpSocket::_readUntilHandler,
-					    this,
-					    boost::asio::placeholders::error,
-					    boost::asio::placeholders::bytes_transferred));
+				_strand->wrap(makeAllocatedHandler(_readAllocator,
+								   boost::bind(&Network::BoostTcpSocket::_readUntilHandler,
+									       this,
+									       boost::asio::placeholders::error,
+									       boost::asio::placeholders::bytes_transferred))));
 }
 
 
 void Network::BoostTcpSocket::_readHandler(const boost::system::error_code& ec,
                                            std::size_t bytesTransfered)
 {
+    if (!_operationCompleted())
+        return ;
+    _stopDeadline(ReadTimeout);
+    _startDeadline(IdleTimeout);
     if (!ec)
         _readFinished(ASocket::NoError, bytesTransfered);
     else
@@ -106,45 +142,203 @@ void Network::BoostTcpSocket::_readHandler(const boost::system::error_code& ec,
 }
 
 void Network::BoostTcpSocket::_readUntilHandler(const boost::system::error_code& ec,
-						std::size_t)
+						std::size_t bytesTransfered)
 {
   ITcpSocketDelegate*	delegate = getDelegate();
+  ASocket::Buffer	line = { NULL, 0 };
 
+  if (!_operationCompleted())
+    return ;
+  _stopDeadline(ReadTimeout);
+  _startDeadline(IdleTimeout);
   if (!delegate)
     return ;
   if (!ec) {
-    std::istream is(&_readUntilBuffer);
-    std::string data;
-    int length = _readUntilBuffer.size();
-    char * buffer = new char [length];
-
-    is.read(buffer,length);
-    data.assign(buffer, length);
-    delete buffer;
-    delegate->readFinished(this, ASocket::NoError, data);
+    // The input sequence of the streambuf is contiguous
+    line.data = boost::asio::buffer_cast<const void*>(*_readUntilBuffer.data().begin());
+    line.size = bytesTransfered;
+    // Consumed before the delegate is called, which may read again or
+    // destroy the socket. The memory is left untouched until the next read.
+    _readUntilBuffer.consume(bytesTransfered);
+    delegate->readFinished(this, ASocket::NoError, line);
   } else {
-    delegate->readFinished(this, ASocket::ReadError, "");
+    delegate->readFinished(this, ASocket::ReadError, line);
   }
 }
 
 void Network::BoostTcpSocket::write(const void* buffer, uint32_t size)
 {
-    boost::asio::async_write(*_socket, boost::asio::buffer(buffer, size),
-                             boost::bind(&Network::BoostTcpSocket::_writeHandler,
-                                         this,
-                                         boost::asio::placeholders::error,
-                                         boost::asio::placeholders::bytes_transferred));
+    WriteBuffers sequence;
+
+    sequence[0] = boost::asio::const_buffer(buffer, size);
+    _beginOperation();
+    _strand->dispatch(makeAllocatedHandler(_dispatchAllocator,
+                                           boost::bind(&Network::BoostTcpSocket::_write,
+                                                       this, sequence, SharedBuffer())));
+}
+
+void Network::BoostTcpSocket::write(Buffer const* buffers, size_t count)
+{
+    // Fixed size sequence: no allocation, unused segments are empty
+    WriteBuffers sequence;
+
+    assert(count <= maxWriteBuffers);
+    for (size_t i = 0; i < count; ++i)
+        sequence[i] = boost::asio::const_buffer(buffers[i].data, buffers[i].size);
+    // Runs right away when called from the strand, is queued otherwise
+    _beginOperation();
+    _strand->dispatch(makeAllocatedHandler(_dispatchAllocator,
+                                           boost::bind(&Network::BoostTcpSocket::_write,
+                                                       this, sequence, SharedBuffer())));
+}
+
+void Network::BoostTcpSocket::write(SharedBuffer const& buffer)
+{
+    WriteBuffers sequence;
+
+    // The handler holds a reference to the buffer, the data is not copied
+    sequence[0] = boost::asio::const_buffer(buffer.data(), buffer.size());
+    _beginOperation();
+    _strand->dispatch(makeAllocatedHandler(_dispatchAllocator,
+                                           boost::bind(&Network::BoostTcpSocket::_write,
+                                                       this, sequence, buffer)));
+}
+
+void Network::BoostTcpSocket::_write(WriteBuffers const& buffers,
+                                     SharedBuffer const& owner)
+{
+    QueuedWrite queued;
+
+    if (!_operationCompleted())
+        return ;
+    // Grows once to the largest backlog, then never allocates again
+    if (_writeQueue.full())
+        _writeQueue.set_capacity(_writeQueue.capacity() * 2);
+    queued.buffers = buffers;
+    queued.owner = owner;
+    _writeQueue.push_back(queued);
+    if (_writeQueue.size() == 1) {
+        _startDeadline(WriteTimeout);
+        _startWrite();
+    }
+    _writeQueued(boost::asio::buffer_size(buffers));
+}
+
+void Network::BoostTcpSocket::_startWrite()
+{
+    _beginOperation();
+    boost::asio::async_write(*_socket, _writeQueue.front().buffers,
+                             _strand->wrap(makeAllocatedHandler(_writeAllocator,
+                                                                boost::bind(&Network::BoostTcpSocket::_writeHandler,
+                                                                            this,
+                                                                            boost::asio::placeholders::error,
+                                                                            boost::asio::placeholders::bytes_transferred))));
 }
 
 void Network::BoostTcpSocket::_writeHandler(const boost::system::error_code& ec,
                                             std::size_t bytesTransfered)
 {
+    if (!_operationCompleted())
+        return ;
+    size_t queued = boost::asio::buffer_size(_writeQueue.front().buffers);
+
+    // Frees a shared buffer if this was its last write
+    _writeQueue.pop_front();
+    if (_writeQueue.empty())
+        _stopDeadline(WriteTimeout);
+    else
+        _startDeadline(WriteTimeout);
+    _startDeadline(IdleTimeout);
+    // The next write is started before notifying the delegate, which may
+    // queue more data or destroy the socket once its writes are done
+    if (!_writeQueue.empty())
+        _startWrite();
+    _writeDequeued(queued);
     if (!ec)
         _writeFinished(ASocket::NoError, bytesTransfered);
     else
         _writeFinished(ASocket::WriteError, bytesTransfered);
 }
 
+void Network::BoostTcpSocket::setTimeout(Timeout timeout, unsigned int milliseconds)
+{
+    _timeouts[timeout] = milliseconds;
+    if (timeout == IdleTimeout) {
+        _beginOperation();
+        _strand->dispatch(boost::bind(&Network::BoostTcpSocket::_startDeadlineHandler,
+                                      this, IdleTimeout));
+    }
+}
+
+void Network::BoostTcpSocket::_startDeadlineHandler(Timeout timeout)
+{
+    if (_operationCompleted())
+        _startDeadline(timeout);
+}
+
+void Network::BoostTcpSocket::_startDeadline(Timeout timeout)
+{
+    if (_timeouts[timeout] == 0) {
+        _deadlines[timeout] = boost::posix_time::not_a_date_time;
+        return ;
+    }
+    _deadlines[timeout] = boost::asio::deadline_timer::traits_type::now()
+        + boost::posix_time::milliseconds(_timeouts[timeout]);
+    _armDeadlineTimer();
+}
+
+void Network::BoostTcpSocket::_stopDeadline(Timeout timeout)
+{
+    // The timer is left running, it finds nothing to do when it expires
+    _deadlines[timeout] = boost::posix_time::not_a_date_time;
+}
+
+void Network::BoostTcpSocket::_armDeadlineTimer()
+{
+    boost::posix_time::ptime earliest;
+
+    for (int i = 0; i < TimeoutCount; ++i)
+        if (!_deadlines[i].is_not_a_date_time()
+            && (earliest.is_not_a_date_time() || _deadlines[i] < earliest))
+            earliest = _deadlines[i];
+    if (earliest.is_not_a_date_time())
+        return ;
+    // A pending wait expiring first is kept, it re-arms the timer
+    if (!_deadlineTimerExpiry.is_not_a_date_time() && _deadlineTimerExpiry <= earliest)
+        return ;
+    _deadlineTimerExpiry = earliest;
+    _deadlineTimer.expires_at(earliest);
+    _beginOperation();
+    _deadlineTimer.async_wait(_strand->wrap(makeAllocatedHandler(_deadlineAllocator,
+                                                                 boost::bind(&Network::BoostTcpSocket::_deadlineHandler,
+                                                                             this,
+                                                                             boost::asio::placeholders::error))));
+}
+
+void Network::BoostTcpSocket::_deadlineHandler(const boost::system::error_code& ec)
+{
+    if (!_operationCompleted())
+        return ;
+    // Re-armed for an earlier deadline
+    if (ec == boost::asio::error::operation_aborted)
+        return ;
+    _deadlineTimerExpiry = boost::posix_time::not_a_date_time;
+    if (!_socket->is_open())
+        return ;
+
+    boost::posix_time::ptime now = boost::asio::deadline_timer::traits_type::now();
+    int expired = TimeoutCount;
+
+    for (int i = 0; i < TimeoutCount && expired == TimeoutCount; ++i)
+        if (!_deadlines[i].is_not_a_date_time() && _deadlines[i] <= now)
+            expired = i;
+    if (expired != TimeoutCount)
+        _deadlines[expired] = boost::posix_time::not_a_date_time;
+    _armDeadlineTimer();
+    if (expired != TimeoutCount)
+        _timedOut(static_cast<Timeout>(expired));
+}
+
 std::string Network::BoostTcpSocket::getRemoteIp() const
 {
     try {
@@ -187,3 +381,143 @@ boost::asio::ip::tcp::socket*   Network::BoostTcpSocket::getBoostSocket() const
 {
     return _socket;
 }
+
+bool Network::BoostTcpSocket::setNoDelay(bool enabled)
+{
+    boost::system::error_code error;
+
+    _socket->set_option(boost::asio::ip::tcp::no_delay(enabled), error);
+    return !error;
+}
+
+bool Network::BoostTcpSocket::setSendBufferSize(int size)
+{
+    boost::system::error_code error;
+
+    _socket->set_option(boost::asio::socket_base::send_buffer_size(size), error);
+    return !error;
+}
+
+bool Network::BoostTcpSocket::setReceiveBufferSize(int size)
+{
+    boost::system::error_code error;
+
+    _socket->set_option(boost::asio::socket_base::receive_buffer_size(size), error);
+    return !error;
+}
+
+bool Network::BoostTcpSocket::setNotSentLowWatermark(int size)
+{
+#ifdef TCP_NOTSENT_LOWAT
+    typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_NOTSENT_LOWAT>
+        NotSentLowWatermark;
+    boost::system::error_code error;
+
+    // 0 would mean that nothing may be left unsent, the system default is
+    // set back instead
+    _socket->set_option(NotSentLowWatermark(size > 0 ? size : 0x7fffffff), error);
+    return !error;
+#else
+    // Linux 3.12 and later
+    (void)size;
+    return false;
+#endif
+}
+
+bool Network::BoostTcpSocket::setKeepAlive(unsigned int idleSeconds)
+{
+    boost::system::error_code error;
+
+    _socket->set_option(boost::asio::socket_base::keep_alive(idleSeconds > 0), error);
+    if (error || idleSeconds == 0)
+        return !error;
+#ifdef TCP_KEEPIDLE
+    typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPIDLE>
+        KeepAliveIdle;
+    typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPINTVL>
+        KeepAliveInterval;
+    typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_KEEPCNT>
+        KeepAliveCount;
+
+    // The connection is dropped after the idle time and 3 unanswered probes
+    // one second apart
+    _socket->set_option(KeepAliveIdle(idleSeconds), error);
+    if (!error)
+        _socket->set_option(KeepAliveInterval(1), error);
+    if (!error)
+        _socket->set_option(KeepAliveCount(3), error);
+#endif
+    return !error;
+}
+
+void Network::BoostTcpSocket::recycle(boost::function<void ()> const& recycled)
+{
+    // The handlers run in the strand in use, which reset() forgets
+    _strand->dispatch(boost::bind(&Network::BoostTcpSocket::_recycle,
+                                  this, recycled));
+}
+
+void Network::BoostTcpSocket::_recycle(boost::function<void ()> const& recycled)
+{
+    boost::system::error_code error;
+
+    _recycled = recycled;
+    setDelegate(NULL);
+    // The pending operations complete with operation_aborted
+    _socket->close(error);
+    _deadlineTimer.cancel(error);
+    if (_outstanding == 0)
+        _finishRecycle();
+}
+
+void Network::BoostTcpSocket::_beginOperation()
+{
+    ++_outstanding;
+}
+
+bool Network::BoostTcpSocket::_operationCompleted()
+{
+    unsigned int outstanding = --_outstanding;
+
+    if (_recycled.empty())
+        return true;
+    if (outstanding == 0)
+        _finishRecycle();
+    return false;
+}
+
+void Network::BoostTcpSocket::_finishRecycle()
+{
+    boost::function<void ()> recycled;
+
+    recycled.swap(_recycled);
+    _reset();
+    // Posted: it may destroy the socket, whose handler is still running
+    _ioService->post(recycled);
+}
+
+void Network::BoostTcpSocket::_reset()
+{
+    _socket->close();
+    setDelegate(NULL);
+    _strand = &_ownStrand;
+    _readUntilBuffer.consume(_readUntilBuffer.size());
+    _writeQueue.clear();
+    _clearWriteQueue();
+    for (int i = 0; i < TimeoutCount; ++i) {
+        _timeouts[i] = 0;
+        _deadlines[i] = boost::posix_time::not_a_date_time;
+    }
+    _deadlineTimer.cancel();
+    _deadlineTimerExpiry = boost::posix_time::not_a_date_time;
+}
+
+void Network::BoostTcpSocket::setStrand(boost::asio::io_service::strand* strand)
+{
+    _strand = strand != NULL ? strand : &_ownStrand;
+}
+
+boost::asio::io_service::strand&    Network::BoostTcpSocket::getStrand() const
+{
+    return *_strand;
+}
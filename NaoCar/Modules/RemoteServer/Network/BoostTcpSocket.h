@@ -11,10 +11,34 @@
 
 #include "ATcpSocket.h"
 
+#include <atomic>
+#include <boost/array.hpp>
 #include <boost/asio.hpp>
+#include <boost/circular_buffer.hpp>
+#include <boost/function.hpp>
+
+#include "HandlerAllocator.h"
 
 namespace Network {
 
+    //! Boost implementation of a Tcp Socket
+    /*!
+     The completion handlers of a socket run in a strand, so the socket can
+     be used with an io_service run by several threads: by default each
+     socket has its own strand, a shared one serializes the handlers of
+     several sockets. Writes may be requested from any thread, they are
+     started in the strand.
+     The deadlines share a single timer, which is armed for the earliest
+     one: moving a deadline later on each read or write costs nothing, the
+     timer is only re-armed when it expires.
+     Each kind of operation has its own HandlerAllocator: once the write
+     queue has grown to its largest backlog, reads and writes do not
+     allocate.
+     Every handler bound to the socket is counted, so that a recycled
+     socket waits for its aborted operations before it is reused or
+     destroyed.
+     */
+
     class BoostTcpSocket : public ATcpSocket {
     public:
         BoostTcpSocket(boost::asio::io_service* service);
@@ -25,6 +49,14 @@ namespace Network {
         virtual void read(void* buffer, uint32_t size, bool all);
         virtual void readUntil(std::string const& delim);
         virtual void write(const void* buffer, uint32_t size);
+        virtual void write(Buffer const* buffers, size_t count);
+        virtual void write(SharedBuffer const& buffer);
+        virtual void setTimeout(Timeout timeout, unsigned int milliseconds);
+        virtual bool setNoDelay(bool enabled);
+        virtual bool setSendBufferSize(int size);
+        virtual bool setReceiveBufferSize(int size);
+        virtual bool setNotSentLowWatermark(int size);
+        virtual bool setKeepAlive(unsigned int idleSeconds);
 
         virtual std::string getRemoteIp() const;
 
@@ -36,7 +68,49 @@ namespace Network {
 
         boost::asio::ip::tcp::socket*   getBoostSocket() const;
 
+        //! Closes the socket and prepares it for a new connection
+        /*!
+         The pending operations are aborted, their handlers no longer call
+         the delegate. Once the last one has run, the socket forgets its
+         delegate, strand, timeouts and buffered data, and recycled is
+         posted to the io_service: it may reuse or destroy the socket.
+         May be called from any thread, the socket must not be used
+         afterwards.
+         */
+        void    recycle(boost::function<void ()> const& recycled);
+
+        //! Runs the handlers in strand, which must outlive the socket
+        /*!
+         NULL gives the socket back its own strand. No handler may be
+         pending in the previous strand.
+         */
+        void    setStrand(boost::asio::io_service::strand* strand);
+        boost::asio::io_service::strand&    getStrand() const;
+
+    protected:
+        //! Counts an operation whose handler is bound to the socket
+        void _beginOperation();
+        //! Called first by each handler
+        /*!
+         \return false if the socket is being recycled: the handler must
+         return at once, the socket may already be reset
+         */
+        bool _operationCompleted();
+
     private:
+        typedef boost::array<boost::asio::const_buffer, maxWriteBuffers> WriteBuffers;
+
+        //! A write of the queue
+        struct QueuedWrite {
+            WriteBuffers    buffers;
+            //! Keeps the memory of a shared buffer until the write is done
+            SharedBuffer    owner;
+        };
+
+        //! Queues the buffers, and sends them if no write is in progress
+        void _write(WriteBuffers const& buffers, SharedBuffer const& owner);
+        //! Writes the front of the queue
+        void _startWrite();
 
         void _resolveHandler(boost::shared_ptr<boost::asio::ip::tcp::resolver> resolver,
                              const boost::system::error_code& ec,
@@ -50,9 +124,46 @@ namespace Network {
         void _writeHandler(const boost::system::error_code& ec,
                            std::size_t bytesTransfered);
 
+        //! Sets the deadline of an operation starting now, if enabled
+        void _startDeadline(Timeout timeout);
+        void _stopDeadline(Timeout timeout);
+        //! Arms the timer for the earliest deadline, if it is not already
+        void _armDeadlineTimer();
+        void _deadlineHandler(const boost::system::error_code& ec);
+        //! _startDeadline() dispatched from outside of the strand
+        void _startDeadlineHandler(Timeout timeout);
+
+        //! Closes the socket in the strand of its handlers
+        void _recycle(boost::function<void ()> const& recycled);
+        //! Called once no handler is left
+        void _finishRecycle();
+        //! Forgets the delegate, strand, timeouts and buffered data
+        void _reset();
+
         boost::asio::ip::tcp::socket*   _socket;
         boost::asio::io_service*        _ioService;
+        boost::asio::io_service::strand _ownStrand;
+        boost::asio::io_service::strand*    _strand;
 	boost::asio::streambuf		_readUntilBuffer;
+        //! Outbound queue, the front element is being written. Only used
+        //! in the strand.
+        boost::circular_buffer<QueuedWrite>     _writeQueue;
+        //! In milliseconds, 0 when disabled
+        unsigned int                    _timeouts[TimeoutCount];
+        //! Only used in the strand, not_a_date_time when not running
+        boost::posix_time::ptime        _deadlines[TimeoutCount];
+        boost::asio::deadline_timer     _deadlineTimer;
+        //! Expiry of the pending wait of the timer, if any
+        boost::posix_time::ptime        _deadlineTimerExpiry;
+        HandlerAllocator                _readAllocator;
+        HandlerAllocator                _writeAllocator;
+        HandlerAllocator                _deadlineAllocator;
+        //! Writes requested outside of the strand
+        HandlerAllocator                _dispatchAllocator;
+        //! Handlers bound to the socket which have not run yet
+        std::atomic<unsigned int>       _outstanding;
+        //! Set in the strand once the socket is being recycled
+        boost::function<void ()>        _recycled;
     };
 
 }
@@ -0,0 +1,402 @@
+//
+//  BoostUdpSocket.cpp
+//  Babel Server
+//
+
+#include "BoostUdpSocket.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "IUdpSocketDelegate.h"
+
+namespace {
+
+    // Without recvmmsg() and sendmmsg(), a batch costs one call per datagram
+
+    int receiveMessages(int socket, struct mmsghdr* messages, unsigned int count)
+    {
+#ifdef NETWORK_HAVE_MMSG
+        return recvmmsg(socket, messages, count, MSG_DONTWAIT, NULL);
+#else
+        unsigned int i;
+
+        for (i = 0; i < count; ++i) {
+            ssize_t size = recvmsg(socket, &messages[i].msg_hdr, MSG_DONTWAIT);
+            if (size < 0)
+                return i > 0 ? (int)i : -1;
+            messages[i].msg_len = size;
+        }
+        return i;
+#endif
+    }
+
+    int sendMessages(int socket, struct mmsghdr* messages, unsigned int count)
+    {
+#ifdef NETWORK_HAVE_MMSG
+        return sendmmsg(socket, messages, count, MSG_DONTWAIT);
+#else
+        unsigned int i;
+
+        for (i = 0; i < count; ++i) {
+            ssize_t size = sendmsg(socket, &messages[i].msg_hdr, MSG_DONTWAIT);
+            if (size < 0)
+                return i > 0 ? (int)i : -1;
+            messages[i].msg_len = size;
+        }
+        return i;
+#endif
+    }
+
+}
+
+Network::BoostUdpSocket::BoostUdpSocket(boost::asio::io_service* service) :
+    AUdpSocket(), _socket(NULL), _ioService(service), _ownStrand(*service),
+    _strand(&_ownStrand), _receiveBuffer(), _receiveSize(0), _sendQueue(),
+    _sendWaiting(false)
+{
+    _socket = new boost::asio::ip::udp::socket(*_ioService);
+    _socket->open(boost::asio::ip::udp::v4());
+}
+
+Network::BoostUdpSocket::~BoostUdpSocket()
+{
+    delete _socket;
+}
+
+bool Network::BoostUdpSocket::bind(uint16_t port, std::string address)
+{
+    try {
+        boost::asio::ip::udp::endpoint endpoint =
+        address == ""
+        ? boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port)
+        : boost::asio::ip::udp::endpoint(boost::asio::ip::address::from_string(address), port);
+
+        _socket->bind(endpoint);
+    }
+    catch (boost::system::system_error const& error) {
+        return false;
+    }
+    return true;
+}
+
+uint16_t Network::BoostUdpSocket::getLocalPort() const
+{
+    try {
+        return _socket->local_endpoint().port();
+    }
+    catch (boost::system::system_error const& e) {
+        return 0;
+    }
+}
+
+void Network::BoostUdpSocket::connect(std::string host, uint16_t port)
+{
+    std::stringstream portString;
+    portString << port;
+
+    boost::asio::ip::udp::resolver::query resolverQuery(boost::asio::ip::udp::v4(),
+                                                        host, portString.str());
+    boost::shared_ptr<boost::asio::ip::udp::resolver>
+        resolver(new boost::asio::ip::udp::resolver(*_ioService));
+
+    resolver->async_resolve(resolverQuery,
+                            _strand->wrap(boost::bind(&Network::BoostUdpSocket::_resolveHandler,
+                                                      this,
+                                                      resolver,
+                                                      boost::asio::placeholders::error,
+                                                      boost::asio::placeholders::iterator)));
+}
+
+void Network::BoostUdpSocket::close()
+{
+    _socket->close();
+}
+
+void Network::BoostUdpSocket::_resolveHandler(boost::shared_ptr<boost::asio::ip::udp::resolver>,
+                                              const boost::system::error_code& ec,
+                                              boost::asio::ip::udp::resolver::iterator endpoints)
+{
+    if (ec) {
+        _connected(ASocket::HostNotFound);
+        return ;
+    }
+    // Nothing is exchanged, the peer is only recorded by the system
+    boost::system::error_code error;
+    _socket->connect((*endpoints).endpoint(), error);
+    _connected(error ? ASocket::HostUnreachable : ASocket::NoError);
+}
+
+void Network::BoostUdpSocket::read(void* buffer, uint32_t size, bool)
+{
+    _socket->async_receive(boost::asio::buffer(buffer, size),
+                           _strand->wrap(boost::bind(&Network::BoostUdpSocket::_readHandler,
+                                                     this,
+                                                     boost::asio::placeholders::error,
+                                                     boost::asio::placeholders::bytes_transferred)));
+}
+
+void Network::BoostUdpSocket::_readHandler(const boost::system::error_code& ec,
+                                           std::size_t bytesTransfered)
+{
+    if (!ec)
+        _readFinished(ASocket::NoError, bytesTransfered);
+    else
+        _readFinished(ASocket::ReadError, bytesTransfered);
+}
+
+void Network::BoostUdpSocket::receive(uint32_t maxSize)
+{
+    if (_receiveSize != maxSize) {
+        _receiveBuffer.resize(maxSize * maxDatagrams);
+        _receiveSize = maxSize;
+    }
+    // Only waits for the socket to be readable, the datagrams are received
+    // all at once by the handler
+    _socket->async_receive(boost::asio::null_buffers(),
+                           _strand->wrap(boost::bind(&Network::BoostUdpSocket::_receiveHandler,
+                                                     this,
+                                                     boost::asio::placeholders::error)));
+}
+
+void Network::BoostUdpSocket::_receiveHandler(const boost::system::error_code& ec)
+{
+    struct mmsghdr      messages[maxDatagrams];
+    struct iovec        vectors[maxDatagrams];
+    struct sockaddr_in  addresses[maxDatagrams];
+
+    if (ec) {
+        _datagramsReceived(ASocket::ReadError, NULL, 0);
+        return ;
+    }
+    memset(messages, 0, sizeof(messages));
+    for (size_t i = 0; i < maxDatagrams; ++i) {
+        vectors[i].iov_base = &_receiveBuffer[i * _receiveSize];
+        vectors[i].iov_len = _receiveSize;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_name = &addresses[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    }
+    int count = receiveMessages(_socket->native_handle(), messages, maxDatagrams);
+    if (count < 0) {
+        // Readable but empty: the datagram has been taken by a read()
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            receive(_receiveSize);
+        else
+            _datagramsReceived(ASocket::ReadError, NULL, 0);
+        return ;
+    }
+    for (int i = 0; i < count; ++i) {
+        _received[i].data = vectors[i].iov_base;
+        // Truncated datagrams report their original size
+        _received[i].size = messages[i].msg_len < _receiveSize
+            ? messages[i].msg_len : _receiveSize;
+        _received[i].ip = ntohl(addresses[i].sin_addr.s_addr);
+        _received[i].port = ntohs(addresses[i].sin_port);
+    }
+    _datagramsReceived(ASocket::NoError, _received, count);
+}
+
+void Network::BoostUdpSocket::write(const void* buffer, uint32_t size)
+{
+    Send send;
+
+    send.datagrams[0].data = buffer;
+    send.datagrams[0].size = size;
+    send.datagrams[0].ip = 0;
+    send.datagrams[0].port = 0;
+    send.count = 1;
+    send.segmentCount = 0;
+    send.sent = 0;
+    send.bytes = 0;
+    _strand->dispatch(boost::bind(&Network::BoostUdpSocket::_write, this, send));
+}
+
+void Network::BoostUdpSocket::write(Buffer const* buffers, size_t count)
+{
+    Send send;
+
+    assert(count <= maxWriteBuffers);
+    for (size_t i = 0; i < count; ++i)
+        send.segments[i] = buffers[i];
+    send.segmentCount = count;
+    send.datagrams[0].ip = 0;
+    send.datagrams[0].port = 0;
+    send.count = 1;
+    send.sent = 0;
+    send.bytes = 0;
+    _strand->dispatch(boost::bind(&Network::BoostUdpSocket::_write, this, send));
+}
+
+void Network::BoostUdpSocket::send(Datagram const* datagrams, size_t count)
+{
+    Send send;
+
+    assert(count <= maxDatagrams);
+    for (size_t i = 0; i < count; ++i)
+        send.datagrams[i] = datagrams[i];
+    send.count = count;
+    send.segmentCount = 0;
+    send.sent = 0;
+    send.bytes = 0;
+    _strand->dispatch(boost::bind(&Network::BoostUdpSocket::_write, this, send));
+}
+
+void Network::BoostUdpSocket::_write(Send const& send)
+{
+    _sendQueue.push_back(send);
+    // Otherwise the queue is flushed when the socket is writable again
+    if (_sendQueue.size() == 1 && !_sendWaiting)
+        _flush();
+}
+
+void Network::BoostUdpSocket::_flush()
+{
+    if (_sendQueue.empty())
+        return ;
+    Send& send = _sendQueue.front();
+    ASocket::Error error = ASocket::NoError;
+
+    while (send.sent < send.count) {
+        if (_sendBatch(send) >= 0)
+            continue ;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            _sendWaiting = true;
+            _socket->async_send(boost::asio::null_buffers(),
+                                _strand->wrap(boost::bind(&Network::BoostUdpSocket::_sendHandler,
+                                                          this,
+                                                          boost::asio::placeholders::error)));
+            return ;
+        }
+        error = ASocket::WriteError;
+        break ;
+    }
+    size_t bytes = send.bytes;
+    _sendQueue.pop_front();
+    // The next sends are started after notifying the delegate, which may
+    // queue more data or destroy the socket
+    if (!_sendQueue.empty())
+        _strand->post(boost::bind(&Network::BoostUdpSocket::_flush, this));
+    _writeFinished(error, bytes);
+}
+
+int Network::BoostUdpSocket::_sendBatch(Send& send)
+{
+    struct mmsghdr      messages[maxDatagrams];
+    struct iovec        vectors[maxWriteBuffers > maxDatagrams ? maxWriteBuffers : maxDatagrams];
+    struct sockaddr_in  addresses[maxDatagrams];
+    size_t              count = send.count - send.sent;
+
+    memset(messages, 0, sizeof(messages));
+    if (send.segmentCount > 0) {
+        for (size_t i = 0; i < send.segmentCount; ++i) {
+            vectors[i].iov_base = const_cast<void*>(send.segments[i].data);
+            vectors[i].iov_len = send.segments[i].size;
+        }
+        messages[0].msg_hdr.msg_iov = vectors;
+        messages[0].msg_hdr.msg_iovlen = send.segmentCount;
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            Datagram const& datagram = send.datagrams[send.sent + i];
+
+            vectors[i].iov_base = const_cast<void*>(datagram.data);
+            vectors[i].iov_len = datagram.size;
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            if (datagram.ip == 0)
+                continue ;
+            memset(&addresses[i], 0, sizeof(addresses[i]));
+            addresses[i].sin_family = AF_INET;
+            addresses[i].sin_addr.s_addr = htonl(datagram.ip);
+            addresses[i].sin_port = htons(datagram.port);
+            messages[i].msg_hdr.msg_name = &addresses[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+        }
+    }
+    int sent = sendMessages(_socket->native_handle(), messages, count);
+    for (int i = 0; i < sent; ++i)
+        send.bytes += messages[i].msg_len;
+    if (sent > 0)
+        send.sent += sent;
+    return sent;
+}
+
+void Network::BoostUdpSocket::_sendHandler(const boost::system::error_code& ec)
+{
+    _sendWaiting = false;
+    if (!ec) {
+        _flush();
+        return ;
+    }
+    // Closed: the queued sends fail one after the other
+    if (_sendQueue.empty())
+        return ;
+    size_t bytes = _sendQueue.front().bytes;
+    _sendQueue.pop_front();
+    if (!_sendQueue.empty())
+        _strand->post(boost::bind(&Network::BoostUdpSocket::_sendHandler, this, ec));
+    _writeFinished(ASocket::WriteError, bytes);
+}
+
+std::string Network::BoostUdpSocket::getRemoteIp() const
+{
+    try {
+        boost::asio::ip::udp::endpoint endpoint = _socket->remote_endpoint();
+        return endpoint.address().to_string();
+    }
+    catch (boost::system::system_error const& e) {
+        return "";
+    }
+}
+
+uint32_t Network::BoostUdpSocket::getBinaryRemoteIp() const
+{
+    try {
+        boost::asio::ip::udp::endpoint endpoint = _socket->remote_endpoint();
+        return endpoint.address().to_v4().to_ulong();
+    }
+    catch (boost::system::system_error const& e) {
+        return 0;
+    }
+}
+
+uint16_t    Network::BoostUdpSocket::getRemotePort() const
+{
+    try {
+        boost::asio::ip::udp::endpoint endpoint = _socket->remote_endpoint();
+        return endpoint.port();
+    }
+    catch (boost::system::system_error const& e) {
+        return 0;
+    }
+}
+
+bool        Network::BoostUdpSocket::isConnected() const
+{
+    boost::system::error_code error;
+
+    _socket->remote_endpoint(error);
+    return !error;
+}
+
+boost::asio::ip::udp::socket*   Network::BoostUdpSocket::getBoostSocket() const
+{
+    return _socket;
+}
+
+void Network::BoostUdpSocket::setStrand(boost::asio::io_service::strand* strand)
+{
+    _strand = strand;
+}
+
+boost::asio::io_service::strand&    Network::BoostUdpSocket::getStrand() const
+{
+    return *_strand;
+}
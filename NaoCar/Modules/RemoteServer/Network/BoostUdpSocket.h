@@ -0,0 +1,102 @@
+//
+//  BoostUdpSocket.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__BoostUdpSocket__
+#define __Babel_Server__BoostUdpSocket__
+
+#include "AUdpSocket.h"
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
+#include <vector>
+
+namespace Network {
+
+    //! Boost implementation of a UDP socket
+    /*!
+     Boost only waits for the socket to be ready: the datagrams are then
+     received and sent in batches, with a single recvmmsg() or sendmmsg()
+     call when the system has them.
+     Like BoostTcpSocket, the completion handlers run in a strand and
+     writes may be requested from any thread.
+     */
+
+    class BoostUdpSocket : public AUdpSocket {
+    public:
+        BoostUdpSocket(boost::asio::io_service* service);
+        virtual ~BoostUdpSocket();
+
+        virtual void connect(std::string host, uint16_t port);
+        virtual void close();
+        virtual void read(void* buffer, uint32_t size, bool all);
+        virtual void write(const void* buffer, uint32_t size);
+        //! Sends the buffers as a single datagram
+        virtual void write(Buffer const* buffers, size_t count);
+
+        virtual bool        bind(uint16_t port, std::string address);
+        virtual uint16_t    getLocalPort() const;
+        virtual void        receive(uint32_t maxSize);
+        virtual void        send(Datagram const* datagrams, size_t count);
+
+        virtual std::string getRemoteIp() const;
+
+        virtual uint32_t getBinaryRemoteIp() const;
+
+        virtual uint16_t    getRemotePort() const;
+
+        virtual bool        isConnected() const;
+
+        boost::asio::ip::udp::socket*   getBoostSocket() const;
+
+        //! Runs the handlers in strand, which must outlive the socket
+        void    setStrand(boost::asio::io_service::strand* strand);
+        boost::asio::io_service::strand&    getStrand() const;
+
+    private:
+        //! Datagrams queued by a single write() or send()
+        struct Send {
+            Datagram        datagrams[maxDatagrams];
+            size_t          count;
+            //! Segments of the single datagram of a gathered write
+            Buffer          segments[maxWriteBuffers];
+            size_t          segmentCount;
+            //! Datagrams and bytes already sent
+            size_t          sent;
+            size_t          bytes;
+        };
+
+        //! Queues the datagrams, and sends them if no send is in progress
+        void _write(Send const& send);
+        //! Sends the queued datagrams until the socket would block
+        void _flush();
+        //! Sends the remaining datagrams of send, returns -1 on error
+        int  _sendBatch(Send& send);
+
+        void _resolveHandler(boost::shared_ptr<boost::asio::ip::udp::resolver> resolver,
+                             const boost::system::error_code& ec,
+                             boost::asio::ip::udp::resolver::iterator endpoints);
+        void _readHandler(const boost::system::error_code& ec,
+                          std::size_t bytesTransfered);
+        void _receiveHandler(const boost::system::error_code& ec);
+        void _sendHandler(const boost::system::error_code& ec);
+
+        boost::asio::ip::udp::socket*   _socket;
+        boost::asio::io_service*        _ioService;
+        boost::asio::io_service::strand _ownStrand;
+        boost::asio::io_service::strand*    _strand;
+        //! Room for maxDatagrams datagrams of _receiveSize bytes
+        std::vector<char>               _receiveBuffer;
+        uint32_t                        _receiveSize;
+        Datagram                        _received[maxDatagrams];
+        //! Outbound queue, only used in the strand
+        std::deque<Send>                _sendQueue;
+        //! Whether a send waits for the socket to be writable
+        bool                            _sendWaiting;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__BoostUdpSocket__) */
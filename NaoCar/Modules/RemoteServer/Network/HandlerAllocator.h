@@ -0,0 +1,94 @@
+//
+//  HandlerAllocator.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__HandlerAllocator__
+# define __Babel_Server__HandlerAllocator__
+
+# include <atomic>
+# include <cstddef>
+# include <new>
+# include <boost/aligned_storage.hpp>
+# include <boost/noncopyable.hpp>
+
+namespace Network {
+
+    //! Memory for the asynchronous operations of a handler
+    /*!
+     Boost allocates the state of each asynchronous operation through the
+     allocation hooks of its handler. A socket has one small arena per kind
+     of operation, of which there is at most one in progress at a time: the
+     memory is reused by every read or write, and the heap is only used when
+     the arena is taken or too small.
+     The operation is freed before its handler is called, so the handler can
+     start the next operation in the same arena.
+     */
+    class HandlerAllocator : private boost::noncopyable {
+    public:
+        HandlerAllocator() : _inUse(false) {}
+
+        void*   allocate(std::size_t size) {
+            if (size <= sizeof(_storage) && !_inUse.exchange(true))
+                return _storage.address();
+            return ::operator new(size);
+        }
+
+        void    deallocate(void* pointer) {
+            if (pointer == _storage.address())
+                _inUse.store(false);
+            else
+                ::operator delete(pointer);
+        }
+
+    private:
+        boost::aligned_storage<512>  _storage;
+        //! Atomic: writes may be dispatched from any thread
+        std::atomic<bool>           _inUse;
+    };
+
+    //! A handler allocating its operations in a HandlerAllocator
+    template <typename Handler>
+    class AllocatedHandler {
+    public:
+        AllocatedHandler(HandlerAllocator& allocator, Handler const& handler) :
+            _allocator(allocator), _handler(handler) {}
+
+        void    operator()() {
+            _handler();
+        }
+
+        template <typename Arg1>
+        void    operator()(Arg1 const& arg1) {
+            _handler(arg1);
+        }
+
+        template <typename Arg1, typename Arg2>
+        void    operator()(Arg1 const& arg1, Arg2 const& arg2) {
+            _handler(arg1, arg2);
+        }
+
+        friend void*    asio_handler_allocate(std::size_t size,
+                                              AllocatedHandler<Handler>* context) {
+            return context->_allocator.allocate(size);
+        }
+
+        friend void     asio_handler_deallocate(void* pointer, std::size_t,
+                                                AllocatedHandler<Handler>* context) {
+            context->_allocator.deallocate(pointer);
+        }
+
+    private:
+        HandlerAllocator&   _allocator;
+        Handler             _handler;
+    };
+
+    template <typename Handler>
+    inline AllocatedHandler<Handler>    makeAllocatedHandler(HandlerAllocator& allocator,
+                                                             Handler const& handler) {
+        return AllocatedHandler<Handler>(allocator, handler);
+    }
+
+}
+
+#endif /* defined(__Babel_Server__HandlerAllocator__) */
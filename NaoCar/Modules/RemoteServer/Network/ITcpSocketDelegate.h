@@ -34,9 +34,19 @@ namespace Network {
          */
         virtual void    readFinished(ASocket* sender, ASocket::Error error,
 				     size_t bytesRead) = 0;
-	
+
+        //! A readUntil operation has finished
+        /*!
+         Called after readUntil() has been called on the socket and the
+         delimiter has been received, or an error occured.
+         The line points to the buffer of the socket, it is not copied: it
+         is only valid until the next read on the socket.
+         \param sender The socket that emited the event
+         \param error The error if an error occured
+         \param line The data read, delimiter included, empty on error
+         */
         virtual void    readFinished(ASocket* sender, ASocket::Error error,
-				     std::string const& buffer) = 0;
+				     ASocket::Buffer const& line) = 0;
         //! A write operation has finished
         /*!
          Called after write() has been called on the socket and the data have
@@ -47,6 +57,42 @@ namespace Network {
          */
         virtual void    writeFinished(ASocket* sender, ASocket::Error error,
                               size_t bytesWritten) = 0;
+
+        //! A deadline of the socket has expired
+        /*!
+         By default the socket is closed: its pending operations fail, and
+         the delegate releases it as if the peer had disconnected. The
+         socket must not be destroyed here.
+         \param sender The socket that emited the event
+         \param timeout The deadline which expired
+         */
+        virtual void    timedOut(ATcpSocket* sender, ATcpSocket::Timeout) {
+            sender->close();
+        }
+
+        //! The writes queued on the socket reached the high watermark
+        /*!
+         Called in the strand of the socket, from write() when it is called
+         in the strand. Nothing is done by default.
+         \param sender The socket that emited the event
+         \param queuedBytes Bytes of the writes which are not finished
+         */
+        virtual void    writeQueueHigh(ATcpSocket* sender, size_t queuedBytes) {
+            (void)sender;
+            (void)queuedBytes;
+        }
+
+        //! The writes queued on the socket are down to the low watermark
+        /*!
+         Called in the strand of the socket, before writeFinished(), once
+         after each writeQueueHigh(). Nothing is done by default.
+         \param sender The socket that emited the event
+         \param queuedBytes Bytes of the writes which are not finished
+         */
+        virtual void    writeQueueLow(ATcpSocket* sender, size_t queuedBytes) {
+            (void)sender;
+            (void)queuedBytes;
+        }
     };
     
 }
@@ -0,0 +1,60 @@
+//
+//  IUdpSocketDelegate.h
+//  Babel Server
+//
+
+#ifndef Babel_Server_IUdpSocketDelegate_h
+#define Babel_Server_IUdpSocketDelegate_h
+
+#include "AUdpSocket.h"
+
+namespace Network {
+
+    class IUdpSocketDelegate {
+    public:
+        //! The default peer of the socket has been set
+        /*!
+         Called after connect() has been called on the socket and the host
+         has been resolved, or an error occured.
+         \param sender The socket that emited the event
+         \param error The error if an error occured
+         */
+        virtual void    connected(ASocket* sender, ASocket::Error error) = 0;
+
+        //! A datagram has been read
+        /*!
+         Called after read() has been called on the socket and a datagram
+         from the connected peer has been read to the buffer.
+         \param sender The socket that emited the event
+         \param error The error if an error occured
+         \param bytesRead Size of the datagram if no error occured
+         */
+        virtual void    readFinished(ASocket* sender, ASocket::Error error,
+                                     size_t bytesRead) = 0;
+
+        //! A batch of datagrams has been received
+        /*!
+         Called after receive() has been called on the socket.
+         \param sender The socket that emited the event
+         \param error The error if an error occured
+         \param datagrams The datagrams received, only valid until the next
+         receive()
+         \param count The number of datagrams, 0 on error
+         */
+        virtual void    datagramsReceived(AUdpSocket* sender, ASocket::Error error,
+                                          AUdpSocket::Datagram const* datagrams,
+                                          size_t count) = 0;
+
+        //! A write or a send operation has finished
+        /*!
+         \param sender The socket that emited the event
+         \param error The error if an error occured
+         \param bytesWritten Size sent before the error, if any
+         */
+        virtual void    writeFinished(ASocket* sender, ASocket::Error error,
+                                      size_t bytesWritten) = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+//
+//  SharedBuffer.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__SharedBuffer__
+# define __Babel_Server__SharedBuffer__
+
+# include <atomic>
+# include <cstddef>
+# include <cstring>
+# include <new>
+
+namespace Network {
+
+    //! Immutable memory shared by several writes
+    /*!
+     A buffer is filled once, right after it is allocated, then only read:
+     the same data can be written to many sockets without being copied.
+     Copies of a SharedBuffer share the memory, which is freed along with
+     the last of them. The count is atomic, so copies may be made and
+     destroyed from any thread. The count and the data are a single
+     allocation.
+     */
+    class SharedBuffer {
+    public:
+        SharedBuffer() : _block(NULL) {}
+
+        //! Allocates size bytes, to be filled before the buffer is shared
+        explicit SharedBuffer(size_t size) : _block(_allocate(size)) {}
+
+        //! Allocates a copy of the data
+        SharedBuffer(const void* data, size_t size) : _block(_allocate(size)) {
+            std::memcpy(mutableData(), data, size);
+        }
+
+        SharedBuffer(SharedBuffer const& other) : _block(other._block) {
+            if (_block)
+                _block->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ~SharedBuffer() {
+            _release();
+        }
+
+        SharedBuffer&   operator=(SharedBuffer const& other) {
+            if (other._block)
+                other._block->references.fetch_add(1, std::memory_order_relaxed);
+            _release();
+            _block = other._block;
+            return *this;
+        }
+
+        const void*     data() const {
+            return _block ? _block + 1 : NULL;
+        }
+
+        //! The memory to fill, only until the buffer is copied
+        void*           mutableData() {
+            return _block ? _block + 1 : NULL;
+        }
+
+        size_t          size() const {
+            return _block ? _block->size : 0;
+        }
+
+        bool            empty() const {
+            return size() == 0;
+        }
+
+    private:
+        //! Header of the allocation, followed by the data
+        struct Block {
+            std::atomic<long>   references;
+            size_t              size;
+        };
+
+        static Block*   _allocate(size_t size) {
+            Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+
+            new (&block->references) std::atomic<long>(1);
+            block->size = size;
+            return block;
+        }
+
+        void            _release() {
+            if (_block
+                && _block->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ::operator delete(_block);
+        }
+
+        Block*  _block;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__SharedBuffer__) */
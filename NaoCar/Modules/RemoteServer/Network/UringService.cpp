@@ -0,0 +1,396 @@
+//
+//  UringService.cpp
+//  Babel Server
+//
+
+#ifdef NETWORK_HAVE_URING
+
+#include "UringService.h"
+
+#include <boost/bind.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+// No liburing: the system calls and the rings are used directly
+
+static int  ioUringSetup(unsigned int entries, io_uring_params* params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int  ioUringEnter(int fd, unsigned int toSubmit, unsigned int minComplete,
+                         unsigned int flags)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+Network::UringService::UringService() :
+    _ringFd(-1), _sqRing(MAP_FAILED), _sqRingSize(0), _cqRing(MAP_FAILED),
+    _cqRingSize(0), _sqes(NULL), _sqesSize(0), _sqHead(NULL), _sqTail(NULL),
+    _sqMask(0), _sqEntries(0), _sqLocalTail(0), _toSubmit(0), _cqHead(NULL),
+    _cqTail(NULL), _cqMask(0), _cqes(NULL), _buffers(NULL), _eventFd(-1),
+    _eventValue(0),
+    _wakeOperation(this, &UringService::_wakeCompleted), _tickTime(),
+    _tickOperation(this, &UringService::_tickCompleted), _tickArmed(false),
+    _tickers(), _thread(NULL), _threadId(), _stop(false), _sleeping(false),
+    _tasksMutex(), _tasks(), _runningTasks(), _enters(0), _submissions(0),
+    _completions(0)
+{
+    _tickTime.tv_sec = 0;
+    _tickTime.tv_nsec = tickMilliseconds * 1000000L;
+}
+
+Network::UringService::~UringService()
+{
+    stop();
+    _teardown();
+}
+
+bool Network::UringService::isSupported()
+{
+    struct utsname name;
+    int major = 0;
+    int minor = 0;
+
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2
+        || major < 6)
+        return false;
+
+    // io_uring may still be disabled, or filtered out
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(4, &params);
+
+    if (fd < 0)
+        return false;
+    ::close(fd);
+    return (params.features & IORING_FEAT_NODROP) != 0;
+}
+
+bool Network::UringService::start()
+{
+    if (_thread != NULL)
+        return true;
+    if (_ringFd < 0 && !_setup()) {
+        _teardown();
+        return false;
+    }
+    _stop = false;
+    _thread = new boost::thread(&UringService::_run, this);
+    return true;
+}
+
+void Network::UringService::stop()
+{
+    if (_thread == NULL)
+        return ;
+    _stop = true;
+    uint64_t one = 1;
+    if (::write(_eventFd, &one, sizeof(one)) < 0)
+        perror("eventfd");
+    _thread->join();
+    delete _thread;
+    _thread = NULL;
+    _threadId = boost::thread::id();
+}
+
+bool Network::UringService::_setup()
+{
+    io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    // Completions of a whole fan-out fit without overflowing
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = ringEntries * 4;
+    _ringFd = ioUringSetup(ringEntries, &params);
+    if (_ringFd < 0)
+        return false;
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (_cqRingSize > _sqRingSize)
+            _sqRingSize = _cqRingSize;
+        _cqRingSize = _sqRingSize;
+    }
+    _sqRing = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+    if (_sqRing == MAP_FAILED)
+        return false;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _cqRing = _sqRing;
+    } else {
+        _cqRing = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+        if (_cqRing == MAP_FAILED)
+            return false;
+    }
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(_sqRing);
+    char* cq = static_cast<char*>(_cqRing);
+    _sqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    _sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    _sqLocalTail = *_sqTail;
+    // Entry i of the ring is always sqe i
+    unsigned int* array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    for (unsigned int i = 0; i < _sqEntries; ++i)
+        array[i] = i;
+    _cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    _cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    _eventFd = eventfd(0, EFD_CLOEXEC);
+    if (_eventFd < 0)
+        return false;
+
+    // All the buffers at once, submitted by the first loop of the thread
+    _buffers = new char[bufferCount * bufferSize];
+
+    io_uring_sqe* sqe = getSqe();
+
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = bufferCount;
+    sqe->addr = reinterpret_cast<uint64_t>(_buffers);
+    sqe->len = bufferSize;
+    sqe->off = 0;
+    sqe->buf_group = bufferGroup;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    return true;
+}
+
+void Network::UringService::_teardown()
+{
+    if (_eventFd >= 0)
+        ::close(_eventFd);
+    _eventFd = -1;
+    if (_sqes != NULL)
+        munmap(_sqes, _sqesSize);
+    _sqes = NULL;
+    if (_cqRing != MAP_FAILED && _cqRing != _sqRing)
+        munmap(_cqRing, _cqRingSize);
+    _cqRing = MAP_FAILED;
+    if (_sqRing != MAP_FAILED)
+        munmap(_sqRing, _sqRingSize);
+    _sqRing = MAP_FAILED;
+    // Takes the provided buffers back
+    if (_ringFd >= 0)
+        ::close(_ringFd);
+    _ringFd = -1;
+    delete[] _buffers;
+    _buffers = NULL;
+}
+
+void Network::UringService::post(boost::function<void ()> const& task)
+{
+    bool wake;
+    {
+        boost::mutex::scoped_lock lock(_tasksMutex);
+        _tasks.push_back(task);
+        wake = _sleeping;
+        _sleeping = false;
+    }
+    // At most one wake-up per wait of the thread
+    if (wake) {
+        uint64_t one = 1;
+        if (::write(_eventFd, &one, sizeof(one)) < 0)
+            perror("eventfd");
+    }
+}
+
+bool Network::UringService::inServiceThread() const
+{
+    return boost::this_thread::get_id() == _threadId;
+}
+
+io_uring_sqe* Network::UringService::getSqe()
+{
+    // Full: what is queued is submitted now
+    if (_sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+        _submit(false);
+
+    io_uring_sqe* sqe = &_sqes[_sqLocalTail & _sqMask];
+
+    ++_sqLocalTail;
+    ++_toSubmit;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+const char* Network::UringService::getBuffer(unsigned int id) const
+{
+    return _buffers + id * bufferSize;
+}
+
+void Network::UringService::recycleBuffer(unsigned int id)
+{
+    io_uring_sqe* sqe = getSqe();
+
+    // Completes without an entry, unless it fails
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = reinterpret_cast<uint64_t>(_buffers + id * bufferSize);
+    sqe->len = bufferSize;
+    sqe->off = id;
+    sqe->buf_group = bufferGroup;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+}
+
+void Network::UringService::addTicker(Ticker* ticker)
+{
+    _tickers.push_back(ticker);
+}
+
+void Network::UringService::removeTicker(Ticker* ticker)
+{
+    for (size_t i = 0; i < _tickers.size(); ++i)
+        if (_tickers[i] == ticker) {
+            _tickers[i] = _tickers.back();
+            _tickers.pop_back();
+            return ;
+        }
+}
+
+Network::UringService::Statistics Network::UringService::getStatistics() const
+{
+    Statistics statistics;
+
+    statistics.enters = _enters.load(std::memory_order_relaxed);
+    statistics.submissions = _submissions.load(std::memory_order_relaxed);
+    statistics.completions = _completions.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+uint64_t Network::UringService::now()
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+
+void Network::UringService::_run()
+{
+    _threadId = boost::this_thread::get_id();
+    _armWake();
+    while (!_stop) {
+        _runTasks();
+        if (!_tickers.empty() && !_tickArmed)
+            _armTick();
+
+        bool wait;
+        {
+            boost::mutex::scoped_lock lock(_tasksMutex);
+            wait = _tasks.empty() && !_stop;
+            _sleeping = wait;
+        }
+        _submit(wait);
+        _sleeping = false;
+        _reap();
+    }
+}
+
+void Network::UringService::_runTasks()
+{
+    {
+        boost::mutex::scoped_lock lock(_tasksMutex);
+        _runningTasks.swap(_tasks);
+    }
+    for (size_t i = 0; i < _runningTasks.size(); ++i)
+        _runningTasks[i]();
+    _runningTasks.clear();
+}
+
+void Network::UringService::_submit(bool wait)
+{
+    if (_toSubmit == 0 && !wait)
+        return ;
+    __atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+
+    int submitted = ioUringEnter(_ringFd, _toSubmit, wait ? 1 : 0,
+                                 wait ? IORING_ENTER_GETEVENTS : 0);
+
+    _enters.fetch_add(1, std::memory_order_relaxed);
+    if (submitted > 0) {
+        _toSubmit -= submitted;
+        _submissions.fetch_add(submitted, std::memory_order_relaxed);
+    } else if (submitted < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+        perror("io_uring_enter");
+    }
+}
+
+void Network::UringService::_reap()
+{
+    unsigned int head = *_cqHead;
+
+    while (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+        io_uring_cqe* cqe = &_cqes[head & _cqMask];
+        Operation* operation = reinterpret_cast<Operation*>(cqe->user_data);
+        int result = cqe->res;
+        unsigned int flags = cqe->flags;
+
+        // Released before the operation runs, which may submit more
+        ++head;
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        _completions.fetch_add(1, std::memory_order_relaxed);
+        if (operation != NULL)
+            operation->completed(result, flags);
+    }
+}
+
+void Network::UringService::_armWake()
+{
+    io_uring_sqe* sqe = getSqe();
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = _eventFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&_eventValue);
+    sqe->len = sizeof(_eventValue);
+    sqe->user_data = reinterpret_cast<uint64_t>(static_cast<Operation*>(&_wakeOperation));
+}
+
+void Network::UringService::_wakeCompleted(int, unsigned int)
+{
+    if (!_stop)
+        _armWake();
+}
+
+void Network::UringService::_armTick()
+{
+    io_uring_sqe* sqe = getSqe();
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&_tickTime);
+    sqe->len = 1;
+    sqe->user_data = reinterpret_cast<uint64_t>(static_cast<Operation*>(&_tickOperation));
+    _tickArmed = true;
+}
+
+void Network::UringService::_tickCompleted(int, unsigned int)
+{
+    uint64_t time = now();
+
+    _tickArmed = false;
+    // A ticker may remove itself, which moves the last one in its place
+    for (size_t i = _tickers.size(); i-- > 0; )
+        if (i < _tickers.size())
+            _tickers[i]->tick(time);
+}
+
+#endif
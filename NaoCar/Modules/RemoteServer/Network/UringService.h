@@ -0,0 +1,184 @@
+//
+//  UringService.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__UringService__
+# define __Babel_Server__UringService__
+
+# include <atomic>
+# include <stdint.h>
+# include <vector>
+# include <boost/function.hpp>
+# include <boost/noncopyable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+# include <linux/io_uring.h>
+
+namespace Network {
+
+    //! An io_uring instance, and the thread completing its operations
+    /*!
+     The sockets of the io_uring backend queue their operations in the
+     submission ring of a service, and its thread submits all of them with
+     a single system call per loop, which also waits for their completions.
+     Sending a frame to many clients costs one system call instead of one
+     per client.
+     Everything runs in the service thread, which acts as the strand of all
+     its sockets: work from other threads is posted to it.
+     Receives use buffers provided to the kernel once and handed back once
+     read, so a multishot receive needs no buffer of its own.
+     Requires Linux 6.0, for multishot accept and receive.
+     */
+    class UringService : private boost::noncopyable {
+    public:
+        //! An operation in the ring, completed in the service thread
+        class Operation {
+        public:
+            virtual ~Operation() {}
+            //! result and flags of the completion entry
+            virtual void    completed(int result, unsigned int flags) = 0;
+        };
+
+        //! An operation completed by a method of its owner
+        template <typename Owner>
+        class BoundOperation : public Operation {
+        public:
+            typedef void    (Owner::*Method)(int result, unsigned int flags);
+
+            BoundOperation(Owner* owner, Method method) :
+                _owner(owner), _method(method) {}
+
+            virtual void    completed(int result, unsigned int flags) {
+                (_owner->*_method)(result, flags);
+            }
+
+        private:
+            Owner*  _owner;
+            Method  _method;
+        };
+
+        //! Called in the service thread every tickMilliseconds, once added
+        class Ticker {
+        public:
+            virtual ~Ticker() {}
+            //! now is the time of the tick, see now()
+            virtual void    tick(uint64_t now) = 0;
+        };
+
+        //! Statistics of the service, since it started
+        struct Statistics {
+            //! io_uring_enter system calls
+            uint64_t    enters;
+            //! Submitted and completed operations
+            uint64_t    submissions;
+            uint64_t    completions;
+        };
+
+        //! Entries of the submission ring
+        static const unsigned int   ringEntries = 256;
+        //! Buffers provided to the kernel for the receives
+        static const unsigned int   bufferCount = 256;
+        static const unsigned int   bufferSize = 2048;
+        static const unsigned short bufferGroup = 0;
+        //! Period of the tickers, which check the deadlines of the sockets
+        static const unsigned int   tickMilliseconds = 10;
+
+        UringService();
+        //! Stops the service. Its sockets and servers must be destroyed after.
+        ~UringService();
+
+        //! Whether the kernel has what the service needs
+        static bool isSupported();
+
+        //! Sets up the ring and starts the thread, false if not supported
+        bool    start();
+        //! Stops the thread, the pending operations are not completed
+        void    stop();
+
+        //! Runs task in the service thread, may be called from any thread
+        void    post(boost::function<void ()> const& task);
+        bool    inServiceThread() const;
+
+        //! Returns a cleared submission entry, in the service thread
+        /*!
+         The entry is submitted by the next loop of the service thread.
+         */
+        io_uring_sqe*   getSqe();
+
+        //! Data of a provided buffer, given by a completion
+        const char*     getBuffer(unsigned int id) const;
+        //! Gives a provided buffer back to the kernel, once read
+        /*!
+         Queued like an operation, the buffer is available to the receives
+         submitted after it.
+         */
+        void            recycleBuffer(unsigned int id);
+
+        void    addTicker(Ticker* ticker);
+        void    removeTicker(Ticker* ticker);
+
+        Statistics  getStatistics() const;
+
+        //! Milliseconds of a monotonic clock
+        static uint64_t now();
+
+    private:
+        bool    _setup();
+        void    _teardown();
+        void    _run();
+        void    _runTasks();
+        //! Submits the queued entries, waiting for a completion if wait
+        void    _submit(bool wait);
+        void    _reap();
+        void    _armWake();
+        void    _wakeCompleted(int result, unsigned int flags);
+        void    _armTick();
+        void    _tickCompleted(int result, unsigned int flags);
+
+        int                 _ringFd;
+        void*               _sqRing;
+        size_t              _sqRingSize;
+        void*               _cqRing;
+        size_t              _cqRingSize;
+        io_uring_sqe*       _sqes;
+        size_t              _sqesSize;
+        unsigned int*       _sqHead;
+        unsigned int*       _sqTail;
+        unsigned int        _sqMask;
+        unsigned int        _sqEntries;
+        //! Tail of the entries queued, published on submission
+        unsigned int        _sqLocalTail;
+        unsigned int        _toSubmit;
+        unsigned int*       _cqHead;
+        unsigned int*       _cqTail;
+        unsigned int        _cqMask;
+        io_uring_cqe*       _cqes;
+        char*               _buffers;
+
+        //! Wakes the thread when a task is posted
+        int                 _eventFd;
+        uint64_t            _eventValue;
+        BoundOperation<UringService>    _wakeOperation;
+        __kernel_timespec   _tickTime;
+        BoundOperation<UringService>    _tickOperation;
+        bool                _tickArmed;
+        std::vector<Ticker*>    _tickers;
+
+        boost::thread*      _thread;
+        boost::thread::id   _threadId;
+        std::atomic<bool>   _stop;
+        //! The thread may be waiting in the kernel
+        bool                _sleeping;
+        boost::mutex        _tasksMutex;
+        std::vector<boost::function<void ()> >  _tasks;
+        std::vector<boost::function<void ()> >  _runningTasks;
+
+        std::atomic<uint64_t>   _enters;
+        std::atomic<uint64_t>   _submissions;
+        std::atomic<uint64_t>   _completions;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__UringService__) */
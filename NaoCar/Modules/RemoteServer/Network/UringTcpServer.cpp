@@ -0,0 +1,147 @@
+//
+//  UringTcpServer.cpp
+//  Babel Server
+//
+
+#ifdef NETWORK_HAVE_URING
+
+#include "UringTcpServer.h"
+#include "ITcpServerDelegate.h"
+
+#include <arpa/inet.h>
+#include <boost/bind.hpp>
+#include <cstring>
+#include <unistd.h>
+
+Network::UringTcpServer::UringTcpServer(UringService* service) :
+    _service(service), _fd(-1),
+    _acceptOperation(this, &UringTcpServer::_acceptCompleted), _pool()
+{
+    _pool.reserve(maxPooledSockets);
+}
+
+Network::UringTcpServer::~UringTcpServer()
+{
+    close();
+    for (size_t i = 0; i < _pool.size(); ++i)
+        delete _pool[i];
+}
+
+bool Network::UringTcpServer::listen(uint16_t port, std::string address)
+{
+    sockaddr_in endpoint;
+    int enabled = 1;
+
+    if (_fd >= 0)
+        return false;
+    memset(&endpoint, 0, sizeof(endpoint));
+    endpoint.sin_family = AF_INET;
+    endpoint.sin_port = htons(port);
+    if (address == "")
+        endpoint.sin_addr.s_addr = htonl(INADDR_ANY);
+    else if (inet_pton(AF_INET, address.c_str(), &endpoint.sin_addr) != 1)
+        return false;
+    _fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_fd < 0)
+        return false;
+    if (setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) != 0
+        || bind(_fd, reinterpret_cast<sockaddr*>(&endpoint), sizeof(endpoint)) != 0
+        || ::listen(_fd, getMaxPendingConnections()) != 0) {
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+    _service->post(boost::bind(&Network::UringTcpServer::_startAccept, this));
+    return true;
+}
+
+void Network::UringTcpServer::_startAccept()
+{
+    io_uring_sqe* sqe = _service->getSqe();
+
+    // Completes once per connection, until it fails
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = _fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_acceptOperation));
+}
+
+void Network::UringTcpServer::_acceptCompleted(int result, unsigned int flags)
+{
+    if (result >= 0) {
+        UringTcpSocket* socket = NULL;
+
+        if (!_pool.empty()) {
+            socket = _pool.back();
+            _pool.pop_back();
+        } else {
+            socket = new UringTcpSocket(_service);
+        }
+        socket->_adopt(result);
+        _newConnection(socket);
+    }
+    if (!(flags & IORING_CQE_F_MORE))
+        _startAccept();
+}
+
+void Network::UringTcpServer::close()
+{
+    setDelegate(NULL);
+    if (_fd >= 0)
+        ::close(_fd);
+    _fd = -1;
+}
+
+void Network::UringTcpServer::release(ATcpSocket* socket)
+{
+    UringTcpSocket* uringSocket = dynamic_cast<UringTcpSocket*>(socket);
+
+    if (uringSocket == NULL) {
+        delete socket;
+        return ;
+    }
+    // Posted even from the service thread: the socket may be released by
+    // one of its own handlers
+    _service->post(boost::bind(&Network::UringTcpSocket::_recycle,
+                               uringSocket, this));
+}
+
+void Network::UringTcpServer::_recycled(UringTcpSocket* socket)
+{
+    if (_pool.size() < maxPooledSockets)
+        _pool.push_back(socket);
+    else
+        delete socket;
+}
+
+bool Network::UringTcpServer::_getAddress(sockaddr_in& address) const
+{
+    socklen_t length = sizeof(address);
+
+    return _fd >= 0
+        && getsockname(_fd, reinterpret_cast<sockaddr*>(&address), &length) == 0
+        && address.sin_family == AF_INET;
+}
+
+std::string Network::UringTcpServer::getAddress() const
+{
+    sockaddr_in address;
+    char ip[INET_ADDRSTRLEN];
+
+    if (!_getAddress(address)
+        || inet_ntop(AF_INET, &address.sin_addr, ip, sizeof(ip)) == NULL)
+        return "";
+    return ip;
+}
+
+uint16_t Network::UringTcpServer::getPort() const
+{
+    sockaddr_in address;
+
+    if (!_getAddress(address))
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+#endif
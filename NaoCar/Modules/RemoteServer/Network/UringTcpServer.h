@@ -0,0 +1,66 @@
+//
+//  UringTcpServer.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__UringTcpServer__
+# define __Babel_Server__UringTcpServer__
+
+# include <vector>
+
+# include "ATcpServer.h"
+# include "UringService.h"
+# include "UringTcpSocket.h"
+
+namespace Network {
+
+    //! io_uring implementation of a Tcp Server
+    /*!
+     A single multishot accept is armed in the ring of the service, and
+     the delegate is called in the service thread for each connection.
+     Released sockets are kept in a pool, as by BoostTcpServer. The server
+     must be destroyed after its service is stopped.
+     */
+
+    class UringTcpServer : public ATcpServer {
+    public:
+
+        UringTcpServer(UringService* service);
+        virtual ~UringTcpServer();
+
+        virtual bool listen(uint16_t port, std::string address);
+        virtual std::string getAddress() const;
+        virtual uint16_t getPort() const;
+        //! Closes the listening socket, once the service is stopped
+        virtual void close();
+
+        //! Keeps the socket for a later connection, may be called from any thread
+        /*!
+         The socket is closed in the service thread, and reused once its
+         operations are completed.
+         */
+        virtual void release(ATcpSocket* socket);
+
+        //! Maximum number of sockets kept for reuse
+        static const size_t maxPooledSockets = 16;
+
+    private:
+        friend class UringTcpSocket;
+
+        void _startAccept();
+        void _acceptCompleted(int result, unsigned int flags);
+        //! Takes back a socket closed by a release, in the service thread
+        void _recycled(UringTcpSocket* socket);
+
+        bool _getAddress(sockaddr_in& address) const;
+
+        UringService*   _service;
+        int             _fd;
+        UringService::BoundOperation<UringTcpServer>    _acceptOperation;
+        //! Only used in the service thread
+        std::vector<UringTcpSocket*>    _pool;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__UringTcpServer__) */
@@ -0,0 +1,673 @@
+//
+//  UringTcpSocket.cpp
+//  Babel Server
+//
+
+#ifdef NETWORK_HAVE_URING
+
+#include "UringTcpSocket.h"
+
+#include <arpa/inet.h>
+#include <boost/bind.hpp>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <unistd.h>
+
+#include "ITcpSocketDelegate.h"
+#include "UringTcpServer.h"
+
+Network::UringTcpSocket::UringTcpSocket(UringService* service) :
+    ATcpSocket(), _service(service), _fd(-1), _closed(false), _outstanding(0),
+    _server(NULL), _connectOperation(this, &UringTcpSocket::_connectCompleted),
+    _receiveOperation(this, &UringTcpSocket::_receiveCompleted),
+    _cancelOperation(this, &UringTcpSocket::_cancelCompleted),
+    _writeOperation(this, &UringTcpSocket::_writeCompleted), _connectAddress(),
+    _received(), _receivedStart(0), _receiveArmed(false),
+    _receiveCancelled(false), _receiveError(false), _readPending(false),
+    _readBuffer(NULL), _readSize(0), _readAll(false), _delimiter(),
+    _delivering(false), _writeQueue(4), _writeOffset(0), _writeMessage(),
+    _pendingWrites(), _flushedWrites(), _pendingWritesMutex(),
+    _flushPosted(false), _ticking(false)
+{
+    for (int i = 0; i < TimeoutCount; ++i) {
+        _timeouts[i] = 0;
+        _deadlines[i] = 0;
+    }
+}
+
+Network::UringTcpSocket::~UringTcpSocket()
+{
+    if (_ticking)
+        _service->removeTicker(this);
+    if (_fd >= 0)
+        ::close(_fd);
+}
+
+Network::UringService*  Network::UringTcpSocket::getService() const
+{
+    return _service;
+}
+
+void Network::UringTcpSocket::connect(std::string host, uint16_t port)
+{
+    std::stringstream portString;
+    addrinfo hints;
+    addrinfo* endpoints = NULL;
+
+    portString << port;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), portString.str().c_str(), &hints, &endpoints) != 0
+        || endpoints == NULL) {
+        _service->post(boost::bind(&Network::UringTcpSocket::_connected,
+                                   this, ASocket::HostNotFound));
+        return ;
+    }
+
+    sockaddr_storage address;
+    socklen_t length = endpoints->ai_addrlen;
+
+    memcpy(&address, endpoints->ai_addr, length);
+    freeaddrinfo(endpoints);
+    _service->post(boost::bind(&Network::UringTcpSocket::_connect,
+                               this, address, length));
+}
+
+void Network::UringTcpSocket::_connect(sockaddr_storage const& address,
+                                       socklen_t length)
+{
+    if (_fd < 0)
+        _fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_fd < 0) {
+        _connected(ASocket::HostUnreachable);
+        return ;
+    }
+    _closed = false;
+    _connectAddress = address;
+
+    io_uring_sqe* sqe = _service->getSqe();
+
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = _fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&_connectAddress);
+    sqe->off = length;
+    sqe->user_data = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_connectOperation));
+    ++_outstanding;
+}
+
+void Network::UringTcpSocket::_connectCompleted(int result, unsigned int)
+{
+    if (_operationCompleted())
+        return ;
+    if (result == 0)
+        _connected(ASocket::NoError);
+    else
+        _connected(ASocket::HostUnreachable);
+}
+
+void Network::UringTcpSocket::close()
+{
+    // Fails the pending operations, the fd is kept until the socket is
+    // destroyed or released
+    _closed = true;
+    if (_fd >= 0)
+        ::shutdown(_fd, SHUT_RDWR);
+}
+
+void Network::UringTcpSocket::read(void* buffer, uint32_t size, bool all)
+{
+    if (_service->inServiceThread())
+        _read(buffer, size, all);
+    else
+        _service->post(boost::bind(&Network::UringTcpSocket::_read,
+                                   this, buffer, size, all));
+}
+
+void Network::UringTcpSocket::readUntil(std::string const& delim)
+{
+    if (_service->inServiceThread())
+        _readUntil(delim);
+    else
+        _service->post(boost::bind(&Network::UringTcpSocket::_readUntil,
+                                   this, delim));
+}
+
+void Network::UringTcpSocket::_read(void* buffer, uint32_t size, bool all)
+{
+    _readPending = true;
+    _readBuffer = buffer;
+    _readSize = size;
+    _readAll = all;
+    _delimiter.clear();
+    _startDeadline(ReadTimeout);
+    _deliver();
+}
+
+void Network::UringTcpSocket::_readUntil(std::string const& delim)
+{
+    _readPending = true;
+    _delimiter = delim;
+    _startDeadline(ReadTimeout);
+    _deliver();
+}
+
+void Network::UringTcpSocket::_armReceive()
+{
+    io_uring_sqe* sqe = _service->getSqe();
+
+    // Completes each time data is received, in a buffer of the service
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = _fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = UringService::bufferGroup;
+    sqe->user_data = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_receiveOperation));
+    _receiveArmed = true;
+    _receiveCancelled = false;
+    ++_outstanding;
+}
+
+void Network::UringTcpSocket::_receiveCompleted(int result, unsigned int flags)
+{
+    if (flags & IORING_CQE_F_BUFFER) {
+        unsigned int id = flags >> IORING_CQE_BUFFER_SHIFT;
+
+        if (result > 0 && _server == NULL) {
+            // What was delivered is dropped, at most once per receive so the
+            // buffered data is not moved over and over
+            if (_receivedStart == _received.size()) {
+                _received.clear();
+                _receivedStart = 0;
+            } else if (_receivedStart >= _received.size() / 2) {
+                _received.erase(0, _receivedStart);
+                _receivedStart = 0;
+            }
+            _received.append(_service->getBuffer(id), result);
+        }
+        _service->recycleBuffer(id);
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        _receiveArmed = false;
+        if (_operationCompleted())
+            return ;
+    } else if (_server != NULL) {
+        return ;
+    }
+    // No buffer was left, or the receive was cancelled: armed again by
+    // _deliver() when needed
+    if (result == 0 || (result < 0 && result != -ENOBUFS && result != -ECANCELED))
+        _receiveError = true;
+    _deliver();
+}
+
+void Network::UringTcpSocket::_cancelCompleted(int, unsigned int)
+{
+    _operationCompleted();
+}
+
+void Network::UringTcpSocket::_deliver()
+{
+    // Called again by a read from the delegate, the loop below serves it
+    if (_delivering)
+        return ;
+    _delivering = true;
+    while (_readPending) {
+        const char* data = _received.data() + _receivedStart;
+        size_t buffered = _received.size() - _receivedStart;
+        size_t size = 0;
+
+        if (!_delimiter.empty()) {
+            size_t end = _received.find(_delimiter, _receivedStart);
+
+            if (end != std::string::npos)
+                size = end + _delimiter.size() - _receivedStart;
+        } else if (buffered >= _readSize || (!_readAll && buffered > 0)) {
+            size = buffered < _readSize ? buffered : _readSize;
+        }
+        if (size == 0)
+            break ;
+        // Consumed before the delegate is called, which may read again. The
+        // memory is left untouched until the next receive.
+        _readPending = false;
+        _receivedStart += size;
+        _stopDeadline(ReadTimeout);
+        _startDeadline(IdleTimeout);
+        if (_delimiter.empty()) {
+            memcpy(_readBuffer, data, size);
+            _readFinished(ASocket::NoError, size);
+        } else {
+            ITcpSocketDelegate* delegate = getDelegate();
+            ASocket::Buffer line = { data, static_cast<uint32_t>(size) };
+
+            if (delegate)
+                delegate->readFinished(this, ASocket::NoError, line);
+        }
+    }
+    _delivering = false;
+
+    size_t buffered = _received.size() - _receivedStart;
+
+    if (_receiveError) {
+        if (!_readPending)
+            return ;
+        _readPending = false;
+        _stopDeadline(ReadTimeout);
+        // Last, the delegate may release the socket
+        if (_delimiter.empty()) {
+            _readFinished(ASocket::ReadError, 0);
+        } else {
+            ITcpSocketDelegate* delegate = getDelegate();
+            ASocket::Buffer line = { NULL, 0 };
+
+            if (delegate)
+                delegate->readFinished(this, ASocket::ReadError, line);
+        }
+    } else if (!_receiveArmed && buffered < maxBufferedBytes) {
+        _armReceive();
+    } else if (_receiveArmed && !_receiveCancelled && !_readPending
+               && buffered >= maxBufferedBytes) {
+        // Nobody reads: the peer is left to fill the kernel buffers
+        io_uring_sqe* sqe = _service->getSqe();
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_receiveOperation));
+        sqe->user_data = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_cancelOperation));
+        _receiveCancelled = true;
+        ++_outstanding;
+    }
+}
+
+void Network::UringTcpSocket::write(const void* buffer, uint32_t size)
+{
+    QueuedWrite queued;
+
+    queued.buffers[0].iov_base = const_cast<void*>(buffer);
+    queued.buffers[0].iov_len = size;
+    queued.count = 1;
+    queued.size = size;
+    _post(queued);
+}
+
+void Network::UringTcpSocket::write(Buffer const* buffers, size_t count)
+{
+    QueuedWrite queued;
+
+    assert(count <= maxWriteBuffers);
+    queued.count = count;
+    queued.size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        queued.buffers[i].iov_base = const_cast<void*>(buffers[i].data);
+        queued.buffers[i].iov_len = buffers[i].size;
+        queued.size += buffers[i].size;
+    }
+    _post(queued);
+}
+
+void Network::UringTcpSocket::write(SharedBuffer const& buffer)
+{
+    QueuedWrite queued;
+
+    // The queue holds a reference to the buffer, the data is not copied
+    queued.buffers[0].iov_base = const_cast<void*>(buffer.data());
+    queued.buffers[0].iov_len = buffer.size();
+    queued.count = 1;
+    queued.size = buffer.size();
+    queued.owner = buffer;
+    _post(queued);
+}
+
+void Network::UringTcpSocket::_post(QueuedWrite const& queued)
+{
+    if (_service->inServiceThread()) {
+        _write(queued);
+        return ;
+    }
+
+    bool post = false;
+    {
+        boost::mutex::scoped_lock lock(_pendingWritesMutex);
+        _pendingWrites.push_back(queued);
+        // A single task flushes all the writes requested meanwhile
+        post = !_flushPosted;
+        _flushPosted = true;
+    }
+    if (post)
+        _service->post(boost::bind(&Network::UringTcpSocket::_flushPendingWrites, this));
+}
+
+void Network::UringTcpSocket::_flushPendingWrites()
+{
+    {
+        boost::mutex::scoped_lock lock(_pendingWritesMutex);
+        _flushedWrites.swap(_pendingWrites);
+        _flushPosted = false;
+    }
+    for (size_t i = 0; i < _flushedWrites.size(); ++i)
+        _write(_flushedWrites[i]);
+    _flushedWrites.clear();
+}
+
+void Network::UringTcpSocket::_write(QueuedWrite const& queued)
+{
+    // Released meanwhile
+    if (_server != NULL)
+        return ;
+    // Grows once to the largest backlog, then never allocates again
+    if (_writeQueue.full())
+        _writeQueue.set_capacity(_writeQueue.capacity() * 2);
+    _writeQueue.push_back(queued);
+    if (_writeQueue.size() == 1) {
+        _startDeadline(WriteTimeout);
+        _startWrite();
+    }
+    _writeQueued(queued.size);
+}
+
+void Network::UringTcpSocket::_startWrite()
+{
+    QueuedWrite const& front = _writeQueue.front();
+    size_t skipped = _writeOffset;
+    size_t count = 0;
+
+    // What a partial send left
+    for (size_t i = 0; i < front.count; ++i) {
+        if (skipped >= front.buffers[i].iov_len) {
+            skipped -= front.buffers[i].iov_len;
+            continue ;
+        }
+        _writeBuffers[count].iov_base = static_cast<char*>(front.buffers[i].iov_base) + skipped;
+        _writeBuffers[count].iov_len = front.buffers[i].iov_len - skipped;
+        skipped = 0;
+        ++count;
+    }
+
+    io_uring_sqe* sqe = _service->getSqe();
+
+    // A single segment needs no message header, like a frame
+    if (count == 1) {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = reinterpret_cast<uint64_t>(_writeBuffers[0].iov_base);
+        sqe->len = _writeBuffers[0].iov_len;
+    } else {
+        memset(&_writeMessage, 0, sizeof(_writeMessage));
+        _writeMessage.msg_iov = _writeBuffers;
+        _writeMessage.msg_iovlen = count;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = reinterpret_cast<uint64_t>(&_writeMessage);
+        sqe->len = 1;
+    }
+    sqe->fd = _fd;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_writeOperation));
+    ++_outstanding;
+}
+
+void Network::UringTcpSocket::_writeCompleted(int result, unsigned int)
+{
+    if (_operationCompleted())
+        return ;
+
+    size_t queued = _writeQueue.front().size;
+
+    if (result > 0 && _writeOffset + result < queued) {
+        _writeOffset += result;
+        _startWrite();
+        return ;
+    }
+
+    size_t written = result >= 0 ? queued : _writeOffset;
+
+    // Frees a shared buffer if this was its last write
+    _writeOffset = 0;
+    _writeQueue.pop_front();
+    if (_writeQueue.empty())
+        _stopDeadline(WriteTimeout);
+    else
+        _startDeadline(WriteTimeout);
+    _startDeadline(IdleTimeout);
+    // The next write is started before notifying the delegate, which may
+    // queue more data or release the socket once its writes are done
+    if (!_writeQueue.empty())
+        _startWrite();
+    _writeDequeued(queued);
+    if (result >= 0)
+        _writeFinished(ASocket::NoError, written);
+    else
+        _writeFinished(ASocket::WriteError, written);
+}
+
+void Network::UringTcpSocket::setTimeout(Timeout timeout, unsigned int milliseconds)
+{
+    _timeouts[timeout] = milliseconds;
+    if (timeout != IdleTimeout)
+        return ;
+    if (_service->inServiceThread())
+        _startDeadline(IdleTimeout);
+    else
+        _service->post(boost::bind(&Network::UringTcpSocket::_startDeadline,
+                                   this, IdleTimeout));
+}
+
+void Network::UringTcpSocket::_startDeadline(Timeout timeout)
+{
+    if (_timeouts[timeout] == 0) {
+        _deadlines[timeout] = 0;
+        return ;
+    }
+    _deadlines[timeout] = UringService::now() + _timeouts[timeout];
+    _updateTicker();
+}
+
+void Network::UringTcpSocket::_stopDeadline(Timeout timeout)
+{
+    // The ticker is left, it finds nothing to do on the next tick
+    _deadlines[timeout] = 0;
+}
+
+void Network::UringTcpSocket::_updateTicker()
+{
+    if (_ticking)
+        return ;
+    _service->addTicker(this);
+    _ticking = true;
+}
+
+void Network::UringTcpSocket::tick(uint64_t now)
+{
+    int expired = TimeoutCount;
+    bool running = false;
+
+    for (int i = 0; i < TimeoutCount; ++i) {
+        if (_deadlines[i] == 0)
+            continue ;
+        if (expired == TimeoutCount && _deadlines[i] <= now)
+            expired = i;
+        else
+            running = true;
+    }
+    if (expired != TimeoutCount)
+        _deadlines[expired] = 0;
+    if (!running) {
+        _service->removeTicker(this);
+        _ticking = false;
+    }
+    if (expired != TimeoutCount && _fd >= 0 && !_closed)
+        _timedOut(static_cast<Timeout>(expired));
+}
+
+void Network::UringTcpSocket::_adopt(int fd)
+{
+    _fd = fd;
+    _closed = false;
+}
+
+void Network::UringTcpSocket::_recycle(UringTcpServer* server)
+{
+    _server = server;
+    setDelegate(NULL);
+    if (_fd >= 0)
+        ::shutdown(_fd, SHUT_RDWR);
+    if (_receiveArmed && !_receiveCancelled) {
+        io_uring_sqe* sqe = _service->getSqe();
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_receiveOperation));
+        sqe->user_data = reinterpret_cast<uint64_t>(static_cast<UringService::Operation*>(&_cancelOperation));
+        _receiveCancelled = true;
+        ++_outstanding;
+    }
+    if (_outstanding == 0)
+        _finishRecycle();
+}
+
+bool Network::UringTcpSocket::_operationCompleted()
+{
+    --_outstanding;
+    if (_server == NULL)
+        return false;
+    if (_outstanding == 0)
+        _finishRecycle();
+    return true;
+}
+
+void Network::UringTcpSocket::_finishRecycle()
+{
+    UringTcpServer* server = _server;
+
+    _clear();
+    // May destroy the socket
+    server->_recycled(this);
+}
+
+void Network::UringTcpSocket::_clear()
+{
+    if (_fd >= 0)
+        ::close(_fd);
+    _fd = -1;
+    _closed = false;
+    _server = NULL;
+    setDelegate(NULL);
+    _received.clear();
+    _receivedStart = 0;
+    _receiveArmed = false;
+    _receiveCancelled = false;
+    _receiveError = false;
+    _readPending = false;
+    _delimiter.clear();
+    _writeQueue.clear();
+    _writeOffset = 0;
+    {
+        boost::mutex::scoped_lock lock(_pendingWritesMutex);
+        _pendingWrites.clear();
+    }
+    _clearWriteQueue();
+    for (int i = 0; i < TimeoutCount; ++i) {
+        _timeouts[i] = 0;
+        _deadlines[i] = 0;
+    }
+    if (_ticking)
+        _service->removeTicker(this);
+    _ticking = false;
+}
+
+bool Network::UringTcpSocket::_getPeer(sockaddr_in& address) const
+{
+    socklen_t length = sizeof(address);
+
+    return _fd >= 0
+        && getpeername(_fd, reinterpret_cast<sockaddr*>(&address), &length) == 0
+        && address.sin_family == AF_INET;
+}
+
+std::string Network::UringTcpSocket::getRemoteIp() const
+{
+    sockaddr_in address;
+    char ip[INET_ADDRSTRLEN];
+
+    if (!_getPeer(address)
+        || inet_ntop(AF_INET, &address.sin_addr, ip, sizeof(ip)) == NULL)
+        return "";
+    return ip;
+}
+
+uint32_t Network::UringTcpSocket::getBinaryRemoteIp() const
+{
+    sockaddr_in address;
+
+    if (!_getPeer(address))
+        return 0;
+    return ntohl(address.sin_addr.s_addr);
+}
+
+uint16_t    Network::UringTcpSocket::getRemotePort() const
+{
+    sockaddr_in address;
+
+    if (!_getPeer(address))
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+bool        Network::UringTcpSocket::isConnected() const
+{
+    return _fd >= 0 && !_closed;
+}
+
+bool Network::UringTcpSocket::setNoDelay(bool enabled)
+{
+    int value = enabled;
+
+    return setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == 0;
+}
+
+bool Network::UringTcpSocket::setSendBufferSize(int size)
+{
+    return setsockopt(_fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == 0;
+}
+
+bool Network::UringTcpSocket::setReceiveBufferSize(int size)
+{
+    return setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == 0;
+}
+
+bool Network::UringTcpSocket::setNotSentLowWatermark(int size)
+{
+#ifdef TCP_NOTSENT_LOWAT
+    // 0 would mean that nothing may be left unsent, the system default is
+    // set back instead
+    int value = size > 0 ? size : 0x7fffffff;
+
+    return setsockopt(_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, sizeof(value)) == 0;
+#else
+    (void)size;
+    return false;
+#endif
+}
+
+bool Network::UringTcpSocket::setKeepAlive(unsigned int idleSeconds)
+{
+    int enabled = idleSeconds > 0;
+
+    if (setsockopt(_fd, SOL_SOCKET, SO_KEEPALIVE, &enabled, sizeof(enabled)) != 0)
+        return false;
+    if (idleSeconds == 0)
+        return true;
+
+    // Dropped after the idle time and 3 unanswered probes one second apart
+    int idle = idleSeconds;
+    int interval = 1;
+    int count = 3;
+
+    return setsockopt(_fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) == 0
+        && setsockopt(_fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) == 0
+        && setsockopt(_fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) == 0;
+}
+
+#endif
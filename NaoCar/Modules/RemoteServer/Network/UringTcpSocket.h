@@ -0,0 +1,182 @@
+//
+//  UringTcpSocket.h
+//  Babel Server
+//
+
+#ifndef __Babel_Server__UringTcpSocket__
+# define __Babel_Server__UringTcpSocket__
+
+# include <atomic>
+# include <string>
+# include <vector>
+# include <boost/circular_buffer.hpp>
+# include <boost/thread/mutex.hpp>
+# include <netinet/in.h>
+# include <sys/socket.h>
+# include <sys/uio.h>
+
+# include "ATcpSocket.h"
+# include "UringService.h"
+
+namespace Network {
+
+    class UringTcpServer;
+
+    //! io_uring implementation of a Tcp Socket
+    /*!
+     The operations of the socket are queued in the ring of its service, and
+     its handlers run in the service thread. Writes may be requested from
+     any thread, they are queued in the service thread.
+     A single multishot receive, armed by the first read, fills the provided
+     buffers of the service: the data is copied to the buffer of the socket,
+     from which read() and readUntil() are served. It is cancelled while
+     more than maxBufferedBytes are waiting for a read.
+     Writes are sent with sendmsg from the memory of the caller, shared
+     buffers are not copied either.
+     The deadlines are checked by the ticks of the service, every
+     UringService::tickMilliseconds.
+     readFinished() is called before read() returns when the data is
+     already received.
+     The socket must be destroyed once none of its operations is in
+     progress, or after its service is stopped.
+     */
+
+    class UringTcpSocket : public ATcpSocket, private UringService::Ticker {
+    public:
+        UringTcpSocket(UringService* service);
+        virtual ~UringTcpSocket();
+
+        //! Resolves the host in the calling thread, then connects
+        virtual void connect(std::string host, uint16_t port);
+        virtual void close();
+        virtual void read(void* buffer, uint32_t size, bool all);
+        virtual void readUntil(std::string const& delim);
+        virtual void write(const void* buffer, uint32_t size);
+        virtual void write(Buffer const* buffers, size_t count);
+        virtual void write(SharedBuffer const& buffer);
+        virtual void setTimeout(Timeout timeout, unsigned int milliseconds);
+        virtual bool setNoDelay(bool enabled);
+        virtual bool setSendBufferSize(int size);
+        virtual bool setReceiveBufferSize(int size);
+        virtual bool setNotSentLowWatermark(int size);
+        virtual bool setKeepAlive(unsigned int idleSeconds);
+
+        virtual std::string getRemoteIp() const;
+
+        virtual uint32_t getBinaryRemoteIp() const;
+
+        virtual uint16_t    getRemotePort() const;
+
+        virtual bool        isConnected() const;
+
+        UringService*   getService() const;
+
+        //! Received bytes kept for the reads before the receive is cancelled
+        static const size_t maxBufferedBytes = 64 * 1024;
+
+    private:
+        friend class UringTcpServer;
+
+        //! A write of the queue
+        struct QueuedWrite {
+            iovec           buffers[maxWriteBuffers];
+            size_t          count;
+            size_t          size;
+            //! Keeps the memory of a shared buffer until the write is done
+            SharedBuffer    owner;
+        };
+
+        //! Uses the accepted fd, in the service thread
+        void _adopt(int fd);
+        //! Closes the socket and gives it back to server once its
+        //! operations are completed, in the service thread
+        void _recycle(UringTcpServer* server);
+        //! Counts a completed operation, true if the socket is recycled:
+        //! the completion must then be ignored
+        bool _operationCompleted();
+        void _finishRecycle();
+        //! Closes the fd and forgets the state of the connection
+        void _clear();
+
+        void _connect(sockaddr_storage const& address, socklen_t length);
+        void _connectCompleted(int result, unsigned int flags);
+
+        void _read(void* buffer, uint32_t size, bool all);
+        void _readUntil(std::string const& delim);
+        void _armReceive();
+        void _receiveCompleted(int result, unsigned int flags);
+        void _cancelCompleted(int result, unsigned int flags);
+        //! Finishes the pending read if the buffered data is enough
+        void _deliver();
+
+        //! Queues a write in the service thread, or posts it
+        void _post(QueuedWrite const& queued);
+        void _flushPendingWrites();
+        //! Queues the write, and sends it if no write is in progress
+        void _write(QueuedWrite const& queued);
+        //! Sends the rest of the front of the queue
+        void _startWrite();
+        void _writeCompleted(int result, unsigned int flags);
+
+        //! Sets the deadline of an operation starting now, if enabled
+        void _startDeadline(Timeout timeout);
+        void _stopDeadline(Timeout timeout);
+        //! Follows the ticks of the service while a deadline is set
+        void _updateTicker();
+        virtual void tick(uint64_t now);
+
+        bool _getPeer(sockaddr_in& address) const;
+
+        UringService*   _service;
+        int             _fd;
+        std::atomic<bool>   _closed;
+        //! Operations in the ring
+        unsigned int    _outstanding;
+        //! Set while the socket is being recycled
+        UringTcpServer* _server;
+
+        UringService::BoundOperation<UringTcpSocket>    _connectOperation;
+        UringService::BoundOperation<UringTcpSocket>    _receiveOperation;
+        UringService::BoundOperation<UringTcpSocket>    _cancelOperation;
+        UringService::BoundOperation<UringTcpSocket>    _writeOperation;
+        sockaddr_storage    _connectAddress;
+
+        //! Received data, from _receivedStart
+        std::string     _received;
+        size_t          _receivedStart;
+        bool            _receiveArmed;
+        bool            _receiveCancelled;
+        //! The peer closed the connection, or the receive failed
+        bool            _receiveError;
+        //! Pending read(), or readUntil() if the delimiter is not empty
+        bool            _readPending;
+        void*           _readBuffer;
+        uint32_t        _readSize;
+        bool            _readAll;
+        std::string     _delimiter;
+        //! The delegate is being called by _deliver()
+        bool            _delivering;
+
+        //! Outbound queue, the front element is being sent. Only used in
+        //! the service thread.
+        boost::circular_buffer<QueuedWrite> _writeQueue;
+        //! Bytes of the front element already sent
+        size_t          _writeOffset;
+        iovec           _writeBuffers[maxWriteBuffers];
+        msghdr          _writeMessage;
+        //! Writes requested outside of the service thread
+        std::vector<QueuedWrite>    _pendingWrites;
+        std::vector<QueuedWrite>    _flushedWrites;
+        boost::mutex    _pendingWritesMutex;
+        bool            _flushPosted;
+
+        //! In milliseconds, 0 when disabled
+        unsigned int    _timeouts[TimeoutCount];
+        //! Service time, 0 when not running
+        uint64_t        _deadlines[TimeoutCount];
+        bool            _ticking;
+    };
+
+}
+
+#endif /* defined(__Babel_Server__UringTcpSocket__) */
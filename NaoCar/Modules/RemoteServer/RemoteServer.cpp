@@ -5,17 +5,30 @@
 
 #include "RemoteServer.hpp"
 
-#include <iostream>
 #include <alcommon/albroker.h>
 #include <alcommon/almodule.h>
 #include <alcommon/albrokermanager.h>
 #include <alcommon/altoolsmain.h>
 #include <dns_sd.h>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 
 #include "AutoDriving.hpp"
+#include "Log.hpp"
+
+// Number of threads running the io_service, 0 for one per core
+#ifndef REMOTE_SERVER_NETWORK_THREADS
+# define REMOTE_SERVER_NETWORK_THREADS 0
+#endif
+
+// Socket file of the local server, none when empty
+#ifndef REMOTE_SERVER_LOCAL_SOCKET
+# define REMOTE_SERVER_LOCAL_SOCKET "/tmp/nao-car.sock"
+#endif
 
 #ifdef NAO_LOCAL_COMPILATION
 # define WEB_FILE "/home/nao/modules/RemoteServer/index.html"
@@ -23,48 +36,54 @@
 # define WEB_FILE "Modules/RemoteServer/Resources/index.html"
 #endif
 
-std::map<std::string, RemoteServer::GetFunction> RemoteServer::_getFunctions;
-
-static bool urlDecode(const std::string& in, std::string& out);
+// Indexed by CommandId. Timeouts cover the wait in the executor queue and
+// the NAOqi calls: posture changes and animations take a few seconds.
+const RemoteServer::Command RemoteServer::_commands[CommandCount] = {
+    { GetStreamPortCommand, "/get-stream-port", &RemoteServer::getStreamPort, 0, {} },
+    { BeginCommand, "/begin", &RemoteServer::begin, 15000, {} },
+    { EndCommand, "/end", &RemoteServer::end, 15000, {} },
+    { GoFrontwardsCommand, "/go-frontwards", &RemoteServer::goFrontwards, 3000, {} },
+    { GoBackwardsCommand, "/go-backwards", &RemoteServer::goBackwards, 3000, {} },
+    { TurnLeftCommand, "/turn-left", &RemoteServer::turnLeft, 3000, {} },
+    { TurnRightCommand, "/turn-right", &RemoteServer::turnRight, 3000, {} },
+    { TurnFrontCommand, "/turn-front", &RemoteServer::turnFront, 3000, {} },
+    { StopCommand, "/stop", &RemoteServer::stop, 3000, {} },
+    { SteeringWheelActionCommand, "/steeringwheel-action",
+      &RemoteServer::steeringWheelAction, 5000, {} },
+    { FunActionCommand, "/fun-action", &RemoteServer::funAction, 5000, {} },
+    { CarambarActionCommand, "/carambar-action",
+      &RemoteServer::carambarAction, 5000, {} },
+    { SetHeadCommand, "/setHead", &RemoteServer::setHead, 1000,
+      { { "headYaw", CommandParam::Float, 0, 0 },
+        { "headPitch", CommandParam::Float, 1, 0 },
+        { "maxSpeed", CommandParam::Float, 2, 1 } } },
+    { TalkCommand, "/talk", &RemoteServer::talk, 5000,
+      { { "message", CommandParam::Text, 0, 0 } } },
+    { ChangeViewCommand, "/change-view", &RemoteServer::changeView, 3000,
+      { { "view", CommandParam::Int, 0, 0 } } },
+    { AutoDrivingCommand, "/auto-driving", &RemoteServer::autoDriving, 10000,
+      { { "mode", CommandParam::Text, 0, 0 } } },
+    { UpShiftCommand, "/upshift", &RemoteServer::upShift, 3000, {} },
+    { DownShiftCommand, "/downshift", &RemoteServer::downShift, 3000, {} },
+    { PushPedalCommand, "/push-pedal", &RemoteServer::pushPedal, 3000, {} },
+    { ReleasePedalCommand, "/release-pedal", &RemoteServer::releasePedal, 3000, {} },
+    { GetControlPortCommand, "/get-control-port", &RemoteServer::getControlPort, 0, {} }
+};
 
 RemoteServer::RemoteServer(boost::shared_ptr<AL::ALBroker> broker,
                            const std::string &name) :
     AL::ALModule(broker, name), _broker(broker), _ioService(new boost::asio::io_service()),
-    _bonjour(*_ioService, this), _networkThread(NULL), _tcpServer(NULL),
-    _clients(), _toWrite(),
-    _streamServer(), _streamPort(), _isListening(false),
+    _strand(*_ioService), _bonjour(*_ioService, this), _assets(), _networkThreads(),
+    _tcpServer(NULL), _localServer(NULL),
+    _clients(), _freeResponses(), _executor(NULL),
+    _streamServer(), _streamPort(), _controlServer(NULL), _controlPort(),
+    _isListening(false),
     _drive(NULL), _autoDriving(NULL), _voiceSpeaker(broker),
     _leds(getParentBroker()), _memProxy(getParentBroker()),
     _speechRecognition(NULL), _dcm(NULL),
+    _driveState(), _pushedState(), _autoDrivingState(false),
     _lastEventTime(), _isEventOn()
 {
-    if (_getFunctions.size() == 0) {
-        _getFunctions["/"] = &RemoteServer::defaultParams;
-        _getFunctions["/get-stream-port"] = &RemoteServer::getStreamPort;
-        _getFunctions["/begin"] = &RemoteServer::begin;
-        _getFunctions["/end"] = &RemoteServer::end;
-
-        _getFunctions["/go-frontwards"] = &RemoteServer::goFrontwards;
-        _getFunctions["/go-backwards"] = &RemoteServer::goBackwards;
-        _getFunctions["/turn-left"] = &RemoteServer::turnLeft;
-        _getFunctions["/turn-right"] = &RemoteServer::turnRight;
-        _getFunctions["/turn-front"] = &RemoteServer::turnFront;
-        _getFunctions["/stop"] = &RemoteServer::stop;
-        _getFunctions["/steeringwheel-action"] =
-                &RemoteServer::steeringWheelAction;
-        _getFunctions["/fun-action"] = &RemoteServer::funAction;
-        _getFunctions["/carambar-action"] = &RemoteServer::carambarAction;
-        _getFunctions["/setHead"] = &RemoteServer::setHead;
-        _getFunctions["/talk"] = &RemoteServer::talk;
-        _getFunctions["/change-view"] = &RemoteServer::changeView;
-        _getFunctions["/auto-driving"] = &RemoteServer::autoDriving;
-
-        _getFunctions["/upshift"] = &RemoteServer::upShift;
-        _getFunctions["/downshift"] = &RemoteServer::downShift;
-        _getFunctions["/push-pedal"] = &RemoteServer::pushPedal;
-        _getFunctions["/release-pedal"] = &RemoteServer::releasePedal;
-
-    }
     setModuleDescription("NaoCar Remote server");
 
     _autoDriving = NULL;
@@ -80,17 +99,54 @@ RemoteServer::RemoteServer(boost::shared_ptr<AL::ALBroker> broker,
                                getName(), "sensorEvent");
     _memProxy.subscribeToEvent("FrontTactilTouched",
                                getName(), "sensorEvent");
+
+    functionName("driveStateChanged", getName(), "The Drive module state has changed");
+    BIND_METHOD(RemoteServer::driveStateChanged);
+    _memProxy.subscribeToEvent(DRIVE_STATE_EVENT, getName(), "driveStateChanged");
 }
 
 RemoteServer::~RemoteServer()
 {
-    delete _streamServer;
     _ioService->stop();
-    if (_networkThread != NULL) {
-        _networkThread->join();
-        delete _networkThread;
+    for (size_t i = 0; i < _networkThreads.size(); ++i) {
+        _networkThreads[i]->join();
+        delete _networkThreads[i];
     }
+    // Waits for the running command, which may use the servers
+    if (_executor)
+        _executor->stop();
+    if (_streamServer)
+        _streamServer->close();
+    if (_controlServer)
+        _controlServer->close();
+    if (_tcpServer)
+        _tcpServer->close();
+    if (_localServer)
+        _localServer->close();
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it)
+        it->second->socket->setDelegate(NULL);
+    // The completions of the commands are written while everything they
+    // use is alive
+    Network::BoostTcpServer::drain(_ioService);
+    delete _executor;
+    delete _streamServer;
+    delete _controlServer;
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it)
+        it->second->server->release(it->second->socket);
+    // The sockets are recycled before their servers are destroyed
+    Network::BoostTcpServer::drain(_ioService);
     delete _tcpServer;
+    delete _localServer;
+    for (size_t i = 0; i < _freeResponses.size(); ++i)
+        delete _freeResponses[i];
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it) {
+        for (size_t i = 0; i < it->second->responses.size(); ++i)
+            delete it->second->responses[i];
+        delete it->second;
+    }
     if (_speechRecognition) {
         delete _speechRecognition;
     }
@@ -101,26 +157,63 @@ RemoteServer::~RemoteServer()
 
 void	RemoteServer::init()
 {
+    // The table is indexed by CommandId
+    for (int id = 0; id < CommandCount; ++id)
+        if (_commands[id].id != id) {
+            LOG_ERROR("command " << _commands[id].path << " is not at index "
+                      << _commands[id].id);
+            return ;
+        }
+    // Web resources are loaded once, the network threads only read them
+    if (!_assets.load("/", WEB_FILE, "text/html")
+            || !_assets.alias("/index.html", "/"))
+        LOG_ERROR("could not load " << WEB_FILE);
     _tcpServer = new Network::BoostTcpServer(_ioService);
     _tcpServer->setDelegate(this);
+    _tcpServer->setStrand(&_strand);
     if (_tcpServer->listen(0, "") == false) {
-        std::cerr << "could not listen on this port" << std::endl;
+        LOG_ERROR("could not listen on this port");
         return ;
     }
+    // Same requests as over TCP, without the TCP stack
+    if (REMOTE_SERVER_LOCAL_SOCKET[0] != '\0') {
+        _localServer = new Network::BoostLocalServer(_ioService);
+        _localServer->setDelegate(this);
+        _localServer->setStrand(&_strand);
+        if (_localServer->listen(0, REMOTE_SERVER_LOCAL_SOCKET) == false) {
+            LOG_ERROR("could not listen on " << REMOTE_SERVER_LOCAL_SOCKET);
+            delete _localServer;
+            _localServer = NULL;
+        } else {
+            LOG_INFO("Server Socket: " << REMOTE_SERVER_LOCAL_SOCKET);
+        }
+    }
+    _executor = new CommandExecutor(_ioService);
+    _executor->start();
     _streamServer = new StreamServer(_ioService);
     _streamPort = _streamServer->run();
-    std::cout << "Server Port: " << _tcpServer->getPort() << std::endl;
+    _controlServer = new ControlServer(_ioService, this);
+    _controlPort = _controlServer->run();
+    LOG_INFO("Server Port: " << _tcpServer->getPort());
     if (!_bonjour.registerService("nao-car", "_http._tcp",
                                   _tcpServer->getPort()))
-        std::cerr << "Could not register Bonjour service" << std::endl;
-    _networkThread = new boost::thread(&RemoteServer::networkThread, this);
+        LOG_ERROR("Could not register Bonjour service");
+    // Each server serializes its own handlers, the servers run in parallel
+    unsigned int threads = REMOTE_SERVER_NETWORK_THREADS;
+    if (threads == 0)
+        threads = boost::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    for (unsigned int i = 0; i < threads; ++i)
+        _networkThreads.push_back(new boost::thread(&RemoteServer::networkThread, this));
+    LOG_INFO("Network threads: " << threads);
 }
 
 void	RemoteServer::serviceRegistered(bool error, std::string const& name) {
     if (error) {
-        std::cout << "Cannot register Bonjour service" << std::endl;
+        LOG_ERROR("Cannot register Bonjour service");
     } else {
-        std::cout << "\"" << name << "\"" << " Bonjour service registered" << std::endl;
+        LOG_INFO("\"" << name << "\"" << " Bonjour service registered");
     }
 }
 
@@ -130,12 +223,17 @@ void	RemoteServer::networkThread() {
 
 void	RemoteServer::newConnection(Network::ATcpServer* sender,
                                     Network::ATcpSocket* socket) {
-    if (_tcpServer != sender)
+    if (sender != _tcpServer && sender != _localServer)
         return ;
+    // Responses are small and sent as soon as a command is done
+    socket->setNoDelay(true);
+    Client* client = new Client();
+    client->server = sender;
+    client->socket = socket;
     socket->setDelegate(this);
-    _clients.push_back(socket);
-    std::cout << "Connection " << _clients.size() << std::endl;
-    socket->readUntil("\r\n");
+    _clients[socket] = client;
+    LOG_INFO("Connection " << _clients.size());
+    _parseRequests(client);
 }
 
 void	RemoteServer::connected(Network::ASocket*,
@@ -145,43 +243,71 @@ void	RemoteServer::connected(Network::ASocket*,
 
 void    RemoteServer::readFinished(Network::ASocket* sender,
                                    Network::ASocket::Error error,
-                                   size_t) {
-    Network::ATcpSocket	*socket = dynamic_cast<Network::ATcpSocket*>(sender);
+                                   size_t bytesRead) {
+    Client* client = _getClient(sender);
 
-    if (socket == NULL)
+    if (client == NULL)
         return ;
+    client->reading = false;
     if (error) {
-        _clients.remove(socket);
-        delete socket;
-        std::cout << "Deconnection " << _clients.size() << std::endl;
+        _closeClient(client);
+        return ;
     }
+    client->size += bytesRead;
+    _parseRequests(client);
 }
 
-void    RemoteServer::readFinished(Network::ASocket* sender,
-                                   Network::ASocket::Error error,
-                                   std::string const& buffer) {
-    Network::ATcpSocket	*socket = dynamic_cast<Network::ATcpSocket*>(sender);
+void    RemoteServer::readFinished(Network::ASocket*,
+                                   Network::ASocket::Error,
+                                   Network::ASocket::Buffer const&) {
+}
+
+void    RemoteServer::writeFinished(Network::ASocket* sender,
+                                    Network::ASocket::Error error,
+                                    size_t) {
+    Client* client = _getClient(sender);
 
-    if (socket == NULL)
+    if (client == NULL || client->written == 0)
         return ;
-    if (error) {
-        _clients.remove(socket);
-        delete socket;
-        std::cout << "Deconnection " << _clients.size() << std::endl;
-    } else {
-        _parseReceivedData(socket, buffer);
-        socket->readUntil("\r\n");
-    }
+    _freeResponses.push_back(client->responses.front());
+    client->responses.pop_front();
+    --client->written;
+    if (error)
+        client->closing = true;
+    if (!client->closing || !client->responses.empty())
+        return ;
+    if (client->streaming && !error)
+        _handOverStream(client);
+    else
+        _destroyClient(client);
 }
 
-void    RemoteServer::writeFinished(Network::ASocket*,
-                                    Network::ASocket::Error error,
-                                    size_t len) {
-    delete _toWrite.front().second;
-    _toWrite.pop_front();
-    if (_toWrite.size() >= 1)
-        _toWrite.front().first->write(_toWrite.front().second->str().c_str(),
-                                      _toWrite.front().second->str().size());
+RemoteServer::Client*	RemoteServer::_getClient(Network::ASocket* socket) {
+    std::map<Network::ASocket*, Client*>::iterator it = _clients.find(socket);
+
+    if (it == _clients.end())
+        return NULL;
+    return it->second;
+}
+
+void	RemoteServer::_closeClient(Client* client) {
+    client->closing = true;
+    if (client->responses.empty())
+        _destroyClient(client);
+}
+
+void	RemoteServer::_destroyClient(Client* client) {
+    // The read is aborted, the client is destroyed once it has failed
+    if (client->reading) {
+        client->closing = true;
+        client->socket->close();
+        return ;
+    }
+    _clients.erase(client->socket);
+    // Closed, and kept for the next connection
+    client->server->release(client->socket);
+    delete client;
+    LOG_INFO("Deconnection " << _clients.size());
 }
 
 void RemoteServer::sensorEvent(const std::string& eventName,
@@ -208,11 +334,25 @@ void RemoteServer::speechRecognized(const std::string& eventName,
                                     const AL::ALValue& value,
                                     const std::string& subscriberIdentifier) {
     for (unsigned int i = 0; i < value.getSize()/2 ; ++i) {
-        std::cout << "word recognized: " << value[i*2].toString()
-                  << " with confidence: " << (float)value[i*2+1] << std::endl;
+        LOG_INFO("word recognized: " << value[i*2].toString()
+                 << " with confidence: " << (float)value[i*2+1]);
     }
 }
 
+void RemoteServer::driveStateChanged(const std::string&,
+                                     const AL::ALValue& value,
+                                     const std::string&) {
+    std::vector<int> state;
+
+    for (unsigned int i = 0; i < value.getSize(); ++i)
+        state.push_back((int)value[i]);
+    // WebSocket clients are only touched in the strand
+    _strand.post(boost::bind(&RemoteServer::_setDriveState, this, state));
+}
+
+static void	ignoreResult(ControlStatus, std::string const&) {
+}
+
 void RemoteServer::_doubleClickEvent(const std::string& event, int now) {
     if (event == "RearTactilTouched"
             && _isEventOn["FrontTactilTouched"]
@@ -221,8 +361,10 @@ void RemoteServer::_doubleClickEvent(const std::string& event, int now) {
         _voiceSpeaker.say("Calibration", "English");
         _autoDriving->calibration();
     } else if (event == "MiddleTactilTouched") {
-        std::map<std::string, std::string> params;
-        autoDriving(NULL, params);
+        // Commands are dispatched from the strand, like the network ones
+        _strand.post(boost::bind(&RemoteServer::_dispatchCommand, this,
+                                     &_commands[AutoDrivingCommand], CommandArgs(),
+                                     CommandExecutor::Completion(&ignoreResult)));
     }
 }
 
@@ -233,120 +375,609 @@ void RemoteServer::_startListening(const std::vector<std::string>& words) {
     if (_isListening) {
         _stopListening();
     }
-    std::cout << "Start listening..." << std::endl;
+    LOG_INFO("Start listening...");
     try {
         _speechRecognition->setLanguage("French");
         _speechRecognition->setWordListAsVocabulary(words);
         _memProxy.subscribeToEvent("WordRecognized", getName(), "speechRecognized");
     } catch(const std::exception& e) {
-        std::cout << "An error ocured: " << e.what() << std::endl;
+        LOG_WARNING("An error ocured: " << e.what());
     } catch(...) {
-        std::cout << "An error ocured" << std::endl;
+        LOG_WARNING("An error ocured");
     }
     _isListening = true;
 }
 
 void RemoteServer::_stopListening(void) {
-    std::cout << "Stop listening" << std::endl;
+    LOG_INFO("Stop listening");
     try {
         _memProxy.unsubscribeToEvent("WordRecognized", getName());
     } catch(const std::exception& e) {
-        std::cout << "An error ocured: " << e.what() << std::endl;
+        LOG_WARNING("An error ocured: " << e.what());
     } catch(...) {
-        std::cout << "An error ocured" << std::endl;
+        LOG_WARNING("An error ocured");
     }
     _isListening = false;
 }
 
-void	RemoteServer::_parseReceivedData(Network::ATcpSocket* sender,
-                                         std::string const& data) {
-    size_t idx = data.find("\n");
-    if (idx == std::string::npos || idx < 2)
+void	RemoteServer::_parseRequests(Client* client) {
+    size_t offset = 0;
+
+    if (client->webSocket) {
+        _parseWebSocketFrames(client);
         return ;
-    std::string line = data.substr(0, idx - 1);
-    std::vector<std::string> words;
-    boost::split(words, line, boost::is_any_of(" "));
-
-    if (words.size() >= 3 && words[0] == "GET") {
-        std::string funcName = words[1];
-        std::map<std::string, std::string> params;
-        idx = funcName.find("?");
-        if (idx != std::string::npos) {
-            std::string paramsString = funcName.substr(idx + 1);
-            funcName = funcName.substr(0, idx);
-            std::vector<std::string> keyValues;
-            boost::split(keyValues, paramsString, boost::is_any_of("&"));
-            for (auto it = keyValues.begin(); it != keyValues.end(); ++it) {
-                std::string key;
-                std::string value;
-
-                idx = it->find("=");
-                if (idx == std::string::npos) {
-                    urlDecode(*it, key);
-                } else {
-                    urlDecode(it->substr(0, idx), key);
-                    urlDecode(it->substr(idx + 1), value);
-                }
-                params[key] = value;
-            }
+    }
+    // Answer every complete request of the buffer, in order
+    while (!client->closing && !client->webSocket) {
+        size_t consumed = 0;
+        HttpParser::Status status =
+                client->parser.parse(client->buffer + offset,
+                                     client->size - offset, consumed);
+        offset += consumed;
+        if (status == HttpParser::Incomplete)
+            break ;
+        if (status == HttpParser::Invalid) {
+            client->keepAlive = false;
+            _writeHttpResponse(client, boost::asio::const_buffer("Bad Request", 11),
+                               "400 Bad Request");
+            break ;
         }
-        GetFunction func = _getFunctions[funcName];
-        std::cout << funcName;
-        if (func != NULL)
-            try {
-            (this->*func)(sender, params);
-            std::cout << " => OK" << std::endl;
-        } catch (std::exception e) {
-            std::cout << " => " << e.what() << std::endl;
-            _writeHttpResponse(sender, boost::asio::const_buffer("An error occured", 16), "404 Not Found");
-        } catch (...) {
-            std::cout << " => An error occured" << std::endl;
-            _writeHttpResponse(sender, boost::asio::const_buffer("An error occured", 16), "404 Not Found");
+        if (status == HttpParser::TooLarge) {
+            client->keepAlive = false;
+            _writeHttpResponse(client, boost::asio::const_buffer("Request Too Large", 17),
+                               "431 Request Header Fields Too Large");
+            break ;
         }
-        else {
-            std::cout << " => Unknown command" << std::endl;
-            _writeHttpResponse(sender, boost::asio::const_buffer("Unknown Command", 15), "404 Not Found");
+        client->keepAlive = client->parser.getRequest().keepAlive;
+        _handleRequest(client, client->parser.getRequest());
+        client->parser.reset();
+    }
+    // Keep the beginning of the next request for the next read
+    memmove(client->buffer, client->buffer + offset, client->size - offset);
+    client->size -= offset;
+    if (client->closing) {
+        // Otherwise handed over by writeFinished()
+        if (client->streaming && client->responses.empty())
+            _handOverStream(client);
+        return ;
+    }
+    // Frames sent right after the upgrade request are already buffered
+    if (client->webSocket) {
+        _parseWebSocketFrames(client);
+        return ;
+    }
+    if (client->size == sizeof(client->buffer)) {
+        client->keepAlive = false;
+        _writeHttpResponse(client, boost::asio::const_buffer("Request Too Large", 17),
+                           "431 Request Header Fields Too Large");
+        return ;
+    }
+    client->reading = true;
+    client->socket->read(client->buffer + client->size,
+                         sizeof(client->buffer) - client->size, false);
+}
+
+void	RemoteServer::_handleRequest(Client* client,
+                                     HttpRequest const& request) {
+    if (request.method != "GET") {
+        _writeHttpResponse(client, boost::asio::const_buffer("Method Not Allowed", 18),
+                           "405 Method Not Allowed", "text/plain", "Allow: GET\r\n");
+        return ;
+    }
+    if (request.path == "/ws"
+            && boost::iequals(request.getHeader("upgrade"), "websocket")) {
+        _upgradeWebSocket(client, request);
+        return ;
+    }
+    if (request.path == "/stream.mjpeg") {
+        _requestStream(client);
+        return ;
+    }
+    AssetCache::Asset const* asset = _assets.find(request.path);
+    if (asset != NULL) {
+        _writeAsset(client, *asset, request);
+        return ;
+    }
+
+    Command const* command = _findCommand(request.path.data(),
+                                          request.path.size());
+    if (command == NULL) {
+        LOG_INFO(request.path << " => Unknown command");
+        _writeHttpResponse(client, boost::asio::const_buffer("Unknown Command", 15), "404 Not Found");
+        return ;
+    }
+    CommandArgs args;
+    if (!parseCommandArgs(request.query.data(), request.query.size(),
+                          command->params, args)) {
+        LOG_INFO(request.path << " => Invalid parameters");
+        _writeHttpResponse(client, boost::asio::const_buffer("Invalid Parameters", 18),
+                           "400 Bad Request");
+        return ;
+    }
+    // Later requests are read meanwhile, their responses wait for this one
+    Response* response = _reserveResponse(client);
+    _dispatchCommand(command, args,
+                     _strand.wrap(boost::bind(&RemoteServer::_commandFinished, this,
+                                              response, _1, _2)));
+}
+
+void	RemoteServer::_commandFinished(Response* response, ControlStatus status,
+                                       std::string const& body) {
+    boost::asio::const_buffer buffer;
+
+    switch (status) {
+    case ControlOk:
+        response->body = body;
+        buffer = boost::asio::const_buffer(response->body.data(), response->body.size());
+        _sendResponse(response, &buffer, 1, "200 OK", "text/plain", "");
+        break ;
+    case ControlUnavailable:
+        buffer = boost::asio::const_buffer("Unavailable", 11);
+        _sendResponse(response, &buffer, 1, "503 Service Unavailable", "text/plain", "");
+        break ;
+    case ControlTimeout:
+        buffer = boost::asio::const_buffer("Timeout", 7);
+        _sendResponse(response, &buffer, 1, "504 Gateway Timeout", "text/plain", "");
+        break ;
+    case ControlSuperseded:
+        buffer = boost::asio::const_buffer("Superseded", 10);
+        _sendResponse(response, &buffer, 1, "409 Conflict", "text/plain", "");
+        break ;
+    default:
+        buffer = boost::asio::const_buffer("An error occured", 16);
+        _sendResponse(response, &buffer, 1, "404 Not Found", "text/plain", "");
+        break ;
+    }
+}
+
+void	RemoteServer::controlCommand(CommandId command,
+                                     float const* values,
+                                     unsigned int present,
+                                     ControlCompletion const& completion) {
+    CommandArgs args;
+
+    if (!setCommandArgs(values, present, _commands[command].params, args)) {
+        completion(ControlError);
+        return ;
+    }
+    // The response of the command is not part of the control protocol
+    _dispatchCommand(&_commands[command], args, boost::bind(completion, _1));
+}
+
+void	RemoteServer::_dispatchCommand(Command const* command,
+                                       CommandArgs const& args,
+                                       CommandExecutor::Completion const& completion) {
+    if (command->timeout == 0) {
+        std::string response;
+        ControlStatus status = _executeCommand(command, args, response);
+        completion(status, response);
+        return ;
+    }
+    _executor->execute(boost::bind(&RemoteServer::_executeCommand, this,
+                                   command, args, _1),
+                       getCommandGroup(command->id), command->timeout,
+                       completion);
+}
+
+ControlStatus	RemoteServer::_executeCommand(Command const* command,
+                                              CommandArgs const& args,
+                                              std::string& response) {
+    try {
+        if ((this->*command->function)(args, response)) {
+            LOG_INFO(command->path << " => OK");
+            return ControlOk;
         }
+        LOG_INFO(command->path << " => Unavailable");
+        return ControlUnavailable;
+    } catch (std::exception const& e) {
+        LOG_WARNING(command->path << " => " << e.what());
+    } catch (...) {
+        LOG_WARNING(command->path << " => An error occured");
+    }
+    return ControlError;
+}
+
+RemoteServer::Command const*	RemoteServer::_findCommand(const char* path,
+                                                           size_t size) {
+    CommandId id;
+
+    // Labels are hashed at compile time: two colliding routes do not build
+    switch (commandHash(path, size)) {
+    case commandHash("/get-stream-port"): id = GetStreamPortCommand; break ;
+    case commandHash("/begin"): id = BeginCommand; break ;
+    case commandHash("/end"): id = EndCommand; break ;
+    case commandHash("/go-frontwards"): id = GoFrontwardsCommand; break ;
+    case commandHash("/go-backwards"): id = GoBackwardsCommand; break ;
+    case commandHash("/turn-left"): id = TurnLeftCommand; break ;
+    case commandHash("/turn-right"): id = TurnRightCommand; break ;
+    case commandHash("/turn-front"): id = TurnFrontCommand; break ;
+    case commandHash("/stop"): id = StopCommand; break ;
+    case commandHash("/steeringwheel-action"): id = SteeringWheelActionCommand; break ;
+    case commandHash("/fun-action"): id = FunActionCommand; break ;
+    case commandHash("/carambar-action"): id = CarambarActionCommand; break ;
+    case commandHash("/setHead"): id = SetHeadCommand; break ;
+    case commandHash("/talk"): id = TalkCommand; break ;
+    case commandHash("/change-view"): id = ChangeViewCommand; break ;
+    case commandHash("/auto-driving"): id = AutoDrivingCommand; break ;
+    case commandHash("/upshift"): id = UpShiftCommand; break ;
+    case commandHash("/downshift"): id = DownShiftCommand; break ;
+    case commandHash("/push-pedal"): id = PushPedalCommand; break ;
+    case commandHash("/release-pedal"): id = ReleasePedalCommand; break ;
+    case commandHash("/get-control-port"): id = GetControlPortCommand; break ;
+    default: return NULL;
+    }
+    // Rule out paths that merely share the hash of a route
+    Command const* command = &_commands[id];
+    if (strncmp(command->path, path, size) != 0 || command->path[size] != '\0')
+        return NULL;
+    return command;
+}
+
+void	RemoteServer::_writeHttpResponse(Client* target,
+                                         boost::asio::const_buffer const& body,
+                                         const char* code, const char* contentType,
+                                         const char* extraHeaders) {
+    _sendResponse(_newResponse(target), &body, 1, code, contentType, extraHeaders);
+}
+
+void	RemoteServer::_writeHttpResponse(Client* target, std::string& body,
+                                         const char* code, const char* contentType,
+                                         const char* extraHeaders) {
+    Response* response = _newResponse(target);
+
+    response->body.swap(body);
+    boost::asio::const_buffer buffer(response->body.data(), response->body.size());
+    _sendResponse(response, &buffer, 1, code, contentType, extraHeaders);
+}
+
+RemoteServer::Response*	RemoteServer::_newResponse(Client* target) {
+    Response* response;
+
+    if (_freeResponses.empty()) {
+        response = new Response();
+    } else {
+        response = _freeResponses.back();
+        _freeResponses.pop_back();
+        response->body.clear();
+    }
+    response->client = target;
+    response->keepAlive = target->keepAlive;
+    response->reserved = false;
+    response->count = 0;
+    return response;
+}
+
+RemoteServer::Response*	RemoteServer::_reserveResponse(Client* target) {
+    Response* response = _newResponse(target);
+
+    response->reserved = true;
+    target->responses.push_back(response);
+    // No more requests are read, the connection closes after this response
+    if (!target->keepAlive)
+        target->closing = true;
+    return response;
+}
+
+void	RemoteServer::_sendResponse(Response* response,
+                                    boost::asio::const_buffer const* body, size_t count,
+                                    const char* code, const char* contentType,
+                                    const char* extraHeaders) {
+    Client* target = response->client;
+    size_t length = 0;
+
+    assert(count < Network::ASocket::maxWriteBuffers);
+    for (size_t i = 0; i < count; ++i) {
+        response->buffers[i + 1].data = boost::asio::buffer_cast<const char*>(body[i]);
+        response->buffers[i + 1].size = boost::asio::buffer_size(body[i]);
+        length += response->buffers[i + 1].size;
+    }
+    int headerSize = snprintf(response->header, sizeof(response->header),
+                              "HTTP/1.1 %s\r\n"
+                              "Content-Type: %s; charset=utf-8\r\n"
+                              "Content-Length: %lu\r\n"
+                              "%s"
+                              "Connection: %s\r\n"
+                              "\r\n",
+                              code, contentType, (unsigned long)length, extraHeaders,
+                              response->keepAlive ? "keep-alive" : "close");
+    // Header fields only come from the server, never from the request
+    assert(headerSize > 0 && (size_t)headerSize < sizeof(response->header));
+    response->buffers[0].data = response->header;
+    response->buffers[0].size = headerSize;
+    response->count = count + 1;
+
+    _queueResponse(response);
+    // The connection is closed once the response has been sent
+    if (!response->keepAlive)
+        target->closing = true;
+}
+
+void	RemoteServer::_queueResponse(Response* response) {
+    if (!response->reserved)
+        response->client->responses.push_back(response);
+    _flushResponses(response->client);
+}
+
+void	RemoteServer::_flushResponses(Client* client) {
+    // A reserved response is ready once its buffers are set
+    while (client->written < client->responses.size()
+           && client->responses[client->written]->count > 0) {
+        Response* response = client->responses[client->written];
+        // The socket queues the write behind the previous responses
+        client->socket->write(response->buffers, response->count);
+        ++client->written;
+    }
+}
+
+void	RemoteServer::_requestStream(Client* client) {
+    if (_streamServer == NULL) {
+        _writeHttpResponse(client, boost::asio::const_buffer("Unavailable", 11),
+                           "503 Service Unavailable");
+        return ;
+    }
+    // The stream is the last response of the connection
+    client->streaming = true;
+    client->closing = true;
+}
+
+void	RemoteServer::_handOverStream(Client* client) {
+    Network::ATcpServer* server = client->server;
+    Network::ATcpSocket* socket = client->socket;
+
+    // The stream server releases the socket to its server once it is done
+    _clients.erase(socket);
+    delete client;
+    LOG_INFO("Stream over HTTP " << socket->getRemoteIp());
+    _streamServer->addMjpegClient(server, socket);
+}
+
+void	RemoteServer::_writeAsset(Client* target,
+                                  AssetCache::Asset const& asset,
+                                  HttpRequest const& request) {
+    std::string const& ifNoneMatch = request.getHeader("if-none-match");
+    bool notModified = ifNoneMatch == "*"
+            || ifNoneMatch.find(asset.etag) != std::string::npos;
+    bool gzip = !notModified && !asset.gzip.empty()
+            && request.getHeader("accept-encoding").find("gzip") != std::string::npos;
+    char headers[256];
+
+    snprintf(headers, sizeof(headers),
+             "ETag: %s\r\n"
+             "Cache-Control: no-cache\r\n"
+             "Vary: Accept-Encoding\r\n"
+             "%s",
+             asset.etag.c_str(), gzip ? "Content-Encoding: gzip\r\n" : "");
+    // Cached data outlives every response, it is sent without copy
+    if (notModified)
+        _writeHttpResponse(target, boost::asio::const_buffer("", 0),
+                           "304 Not Modified", asset.contentType.c_str(), headers);
+    else if (gzip)
+        _writeHttpResponse(target,
+                           boost::asio::const_buffer(&asset.gzip[0], asset.gzip.size()),
+                           "200 OK", asset.contentType.c_str(), headers);
+    else
+        _writeHttpResponse(target,
+                           boost::asio::const_buffer(asset.raw.empty() ? NULL : &asset.raw[0],
+                                                     asset.raw.size()),
+                           "200 OK", asset.contentType.c_str(), headers);
+}
+
+//! Appends data to out as the content of a JSON string
+static void	jsonEscape(std::string& out, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '"' || data[i] == '\\')
+            out += '\\';
+        // Control characters are dropped rather than escaped
+        if ((unsigned char)data[i] >= 0x20)
+            out += data[i];
     }
 }
 
-void	RemoteServer::_writeHttpResponse(Network::ATcpSocket* target,
-                                         boost::asio::const_buffer const& buffer,
-                                         std::string const& code, const std::string& contentType) {
-    std::stringstream size(std::ios_base::in |
-                           std::ios_base::out);
-    std::stringstream *data = new std::stringstream(std::ios_base::in |
-                                                    std::ios_base::out |
-                                                    std::ios_base::binary);
+//! Formats the answer to a command sent on a WebSocket
+//! Status of a WebSocket result
+static const char*	statusName(ControlStatus status) {
+    switch (status) {
+    case ControlOk: return "ok";
+    case ControlUnavailable: return "unavailable";
+    case ControlError: return "error";
+    case ControlUnknownCommand: return "unknown";
+    case ControlSuperseded: return "superseded";
+    case ControlTimeout: return "timeout";
+    default: return "error";
+    }
+}
+
+static std::string	resultMessage(std::string const& command, const char* status,
+                                  std::string const& response) {
+    std::string json = "{\"type\":\"result\",\"command\":\"";
+
+    jsonEscape(json, command.data(), command.size());
+    json += "\",\"status\":\"";
+    json += status;
+    json += "\",\"response\":\"";
+    jsonEscape(json, response.data(), response.size());
+    json += "\"}";
+    return json;
+}
+
+void	RemoteServer::_upgradeWebSocket(Client* client,
+                                        HttpRequest const& request) {
+    std::string const& key = request.getHeader("sec-websocket-key");
 
-    size << int(boost::asio::buffer_size(buffer));
-    std::string header;
-    header += "HTTP/1.1 " + code + "\r\n";
-    header += "Content-Type: "+contentType+"; charset=utf-8\r\n";
-    header += "Content-Length: " + std::string(size.str()) + "\r\n";
-    (*data) << header << "\r\n";
-    _writeData(target, data);
-    const char* tmpBuf = boost::asio::buffer_cast<const char*>(buffer);
-    int len = boost::asio::buffer_size(buffer);
-    int index = 0;
-    while (len > 0) {
-        std::stringstream *tmp = new std::stringstream(std::ios_base::in |
-                                                       std::ios_base::out |
-                                                       std::ios_base::binary);
-        tmp->write(&tmpBuf[index],
-                   (len > 65000) ? 65000 : len);
-        len -= 65000;
-        index += 65000;
+    if (key.empty() || request.getHeader("sec-websocket-version") != "13") {
+        client->keepAlive = false;
+        _writeHttpResponse(client, boost::asio::const_buffer("Bad Request", 11),
+                           "400 Bad Request", "text/plain",
+                           "Sec-WebSocket-Version: 13\r\n");
+        return ;
+    }
+    Response* response = _newResponse(client);
+    int headerSize = snprintf(response->header, sizeof(response->header),
+                              "HTTP/1.1 101 Switching Protocols\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Accept: %s\r\n"
+                              "\r\n",
+                              WebSocket::acceptKey(key).c_str());
+    assert(headerSize > 0 && (size_t)headerSize < sizeof(response->header));
+    response->buffers[0].data = response->header;
+    response->buffers[0].size = headerSize;
+    response->count = 1;
+    _queueResponse(response);
+    client->webSocket = true;
+    client->keepAlive = true;
+    LOG_INFO("WebSocket " << client->socket->getRemoteIp());
+
+    // New clients get the current state right away
+    std::string state = _getStateMessage();
+    _writeWebSocketFrame(client, WebSocket::Text, state.data(), state.size());
+}
+
+void	RemoteServer::_parseWebSocketFrames(Client* client) {
+    size_t offset = 0;
+
+    while (!client->closing) {
+        WebSocket::Opcode opcode;
+        char* payload;
+        size_t payloadSize;
+        size_t consumed;
+        // A frame always fits in the buffer along with its header
+        WebSocket::Status status =
+                WebSocket::parseFrame(client->buffer + offset, client->size - offset,
+                                      sizeof(client->buffer) - WebSocket::maxHeaderSize,
+                                      opcode, payload, payloadSize, consumed);
+        if (status == WebSocket::Incomplete)
+            break ;
+        if (status == WebSocket::Invalid) {
+            // 1002: protocol error
+            _writeWebSocketFrame(client, WebSocket::Close, "\x03\xea", 2);
+            client->closing = true;
+            break ;
+        }
+        offset += consumed;
+        if (opcode == WebSocket::Text) {
+            _handleWebSocketMessage(client, payload, payloadSize);
+        } else if (opcode == WebSocket::Ping) {
+            _writeWebSocketFrame(client, WebSocket::Pong, payload, payloadSize);
+        } else if (opcode == WebSocket::Close) {
+            _writeWebSocketFrame(client, WebSocket::Close, payload,
+                                 payloadSize < 2 ? payloadSize : 2);
+            client->closing = true;
+        }
+    }
+    memmove(client->buffer, client->buffer + offset, client->size - offset);
+    client->size -= offset;
+    if (client->closing)
+        return ;
+    client->reading = true;
+    client->socket->read(client->buffer + client->size,
+                         sizeof(client->buffer) - client->size, false);
+}
 
-        _writeData(target, tmp);
+void	RemoteServer::_handleWebSocketMessage(Client* client,
+                                              const char* message, size_t size) {
+    const char* query = (const char*)memchr(message, '?', size);
+    size_t pathSize = query ? query - message : size;
+    Command const* command = _findCommand(message, pathSize);
+    std::string path(message, pathSize);
+    const char* status;
+
+    if (command == NULL) {
+        LOG_INFO(path << " => Unknown command");
+        status = "unknown";
+    } else {
+        CommandArgs args;
+        if (query && !parseCommandArgs(query + 1, message + size - query - 1,
+                                       command->params, args)) {
+            LOG_INFO(path << " => Invalid parameters");
+            status = "invalid";
+        } else {
+            Response* response = _reserveResponse(client);
+            _dispatchCommand(command, args,
+                             _strand.wrap(boost::bind(&RemoteServer::_webSocketCommandFinished,
+                                                      this, response, path, _1, _2)));
+            return ;
+        }
     }
+    std::string json = resultMessage(path, status, std::string());
+    _writeWebSocketFrame(client, WebSocket::Text, json.data(), json.size());
+}
+
+void	RemoteServer::_webSocketCommandFinished(Response* response,
+                                                std::string const& command,
+                                                ControlStatus status,
+                                                std::string const& body) {
+    std::string json = resultMessage(command, statusName(status), body);
+
+    _setWebSocketFrame(response, WebSocket::Text, json.data(), json.size());
+    _queueResponse(response);
+}
+
+void	RemoteServer::_writeWebSocketFrame(Client* target, WebSocket::Opcode opcode,
+                                           const char* data, size_t size) {
+    Response* response = _newResponse(target);
+
+    _setWebSocketFrame(response, opcode, data, size);
+    _queueResponse(response);
+}
+
+void	RemoteServer::_setWebSocketFrame(Response* response, WebSocket::Opcode opcode,
+                                         const char* data, size_t size) {
+    response->body.assign(data, size);
+    response->buffers[0].data = response->header;
+    response->buffers[0].size = WebSocket::writeFrameHeader(opcode, size,
+                                                            response->header);
+    response->buffers[1].data = response->body.data();
+    response->buffers[1].size = response->body.size();
+    response->count = 2;
 }
 
-void	RemoteServer::_writeData(Network::ATcpSocket* target,
-                                 std::stringstream *buffer) {
-    _toWrite.push_back(std::pair<Network::ATcpSocket*, std::stringstream*>(target, buffer));
-    if (_toWrite.size() == 1)
-        target->write(buffer->str().c_str(), buffer->str().size());
+void	RemoteServer::_setDriveState(std::vector<int> const& state) {
+    _driveState = state;
+    _pushState();
+}
+
+void	RemoteServer::_notifyAutoDriving(bool started) {
+    _strand.post(boost::bind(&RemoteServer::_setAutoDrivingState, this, started));
+}
+
+void	RemoteServer::_setAutoDrivingState(bool started) {
+    _autoDrivingState = started;
+    _pushState();
+}
+
+void	RemoteServer::_pushState() {
+    std::string state = _getStateMessage();
+
+    if (state == _pushedState)
+        return ;
+    _pushedState = state;
+    for (std::map<Network::ASocket*, Client*>::iterator it = _clients.begin();
+         it != _clients.end(); ++it)
+        if (it->second->webSocket && !it->second->closing)
+            _writeWebSocketFrame(it->second, WebSocket::Text,
+                                 state.data(), state.size());
+}
+
+std::string	RemoteServer::_getStateMessage() const {
+    static const char* directions[] = { "left", "front", "right" };
+    int state[5] = { 0, 0, DriveProxy::Front, DriveProxy::Up, 0 };
+    std::stringstream message;
+
+    for (size_t i = 0; i < 5 && i < _driveState.size(); ++i)
+        state[i] = _driveState[i];
+    if (state[2] < DriveProxy::Left || state[2] > DriveProxy::Right)
+        state[2] = DriveProxy::Front;
+    message << "{\"type\":\"state\""
+            << ",\"pedal\":" << (state[0] ? "true" : "false")
+            << ",\"steeringWheel\":" << (state[1] ? "true" : "false")
+            << ",\"steering\":\"" << directions[state[2]] << "\""
+            << ",\"gear\":\"" << (state[3] == DriveProxy::Up ? "forward" : "backward") << "\""
+            << ",\"animating\":" << (state[4] ? "true" : "false")
+            << ",\"autoDriving\":"
+            << (_autoDrivingState ? "true" : "false")
+            << "}";
+    return message.str();
 }
 
 bool    RemoteServer::_initDriveProxy() {
@@ -362,239 +993,218 @@ bool    RemoteServer::_initDriveProxy() {
 }
 
 
-void	RemoteServer::defaultParams(Network::ATcpSocket* sender,
-                                    std::map<std::string, std::string> & params) {
-    for (auto it = params.begin(); it != params.end(); ++it)
-        std::cout << "\tkey='" << it->first << "' value='"
-                  << it->second << "'" << std::endl;
-
-    std::ifstream file(WEB_FILE, std::ios::in | std::ios::binary);
-
-    file.seekg (0, file.end);
-    int length = file.tellg();
-    file.seekg (0, file.beg);
-    char * buffer = new char [length];
-    file.read(buffer,length);
-
-    _writeHttpResponse(sender, boost::asio::const_buffer(buffer, length), "200 OK", "text/html");
-    delete [] buffer;
-    file.close();
-}
-
-void	RemoteServer::getStreamPort(Network::ATcpSocket* sender,
-                                    std::map<std::string, std::string>& params) {
-    (void)params;
+bool	RemoteServer::getStreamPort(CommandArgs const&,
+                                    std::string& response) {
     std::stringstream tmp(std::ios_base::in | std::ios_base::out);
     tmp << "stream-port:";
     tmp << _streamPort;
-    _writeHttpResponse(sender, boost::asio::const_buffer(tmp.str().c_str(),
-                                                         tmp.str().size()));
+    response = tmp.str();
+    return true;
 }
 
-void	RemoteServer::begin(Network::ATcpSocket* sender,
-                            std::map<std::string,std::string>&) {
+bool	RemoteServer::getControlPort(CommandArgs const&,
+                                     std::string& response) {
+    std::stringstream tmp(std::ios_base::in | std::ios_base::out);
+    tmp << "control-port:";
+    tmp << _controlPort;
+    response = tmp.str();
+    return true;
+}
+
+bool	RemoteServer::begin(CommandArgs const&,
+                            std::string&) {
     if (!_initDriveProxy())
-        return ;
+        return false;
     _drive->begin();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::end(Network::ATcpSocket* sender,
-                          std::map<std::string,std::string>&) {
+bool	RemoteServer::end(CommandArgs const&,
+                          std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _stopAutoDriving();
     _drive->end();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::goFrontwards(Network::ATcpSocket* sender,
-                                   std::map<std::string,std::string>&) {
+bool	RemoteServer::goFrontwards(CommandArgs const&,
+                                   std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->goFrontwards();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::goBackwards(Network::ATcpSocket* sender,
-                                  std::map<std::string,std::string>&) {
+bool	RemoteServer::goBackwards(CommandArgs const&,
+                                  std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->goBackwards();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::turnLeft(Network::ATcpSocket* sender,
-                               std::map<std::string,std::string>&) {
+bool	RemoteServer::turnLeft(CommandArgs const&,
+                               std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->turnLeft();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::turnRight(Network::ATcpSocket* sender,
-                                std::map<std::string,std::string>&) {
+bool	RemoteServer::turnRight(CommandArgs const&,
+                                std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->turnRight();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::turnFront(Network::ATcpSocket* sender,
-                                std::map<std::string,std::string>&) {
+bool	RemoteServer::turnFront(CommandArgs const&,
+                                std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->turnFront();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::stop(Network::ATcpSocket* sender,
-                           std::map<std::string,std::string>&) {
+bool	RemoteServer::stop(CommandArgs const&,
+                           std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->stop();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::steeringWheelAction(Network::ATcpSocket* sender,
-                                          std::map<std::string,std::string>&) {
+bool	RemoteServer::steeringWheelAction(CommandArgs const&,
+                                          std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->steeringWheelAction();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::funAction(Network::ATcpSocket* sender,
-                                std::map<std::string,
-                                std::string>&) {
+bool	RemoteServer::funAction(CommandArgs const&,
+                                std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->funAction();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::carambarAction(Network::ATcpSocket* sender,
-                                     std::map<std::string,
-                                     std::string>&) {
+bool	RemoteServer::carambarAction(CommandArgs const&,
+                                     std::string&) {
     if (!_drive)
-        return ;
+        return false;
     _drive->carambarAction();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
-}
-
-void	RemoteServer::setHead(Network::ATcpSocket* sender,
-                              std::map<std::string, std::string> &params) {
-    std::cout << "setHead" << std::endl;
-    for (auto it = params.begin(); it != params.end(); ++it)
-        std::cout << "\tkey='" << it->first << "' value='"
-                  << it->second << "'" << std::endl;
-    float	yaw = 0, pitch = 0, speed = 1;
-    if (params["headYaw"] != "")
-        yaw = atof(params["headYaw"].c_str());
-    if (params["headPitch"] != "")
-        pitch = atof(params["headPitch"].c_str());
-    if (params["maxSpeed"] != "")
-        speed = atof(params["maxSpeed"].c_str());
+    return true;
+}
+
+bool	RemoteServer::setHead(CommandArgs const& args,
+                              std::string&) {
     if (!_drive)
-        return ;
-    _drive->setHead(yaw, pitch, speed);
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+        return false;
+    _drive->setHead(args.floats[0], args.floats[1], args.floats[2]);
+    return true;
 }
 
 
-void	RemoteServer::talk(Network::ATcpSocket* sender,
-                           std::map<std::string, std::string> & params) {
-    _voiceSpeaker.say(params["message"]);
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+bool	RemoteServer::talk(CommandArgs const& args,
+                           std::string&) {
+    _voiceSpeaker.say(args.text);
+    return true;
 }
 
-void	RemoteServer::changeView(Network::ATcpSocket* sender,
-                                 std::map<std::string, std::string> & params) {
-    std::string view = params["view"];
-    if (view != "") {
+bool	RemoteServer::changeView(CommandArgs const& args,
+                                 std::string&) {
+    if (args.isSet(0)) {
         StreamServer::Camera c;
-        if (view == "1")
+        if (args.ints[0] == 1)
             c = StreamServer::Front;
-        else if (view == "2")
+        else if (args.ints[0] == 2)
             c = StreamServer::Opencv;
         else
             c = StreamServer::Bottom;
         _streamServer->setCamera(c);
     }
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::autoDriving(Network::ATcpSocket* sender,
-                                  std::map<std::string, std::string>& params) {
+bool	RemoteServer::autoDriving(CommandArgs const& args,
+                                  std::string&) {
     if (!_initDriveProxy())
-        return ;
+        return false;
     if (!_autoDriving) {
-        std::cout << std::endl << "Launching Auto-driving... ";
+        LOG_INFO("Launching Auto-driving...");
         try {
             _autoDriving = new AutoDriving(_streamServer, _drive);
         } catch(...) {
             _voiceSpeaker.say("I cannot drive by myself !", "English");
             _autoDriving = NULL;
-            std::cout << "Fail";
+            LOG_ERROR("Launching Auto-driving failed");
         }
-        std::cout << std::endl;
     }
     if (_autoDriving && !_autoDriving->isStart()) {
-        if (params["mode"] == "safe") {
+        if (strcmp(args.text, "safe") == 0) {
             _voiceSpeaker.say("safe driving enabled", "English");
             _autoDriving->start(AutoDriving::Safe);
+            _notifyAutoDriving(true);
         } else {
             _drive->begin();
             _drive->turnFront();
             _voiceSpeaker.say("auto driving", "English");
             _autoDriving->start(AutoDriving::Auto);
+            _notifyAutoDriving(true);
         }
     }
     else if (_autoDriving) {        
         _stopAutoDriving();
     }
-    if (sender) {
-        _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
-    }
+    return true;
 }
 
 void RemoteServer::_stopAutoDriving(void) {
     if (_autoDriving && _autoDriving->isStart()) {
-        std::cout << "stopping auto driving" << std::endl;
+        LOG_INFO("stopping auto driving");
         _autoDriving->stop();
-        std::cout << "Auto-driving stopped" << std::endl;
+        _notifyAutoDriving(false);
+        LOG_INFO("Auto-driving stopped");
         _drive->releasePedal();
         _drive->turnFront();
         _voiceSpeaker.say("auto driving stopped", "English");
     }
 }
 
-void	RemoteServer::upShift(Network::ATcpSocket* sender,
-                              std::map<std::string,
-                              std::string>&) {
+bool	RemoteServer::upShift(CommandArgs const&,
+                              std::string&) {
+    if (!_drive)
+        return false;
     _drive->upShift();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::downShift(Network::ATcpSocket* sender,
-                                std::map<std::string,
-                                std::string>&) {
+bool	RemoteServer::downShift(CommandArgs const&,
+                                std::string&) {
+    if (!_drive)
+        return false;
     _drive->downShift();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::pushPedal(Network::ATcpSocket* sender,
-                                std::map<std::string,
-                                std::string>&) {
+bool	RemoteServer::pushPedal(CommandArgs const&,
+                                std::string&) {
+    if (!_drive)
+        return false;
     _drive->pushPedal();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
-void	RemoteServer::releasePedal(Network::ATcpSocket* sender,
-                                   std::map<std::string,
-                                   std::string>&) {
+bool	RemoteServer::releasePedal(CommandArgs const&,
+                                   std::string&) {
+    if (!_drive)
+        return false;
     _drive->releasePedal();
-    _writeHttpResponse(sender, boost::asio::const_buffer("", 0));
+    return true;
 }
 
 //! Naoqi module registration
@@ -631,30 +1241,3 @@ int main(int argc, char* argv[])
     return ALTools::mainFunction("RemoteServerModule", argc, argv, sig);
 }
 #endif
-
-static bool urlDecode(const std::string& in, std::string& out)
-{
-    out.clear();
-    out.reserve(in.size());
-    for (std::size_t i = 0; i < in.size(); ++i) {
-        if (in[i] == '%') {
-            if (i + 3 <= in.size()) {
-                int value = 0;
-                std::istringstream is(in.substr(i + 1, 2));
-                if (is >> std::hex >> value) {
-                    out += static_cast<char>(value);
-                    i += 2;
-                } else {
-                    return false;
-                }
-            } else {
-                return false;
-            }
-        } else if (in[i] == '+') {
-            out += ' ';
-        } else {
-            out += in[i];
-        }
-    }
-    return true;
-}
@@ -13,9 +13,17 @@
 # include <alproxies/dcmproxy.h>
 # include <boost/asio.hpp>
 # include <boost/thread/thread.hpp>
+# include <deque>
 
+# include "AssetCache.hpp"
 # include "Bonjour.hpp"
+# include "Command.hpp"
+# include "CommandExecutor.hpp"
+# include "ControlServer.hpp"
+# include "ControlServerDelegate.hpp"
+# include "HttpParser.hpp"
 # include "BonjourDelegate.hpp"
+# include "Network/BoostLocalServer.h"
 # include "Network/BoostTcpServer.h"
 # include "Network/BoostTcpSocket.h"
 # include "Network/ITcpServerDelegate.h"
@@ -24,6 +32,7 @@
 # include "StreamServer.hpp"
 # include "AutoDriving.hpp"
 # include "VoiceSpeaker.hpp"
+# include "WebSocket.hpp"
 
 namespace AL
 {
@@ -32,6 +41,7 @@ class ALBroker;
 
 class RemoteServer : public AL::ALModule,
         public BonjourDelegate,
+        public ControlServerDelegate,
         public Network::ITcpServerDelegate,
         public Network::ITcpSocketDelegate
 {
@@ -57,11 +67,16 @@ public:
                                  size_t bytesRead);
     virtual void    readFinished(Network::ASocket* sender,
                                  Network::ASocket::Error error,
-                                 std::string const& buffer);
+                                 Network::ASocket::Buffer const& line);
     virtual void    writeFinished(Network::ASocket* sender,
                                   Network::ASocket::Error error,
                                   size_t bytesWritten);
 
+    virtual void    controlCommand(CommandId command,
+                                   float const* values,
+                                   unsigned int present,
+                                   ControlCompletion const& completion);
+
     // Events
     void sensorEvent(const std::string& eventName,
                      const float& val,
@@ -69,6 +84,9 @@ public:
     void speechRecognized(const std::string& eventName,
                           const AL::ALValue& value,
                           const std::string& subscriberIdentifier);
+    void driveStateChanged(const std::string& eventName,
+                           const AL::ALValue& value,
+                           const std::string& subscriberIdentifier);
 
 private:
     void    _doubleClickEvent(const std::string& event, int now);
@@ -77,72 +95,221 @@ private:
 
     bool    _initDriveProxy();
 
-    void	_writeHttpResponse(Network::ATcpSocket* target,
-                               boost::asio::const_buffer const& buffer,
-                               std::string const& code = "200 OK", const std::string& contentType = "text/plain");
-    void	_parseReceivedData(Network::ATcpSocket* sender,
-                               std::string const& data);
-    void	_writeData(Network::ATcpSocket* target,
-                       std::stringstream *buffer);
-
-    void	defaultParams(Network::ATcpSocket* socket,
-                          std::map<std::string, std::string>& params);
-    void	getStreamPort(Network::ATcpSocket* socket,
-                          std::map<std::string, std::string>& params);
-    void	begin(Network::ATcpSocket* socket,
-                  std::map<std::string,std::string>& params);
-    void	end(Network::ATcpSocket* socket,
-                std::map<std::string,std::string>& params);
-    void	goFrontwards(Network::ATcpSocket* socket,
-                         std::map<std::string,std::string>& params);
-    void	goBackwards(Network::ATcpSocket* socket,
-                        std::map<std::string,std::string>& params);
-    void	turnLeft(Network::ATcpSocket* socket,
-                     std::map<std::string,std::string>& params);
-    void	turnRight(Network::ATcpSocket* socket,
-                      std::map<std::string,std::string>& params);
-    void	turnFront(Network::ATcpSocket* socket,
-                      std::map<std::string,std::string>& params);
-    void	stop(Network::ATcpSocket* socket,
-                 std::map<std::string,std::string>& params);
-    void	steeringWheelAction(Network::ATcpSocket* socket,
-                                std::map<std::string,std::string>& params);
-    void	funAction(Network::ATcpSocket* socket,
-                      std::map<std::string,std::string>& params);
-    void	carambarAction(Network::ATcpSocket* socket,
-                           std::map<std::string,std::string>& params);
-    void	setHead(Network::ATcpSocket* socket,
-                    std::map<std::string,std::string>& params);
-    void	talk(Network::ATcpSocket* socket,
-                 std::map<std::string, std::string>& params);
-    void	changeView(Network::ATcpSocket* socket,
-                       std::map<std::string, std::string>& params);
-    void	autoDriving(Network::ATcpSocket* socket,
-                        std::map<std::string,std::string>& params);
+    struct Response;
+
+    //! A connection on the HTTP server
+    struct Client {
+        Client() : server(NULL), socket(NULL), parser(), size(0), responses(),
+                   written(0), keepAlive(true), closing(false), reading(false),
+                   webSocket(false), streaming(false) {}
+
+        //! Server which accepted the socket, and takes it back
+        Network::ATcpServer*    server;
+        Network::ATcpSocket*    socket;
+        HttpParser              parser;
+        //! Received data not consumed by the parser yet
+        char                    buffer[8192];
+        size_t                  size;
+        //! Responses in request order, the first ones are queued on the
+        //! socket, the next ones may wait for their command to finish
+        std::deque<Response*>   responses;
+        //! Number of responses queued on the socket
+        size_t                  written;
+        //! Whether the connection persists after the current response
+        bool                    keepAlive;
+        //! No more requests are read, the socket is destroyed once the
+        //! pending writes are done
+        bool                    closing;
+        //! A read is pending: the socket is released once it has failed
+        bool                    reading;
+        //! Upgraded to a WebSocket: the buffer holds frames, not requests
+        bool                    webSocket;
+        //! Requested the MJPEG stream: the socket goes to the stream server
+        //! once the previous responses are written
+        bool                    streaming;
+    };
+
+    //! An HTTP response being sent
+    /*!
+     The header is formatted in place and sent along with the body segments
+     in a single gathered write. Body segments are referenced, not copied:
+     they point either to static or cached data, or to the owned body.
+     The response of a command is reserved when the request is read and
+     filled once the command is done, so that responses keep the order of
+     the requests. Responses are recycled once written.
+     */
+    struct Response {
+        Client*                     client;
+        //! Connection header, as requested when the response was created
+        bool                        keepAlive;
+        //! Whether the response has its place in the client responses
+        bool                        reserved;
+        char                        header[1024];
+        //! Storage for a body built by a command
+        std::string                 body;
+        Network::ASocket::Buffer    buffers[Network::ASocket::maxWriteBuffers];
+        size_t                      count;
+    };
+
+    Client*	_getClient(Network::ASocket* socket);
+    void	_closeClient(Client* client);
+    void	_destroyClient(Client* client);
+    void	_parseRequests(Client* client);
+    void	_handleRequest(Client* client, HttpRequest const& request);
+    void	_writeHttpResponse(Client* target,
+                               boost::asio::const_buffer const& body,
+                               const char* code = "200 OK", const char* contentType = "text/plain",
+                               const char* extraHeaders = "");
+    //! Sends body, whose content is taken over by the response
+    void	_writeHttpResponse(Client* target, std::string& body,
+                               const char* code = "200 OK", const char* contentType = "text/plain",
+                               const char* extraHeaders = "");
+    Response*	_newResponse(Client* target);
+    //! Takes the place of the next response, which is sent once queued
+    Response*	_reserveResponse(Client* target);
+    //! Queues the header and buffers of the response on the socket
+    /*!
+     A response waits for the reserved responses before it to be queued.
+     */
+    void	_queueResponse(Response* response);
+    void	_flushResponses(Client* client);
+    //! Formats the header and queues the header and body segments
+    /*!
+     \param body At most maxWriteBuffers - 1 segments, which must stay
+     valid until the response is written
+     */
+    void	_sendResponse(Response* response,
+                          boost::asio::const_buffer const* body, size_t count,
+                          const char* code, const char* contentType,
+                          const char* extraHeaders);
+    void	_writeAsset(Client* target,
+                        AssetCache::Asset const& asset,
+                        HttpRequest const& request);
+
+    //! Stops reading requests, the client is handed over once idle
+    void	_requestStream(Client* client);
+    //! Gives the socket to the stream server, and forgets the client
+    void	_handOverStream(Client* client);
+
+    void	_upgradeWebSocket(Client* client, HttpRequest const& request);
+    void	_parseWebSocketFrames(Client* client);
+    //! Runs a command sent as "/path?query" and answers with a JSON result
+    void	_handleWebSocketMessage(Client* client,
+                                    const char* message, size_t size);
+    void	_writeWebSocketFrame(Client* target, WebSocket::Opcode opcode,
+                                 const char* data, size_t size);
+    void	_setWebSocketFrame(Response* response, WebSocket::Opcode opcode,
+                               const char* data, size_t size);
+    //! Called in the strand with the value of DRIVE_STATE_EVENT
+    void	_setDriveState(std::vector<int> const& state);
+    //! Called by the command handlers once auto driving starts or stops
+    /*!
+     The flag is handed to the strand: the state message never reads
+     _autoDriving, which is owned by the executor thread.
+     */
+    void	_notifyAutoDriving(bool started);
+    //! Called in the strand with the value given to _notifyAutoDriving()
+    void	_setAutoDrivingState(bool started);
+    //! Sends the state to the WebSocket clients if it changed
+    void	_pushState();
+    std::string	_getStateMessage() const;
+
+    bool	getStreamPort(CommandArgs const& args,
+                          std::string& response);
+    bool	getControlPort(CommandArgs const& args,
+                           std::string& response);
+    bool	begin(CommandArgs const& args,
+                  std::string& response);
+    bool	end(CommandArgs const& args,
+                std::string& response);
+    bool	goFrontwards(CommandArgs const& args,
+                         std::string& response);
+    bool	goBackwards(CommandArgs const& args,
+                        std::string& response);
+    bool	turnLeft(CommandArgs const& args,
+                     std::string& response);
+    bool	turnRight(CommandArgs const& args,
+                      std::string& response);
+    bool	turnFront(CommandArgs const& args,
+                      std::string& response);
+    bool	stop(CommandArgs const& args,
+                 std::string& response);
+    bool	steeringWheelAction(CommandArgs const& args,
+                                std::string& response);
+    bool	funAction(CommandArgs const& args,
+                      std::string& response);
+    bool	carambarAction(CommandArgs const& args,
+                           std::string& response);
+    bool	setHead(CommandArgs const& args,
+                    std::string& response);
+    bool	talk(CommandArgs const& args,
+                 std::string& response);
+    bool	changeView(CommandArgs const& args,
+                       std::string& response);
+    bool	autoDriving(CommandArgs const& args,
+                        std::string& response);
     void	_stopAutoDriving(void);
-    void	upShift(Network::ATcpSocket* socket,
-                    std::map<std::string,std::string>& params);
-    void	downShift(Network::ATcpSocket* socket,
-                      std::map<std::string,std::string>& params);
-    void	releasePedal(Network::ATcpSocket* socket,
-                         std::map<std::string,std::string>& params);
-    void	pushPedal(Network::ATcpSocket* socket,
-                      std::map<std::string,std::string>& params);
-
-    typedef void (RemoteServer::*GetFunction)
-    (Network::ATcpSocket* socket,
-     std::map<std::string, std::string>&);
+    bool	upShift(CommandArgs const& args,
+                    std::string& response);
+    bool	downShift(CommandArgs const& args,
+                      std::string& response);
+    bool	releasePedal(CommandArgs const& args,
+                         std::string& response);
+    bool	pushPedal(CommandArgs const& args,
+                      std::string& response);
+
+    //! Returns false if the command could not be executed
+    typedef bool (RemoteServer::*CommandFunction)
+    (CommandArgs const& args, std::string& response);
+
+    //! Route of a command: url path, handler and typed parameters
+    struct Command {
+        CommandId       id;
+        const char*     path;
+        CommandFunction function;
+        //! In milliseconds, 0 if the command runs on the network thread
+        unsigned int    timeout;
+        CommandParam    params[maxCommandParams];
+    };
+
+    static Command const*   _findCommand(const char* path, size_t size);
+    //! Runs the command on the executor, or right away if it is immediate
+    void            _dispatchCommand(Command const* command,
+                                     CommandArgs const& args,
+                                     CommandExecutor::Completion const& completion);
+    //! Fills the reserved HTTP response of a command
+    void            _commandFinished(Response* response, ControlStatus status,
+                                     std::string const& body);
+    //! Fills the reserved WebSocket result of a command
+    void            _webSocketCommandFinished(Response* response,
+                                              std::string const& command,
+                                              ControlStatus status,
+                                              std::string const& body);
+    //! Runs the handler of the command, catching its errors
+    ControlStatus   _executeCommand(Command const* command,
+                                    CommandArgs const& args,
+                                    std::string& response);
 
     boost::shared_ptr<AL::ALBroker> _broker;
     boost::asio::io_service*    _ioService;
+    //! Serializes the handlers of the HTTP and WebSocket clients
+    boost::asio::io_service::strand _strand;
     Bonjour                     _bonjour;
-    boost::thread*              _networkThread;
+    AssetCache                  _assets;
+    //! Threads running _ioService
+    std::vector<boost::thread*> _networkThreads;
     Network::BoostTcpServer*    _tcpServer;
-    std::list<Network::ATcpSocket*>             _clients;
-    static std::map<std::string, GetFunction>   _getFunctions;
-    std::list<std::pair<Network::ATcpSocket*, std::stringstream*> > _toWrite;
+    //! Serves the processes of the robot, on REMOTE_SERVER_LOCAL_SOCKET
+    Network::BoostLocalServer*  _localServer;
+    std::map<Network::ASocket*, Client*>        _clients;
+    static const Command                        _commands[CommandCount];
+    //! Written responses, kept to be reused
+    std::vector<Response*>                      _freeResponses;
+    CommandExecutor*                            _executor;
     StreamServer*   _streamServer;
     int             _streamPort;
+    ControlServer*  _controlServer;
+    int             _controlPort;
     bool            _isListening;
 
     DriveProxy      *_drive;
@@ -154,6 +321,12 @@ private:
     AL::ALSpeechRecognitionProxy*    _speechRecognition;
     AL::DCMProxy*                    _dcm;
 
+    //! Last value of DRIVE_STATE_EVENT and last state pushed to clients
+    std::vector<int>                _driveState;
+    std::string                     _pushedState;
+    //! Whether auto driving runs, as last published to the strand
+    bool                            _autoDrivingState;
+
     std::map<std::string, int>      _lastEventTime;
     std::map<std::string, bool>     _isEventOn;
 };
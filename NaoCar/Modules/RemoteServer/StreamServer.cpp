@@ -9,44 +9,134 @@
 //
 
 #include "StreamServer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 
+#include "Log.hpp"
+
+// Milliseconds a client may take to receive a frame before it is dropped
+#ifndef STREAM_SERVER_CLIENT_TIMEOUT
+# define STREAM_SERVER_CLIENT_TIMEOUT 5000
+#endif
+
+// Socket file of the local server, none when empty
+#ifndef STREAM_SERVER_LOCAL_SOCKET
+# define STREAM_SERVER_LOCAL_SOCKET "/tmp/nao-car-stream.sock"
+#endif
+
+// Moves each client along the quality ladder by what its link sustains,
+// every client receives the default rung otherwise
+#ifndef STREAM_SERVER_ADAPTIVE
+# define STREAM_SERVER_ADAPTIVE 1
+#endif
+
+// Separates the frames of the MJPEG stream
+#define STREAM_SERVER_MJPEG_BOUNDARY "naocarframe"
+
+// Set to "boost" to serve the stream with Boost even if io_uring is supported
+#define STREAM_SERVER_BACKEND_VARIABLE "NAOCAR_NETWORK_BACKEND"
+
 static GstFlowReturn appsink_new_preroll(GstAppSink *sink, gpointer user_data);
 static GstFlowReturn appsink_new_buffer(GstAppSink *sink, gpointer user_data);
 
+// A JPEG of the lightest rung is about a tenth of the size of the heaviest
+const StreamServer::Rung StreamServer::_ladder[StreamServer::rungCount] = {
+    { 160, 120, 50 },
+    { 320, 240, 75 },
+    { 640, 480, 85 }
+};
+
 StreamServer::StreamServer(boost::asio::io_service* service) :
     _ioService(service), _mainThread(NULL), _tcpServer(NULL),
-    _stop(false), _pipeline(NULL), _imageData(NULL), _imageChanged(false),
+    _localServer(NULL),
+#ifdef NETWORK_HAVE_URING
+    _uringService(NULL),
+#endif
+    _stop(false), _pipeline(NULL), _imageChanged(false),
     _currentCamera(Bottom)
 {
     gst_init(NULL, NULL);
+    for (unsigned int i = 0; i < streamCount; ++i) {
+        _sinks[i].server = this;
+        _sinks[i].stream = i;
+        _sinks[i].appsink = NULL;
+        _sinks[i].valve = NULL;
+    }
+    // Clients asking for H.264 get JPEG without it
+    GstElementFactory* x264 = gst_element_factory_find("x264enc");
+    _h264Available = x264 != NULL;
+    if (x264)
+        gst_object_unref(GST_OBJECT(x264));
+    _keyframeRequest = 0;
 }
 
 StreamServer::~StreamServer() {
-    stop();
+    close();
+    // The released sockets are recycled before their servers are destroyed
+    Network::BoostTcpServer::drain(_ioService);
     delete _tcpServer;
+    delete _localServer;
+#ifdef NETWORK_HAVE_URING
+    delete _uringService;
+#endif
 }
 
 int	StreamServer::run() {
     if (_mainThread == NULL) {
         if (_tcpServer == NULL) {
-            _tcpServer = new Network::BoostTcpServer(_ioService);
+            _tcpServer = _createTcpServer();
             _tcpServer->setDelegate(this);
             if (_tcpServer->listen(0, "") == false) {
-                std::cerr << "could not listen on this port" << std::endl;
+                LOG_ERROR("could not listen on this port");
                 return (0);
             }
         }
-        std::cout << "Stream: " << _tcpServer->getPort() << std::endl;
+        if (_localServer == NULL && STREAM_SERVER_LOCAL_SOCKET[0] != '\0') {
+            _localServer = new Network::BoostLocalServer(_ioService);
+            _localServer->setDelegate(this);
+            if (_localServer->listen(0, STREAM_SERVER_LOCAL_SOCKET) == false) {
+                LOG_ERROR("could not listen on " << STREAM_SERVER_LOCAL_SOCKET);
+                delete _localServer;
+                _localServer = NULL;
+            } else {
+                LOG_INFO("Stream Socket: " << STREAM_SERVER_LOCAL_SOCKET);
+            }
+        }
+        LOG_INFO("Stream: " << _tcpServer->getPort());
         _stop = false;
         _mainThread = new boost::thread(&StreamServer::mainThread, this);
     }
     return (_tcpServer->getPort());
 }
 
+Network::ATcpServer*	StreamServer::_createTcpServer() {
+#ifdef NETWORK_HAVE_URING
+    const char* backend = getenv(STREAM_SERVER_BACKEND_VARIABLE);
+
+    if ((backend == NULL || strcmp(backend, "boost") != 0)
+        && Network::UringService::isSupported()) {
+        _uringService = new Network::UringService();
+        if (_uringService->start()) {
+            LOG_INFO("Stream: io_uring backend");
+            return new Network::UringTcpServer(_uringService);
+        }
+        delete _uringService;
+        _uringService = NULL;
+    }
+#endif
+    return new Network::BoostTcpServer(_ioService);
+}
+
 void	StreamServer::stop() {
     if (_mainThread != NULL) {
-        _stop = true;
+        {
+            // Set under the lock, so the main thread cannot miss it
+            std::lock_guard<std::mutex> lock(_imageMutex);
+            _stop = true;
+        }
+        _imageCondition.notify_one();
         _mainThread->join();
         delete _mainThread;
         _mainThread = NULL;
@@ -54,30 +144,87 @@ void	StreamServer::stop() {
     _stop = false;
 }
 
+void	StreamServer::close() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(_clientsMutex);
+
+        for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+            it->second->server->release(it->second->socket);
+            delete it->second;
+        }
+        _clients.clear();
+    }
+#ifdef NETWORK_HAVE_URING
+    // Its sockets and server may only be destroyed once it is stopped
+    if (_uringService)
+        _uringService->stop();
+#endif
+    if (_tcpServer)
+        _tcpServer->close();
+    if (_localServer)
+        _localServer->close();
+}
+
 void	StreamServer::mainThread() {
     _startPipeline();
-    while (_stop == false) {
-        _clientsMutex.lock();
-        if (_imageChanged) {
-            _imageMutex.lock();
+    for (;;) {
+        Frame frames[streamCount + 1];
+        {
+            // Sleeps until an encoder delivers a frame: it is sent right
+            // away, and nothing runs while the camera is idle
+            std::unique_lock<std::mutex> lock(_imageMutex);
+            while (!_imageChanged && !_stop)
+                _imageCondition.wait(lock);
+            if (_stop)
+                break ;
             _imageChanged = false;
-            for (auto it = _clients.begin(); it != _clients.end(); ++it) {
-                char *data = new char[_imageSize];
-
-                memcpy(data, _imageData, _imageSize);
-                _writeData(*it, data, _imageSize);
+            for (unsigned int i = 0; i <= streamCount; ++i) {
+                if (_frames[i].changed) {
+                    frames[i] = _frames[i];
+                    _frames[i].changed = false;
+                }
             }
-            _imageMutex.unlock();
         }
-        _clientsMutex.unlock();
-        usleep(10000);
+        for (unsigned int i = 0; i <= streamCount; ++i)
+            if (frames[i].changed)
+                _dispatchFrame(i, frames[i]);
     }
+    // setCamera() may be rebuilding it meanwhile
+    std::lock_guard<std::mutex> lock(_clientsMutex);
     _stopPipeline();
 }
 
+void	StreamServer::_dispatchFrame(unsigned int stream, Frame const& frame) {
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    bool sent = false;
+
+    // The same frame goes to every client of the stream, it is freed once
+    // the last of them has received or skipped it
+    for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+        Client* client = it->second;
+
+        if (client->closing)
+            continue ;
+        if (stream != anyRung
+            && (client->codec == StreamCodecH264 ? stream != h264Stream
+                : stream != client->rung))
+            continue ;
+        if (_writeData(client, frame))
+            sent = true;
+    }
+    if (!sent)
+        return ;
+    _dispatchLatency.record(LatencyHistogram::now() - frame.time);
+    if (_dispatchLatency.getCount() >= latencyReportFrames) {
+        LOG_INFO("Stream dispatch latency " << _dispatchLatency.toString());
+        _dispatchLatency.reset();
+    }
+}
+
 void	StreamServer::_startPipeline() {
     _clientsMutex.lock();
-    if (_clients.size() > 0) {
+    if (_connectedClients() > 0) {
         std::stringstream	tmp;
 
         tmp << "v4l2src device=";
@@ -90,9 +237,32 @@ void	StreamServer::_startPipeline() {
         } else {
             tmp << "/dev/video1";
         }
-        tmp << " ! videoscale ! video/x-raw-yuv,width=320,height=240 "
-               "! ffmpegcolorspace ! jpegenc";
+        // Each branch drops the frames its encoder is not done with, so a
+        // slow stream never holds the others back. Streams without clients
+        // are closed by their valve, before any scaling or encoding.
+        tmp << " ! tee name=camera";
+        for (unsigned int i = 0; i < rungCount; ++i)
+            tmp << " camera. ! queue leaky=downstream max-size-buffers=1"
+                << " ! valve name=valve" << i << " drop=true"
+                << " ! videoscale ! video/x-raw-yuv,width=" << _ladder[i].width
+                << ",height=" << _ladder[i].height
+                << " ! ffmpegcolorspace ! jpegenc quality=" << _ladder[i].quality
+                << " ! appsink name=stream" << i;
+        // No lookahead nor B-frames: each frame leaves the encoder as soon
+        // as it is captured, in a single access unit
+        if (_h264Available)
+            tmp << " camera. ! queue leaky=downstream max-size-buffers=1"
+                << " ! valve name=valve" << h264Stream << " drop=true"
+                << " ! videoscale ! video/x-raw-yuv,width="
+                << _ladder[defaultRung].width
+                << ",height=" << _ladder[defaultRung].height
+                << " ! ffmpegcolorspace ! x264enc tune=zerolatency"
+                << " speed-preset=ultrafast byte-stream=true"
+                << " bitrate=" << h264Bitrate
+                << " key-int-max=" << h264KeyframeInterval
+                << " ! appsink name=stream" << h264Stream;
         _setPipeline(tmp.str());
+        _updateValves();
     }
     _clientsMutex.unlock();
 }
@@ -101,8 +271,15 @@ void	StreamServer::_stopPipeline() {
     if (_pipeline)
     {
         gst_element_set_state (_pipeline, GST_STATE_NULL);
+        for (unsigned int i = 0; i < streamCount; ++i) {
+            if (_sinks[i].appsink == NULL)
+                continue ;
+            gst_object_unref(GST_OBJECT(_sinks[i].appsink));
+            gst_object_unref(GST_OBJECT(_sinks[i].valve));
+            _sinks[i].appsink = NULL;
+            _sinks[i].valve = NULL;
+        }
         gst_object_unref(GST_OBJECT(_pipeline));
-        gst_object_unref(GST_OBJECT(_gstAppsink));
         _pipeline = NULL;
     }
 }
@@ -112,23 +289,32 @@ void	StreamServer::_setPipeline(std::string const& pipeline)
     GError* error = NULL;
 
     _stopPipeline();
-    _pipeline = gst_parse_launch((pipeline + " ! appsink").c_str(), &error);
+    _pipeline = gst_parse_launch(pipeline.c_str(), &error);
     if (!_pipeline || error)
     {
-        std::cerr << "Cannnot create pipeline" << std::endl;
+        LOG_ERROR("Cannnot create pipeline");
         _pipeline = 0;
     }
     else
     {
-        static int idx = 0;
-        std::stringstream tmp;
-        tmp << "appsink" << idx++;
         GstAppSinkCallbacks gstCallbacks = {
             NULL, appsink_new_preroll, appsink_new_buffer, NULL, { NULL }};
-        _gstAppsink = gst_bin_get_by_name(GST_BIN(_pipeline),
-                                          tmp.str().c_str());
-        gst_app_sink_set_callbacks(GST_APP_SINK(_gstAppsink), &gstCallbacks,
-                                   this, NULL);
+        for (unsigned int i = 0; i < streamCount; ++i) {
+            std::stringstream name;
+
+            if (i == h264Stream && !_h264Available)
+                continue ;
+            name << "stream" << i;
+            _sinks[i].appsink = gst_bin_get_by_name(GST_BIN(_pipeline),
+                                                    name.str().c_str());
+            name.str("");
+            name << "valve" << i;
+            _sinks[i].valve = gst_bin_get_by_name(GST_BIN(_pipeline),
+                                                  name.str().c_str());
+            // Each sink knows its stream
+            gst_app_sink_set_callbacks(GST_APP_SINK(_sinks[i].appsink),
+                                       &gstCallbacks, &_sinks[i], NULL);
+        }
         gst_element_set_state(_pipeline, GST_STATE_PLAYING);
     }
 }
@@ -142,19 +328,66 @@ void	StreamServer::setCamera(Camera type) {
 
 void	StreamServer::newConnection(Network::ATcpServer* sender,
                                     Network::ATcpSocket* socket) {
-    if (_tcpServer != sender)
+    if (sender != _tcpServer && sender != _localServer)
         return ;
+    Client* client = new Client();
+    client->server = sender;
+    client->socket = socket;
+    _addClient(client);
+}
+
+void	StreamServer::addMjpegClient(Network::ATcpServer* server,
+                                     Network::ATcpSocket* socket) {
+    Network::BoostTcpSocket* boostSocket =
+            dynamic_cast<Network::BoostTcpSocket*>(socket);
+    Client* client = new Client();
+
+    // Served in parallel like the accepted clients, rather than in the
+    // strand of the HTTP server
+    if (boostSocket != NULL)
+        boostSocket->setStrand(NULL);
+    client->server = server;
+    client->socket = socket;
+    client->mjpeg = true;
+    _addClient(client);
+}
+
+void	StreamServer::_addClient(Client* client) {
+    static const char mjpegHeader[] =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: multipart/x-mixed-replace; boundary="
+            STREAM_SERVER_MJPEG_BOUNDARY "\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n"
+            "\r\n";
+    Network::ATcpSocket* socket = client->socket;
+    bool mjpeg = client->mjpeg;
+
     socket->setDelegate(this);
+    // A vanished viewer stops reading: its socket is closed once a frame
+    // has been stuck for too long, and it is released like a disconnection
+    socket->setTimeout(Network::ATcpSocket::WriteTimeout,
+                       STREAM_SERVER_CLIENT_TIMEOUT);
+    // Frames the link cannot carry wait in the queue of the socket rather
+    // than in the kernel, where they would add to the latency
+    socket->setSendBufferSize(sendBufferSize);
+    socket->setNotSentLowWatermark(notSentLowWatermark);
     _clientsMutex.lock();
-    _clients.push_back(socket);
-    if (_clients.size() == 1) {
-        _clientsMutex.unlock();
-        _startPipeline();
-    } else {
-        _clientsMutex.unlock();
+    _clients[socket] = client;
+    // Written before any frame, which waits in the next slot meanwhile
+    if (mjpeg) {
+        client->writing = true;
+        socket->write(mjpegHeader, sizeof(mjpegHeader) - 1);
     }
+    size_t count = _connectedClients();
+    _updateValves();
+    _clientsMutex.unlock();
+    if (count == 1)
+        _startPipeline();
     socket->readUntil("\n");
-    std::cout << "Stream Connection " << _clients.size() << std::endl;
+    // The client may already be gone
+    LOG_INFO((mjpeg ? "Stream MJPEG Connection " : "Stream Connection ")
+             << count);
 }
 
 void	StreamServer::connected(Network::ASocket*,
@@ -168,71 +401,289 @@ void	StreamServer::readFinished(Network::ASocket*,
 
 void	StreamServer::readFinished(Network::ASocket* sender,
                                    Network::ASocket::Error error,
-                                   std::string const&) {
-    Network::ATcpSocket	*socket = dynamic_cast<Network::ATcpSocket*>(sender);
+                                   Network::ASocket::Buffer const& line) {
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    auto it = _clients.find(sender);
 
-    if (socket == NULL)
+    if (it == _clients.end())
         return ;
+    Client* client = it->second;
     if (error) {
-        _clientsMutex.lock();
-        _clients.remove(socket);
-        if (_clients.size() == 0)
+        client->closing = true;
+        client->next = Frame();
+        size_t count = _connectedClients();
+        if (count == 0)
             _stopPipeline();
-        _clientsMutex.unlock();
-        delete socket;
-        std::cout << "Stream Deconnection " << _clients.size() << std::endl;
+        else
+            _updateValves();
+        LOG_INFO("Stream Deconnection " << count << ", "
+                 << client->framesSent << " frames sent, "
+                 << client->framesSkipped << " skipped");
+        // A frame still being written is released by writeFinished()
+        if (!client->writing)
+            _destroyClient(client);
     } else {
-        socket->readUntil("\n");
+        const char* data = static_cast<const char*>(line.data);
+        size_t size = line.size;
+
+        // Other lines are ignored, as by the servers before the protocol
+        while (size > 0 && (data[size - 1] == '\n' || data[size - 1] == '\r'))
+            --size;
+        if (size > 6 && memcmp(data, "codec ", 6) == 0)
+            _setCodec(client, std::string(data + 6, size - 6));
+        client->socket->readUntil("\n");
     }
 }
 
-void	StreamServer::writeFinished(Network::ASocket*,
-                                    Network::ASocket::Error,
-                                    size_t) {
-    _imageMutex.lock();
-    delete[] _toWrite.front().second->data;
-    delete _toWrite.front().second;
-    _toWrite.pop_front();
-    if (_toWrite.size() >= 1)
-        _toWrite.front().first->write(_toWrite.front().second->data,
-                                      _toWrite.front().second->size);
-    _imageMutex.unlock();
+void	StreamServer::_setCodec(Client* client, std::string const& name) {
+    if (client->mjpeg)
+        return ;
+    client->tagged = true;
+    client->codec = StreamCodecJpeg;
+    if (name == streamCodecName(StreamCodecH264) && _h264Available) {
+        client->codec = StreamCodecH264;
+        // Delta frames are useless until the first keyframe
+        client->needKeyframe = true;
+        client->next = Frame();
+        // A new viewer never waits for the end of the group of pictures
+        _keyframeRequest = 0;
+        _requestKeyframe();
+    }
+    _updateValves();
+    LOG_INFO("Stream codec " << streamCodecName(client->codec)
+             << " (asked " << name << ")");
 }
 
-void	StreamServer::_writeData(Network::ATcpSocket* target,
-                                 char* data, size_t size) {
-    Packet	*packet = new Packet;
-    packet->data = data;
-    packet->size = size;
-    _toWrite.push_back(std::pair<Network::ATcpSocket*, Packet*>(target, packet));
-    if (_toWrite.size() == 1)
-        target->write(data, size);
+void	StreamServer::_requestKeyframe() {
+    GstElement* appsink = _sinks[h264Stream].appsink;
+    uint64_t now = LatencyHistogram::now();
+
+    if (appsink == NULL || now - _keyframeRequest < keyframeRequestInterval)
+        return ;
+    _keyframeRequest = now;
+    // Travels upstream from the sink to the encoder, which makes the next
+    // frame a keyframe, with its parameter sets
+    GstStructure* request = gst_structure_new("GstForceKeyUnit",
+                                              "all-headers", G_TYPE_BOOLEAN,
+                                              TRUE, NULL);
+    gst_element_send_event(appsink,
+                           gst_event_new_custom(GST_EVENT_CUSTOM_UPSTREAM,
+                                                request));
 }
 
-void	StreamServer::setImageData(char *data, size_t size) {
-    _imageMutex.lock();
-    delete _imageData;
-    _imageChanged = true;
-    _imageData = new char[size + 8];
-    uint64_t size64 = size;
-    memcpy(_imageData, &size64, 8);
-    memcpy(_imageData + 8, data, size64);
-    _imageSize = size64 + 8;
-    _imageMutex.unlock();
+void	StreamServer::writeFinished(Network::ASocket* sender,
+                                    Network::ASocket::Error error,
+                                    size_t bytesWritten) {
+    std::lock_guard<std::mutex> lock(_clientsMutex);
+    auto it = _clients.find(sender);
+
+    if (it == _clients.end() || !it->second->writing)
+        return ;
+    Client* client = it->second;
+    // The multipart header of an MJPEG client is not a frame
+    bool frame = !client->mjpeg || !client->sending.empty();
+    client->writing = false;
+    client->sending = Network::SharedBuffer();
+    if (client->closing) {
+        _destroyClient(client);
+        return ;
+    }
+    if (error)
+        return ;
+    if (frame) {
+        uint64_t now = LatencyHistogram::now();
+
+        ++client->framesSent;
+        client->windowBusy += now - client->writeStart;
+        client->windowBytes += bytesWritten;
+        ++client->windowFrames;
+        if (now - client->windowStart >= adaptWindow)
+            _adaptClient(client, now);
+    }
+    // The freshest frame received during the write, if any
+    if (!client->next.image.empty()) {
+        Frame frame = client->next;
+        client->next = Frame();
+        _writeData(client, frame);
+    }
 }
 
-void	StreamServer::setOpencvData(char *data, size_t size) {
-    if (_currentCamera == Opencv) {
-        _imageMutex.lock();
-        delete _imageData;
-        _imageChanged = true;
-        _imageData = new char[size + 8];
-        uint64_t size64 = size;
-        memcpy(_imageData, &size64, 8);
-        memcpy(_imageData + 8, data, size64);
-        _imageSize = size64 + 8;
-        _imageMutex.unlock();
+bool	StreamServer::_writeData(Client* target, Frame const& frame) {
+    bool h264 = frame.codec == StreamCodecH264;
+
+    if (h264 && target->needKeyframe) {
+        if (!frame.keyframe) {
+            ++target->framesSkipped;
+            return false;
+        }
+        target->needKeyframe = false;
     }
+    if (target->writing) {
+        // Never sent: the viewer gets the newest frame rather than a backlog
+        if (!target->next.image.empty()) {
+            ++target->framesSkipped;
+            ++target->windowSkipped;
+            // The frames after a skipped H.264 frame do not decode
+            if (h264 && !frame.keyframe) {
+                target->next = Frame();
+                target->needKeyframe = true;
+                _requestKeyframe();
+                return false;
+            }
+        }
+        target->next = frame;
+        return false;
+    }
+    // Each socket writes on its own: a slow client only delays itself.
+    // The write is started in the strand of the socket, by an io_service
+    // thread, so the clients are served in parallel.
+    target->writing = true;
+    target->writeStart = LatencyHistogram::now();
+    if (!target->mjpeg && !target->tagged) {
+        target->socket->write(frame.image);
+        return true;
+    }
+    // The payload is written from the shared frame, past its size prefix,
+    // after a header of the client: it costs no copy and no encoding
+    size_t size = frame.image.size() - 8;
+    const char* payload = static_cast<const char*>(frame.image.data()) + 8;
+    target->sending = frame.image;
+    if (target->tagged) {
+        StreamHeader header;
+
+        header.codec = frame.codec;
+        header.flags = frame.keyframe ? streamKeyframe : 0;
+        header.size = size;
+        encodeStreamHeader(header, target->partHeader);
+        Network::ASocket::Buffer buffers[2] = {
+            { target->partHeader, (uint32_t)streamHeaderSize },
+            { payload, (uint32_t)size }
+        };
+        target->socket->write(buffers, 2);
+        return true;
+    }
+    int headerSize = snprintf(target->partHeader, sizeof(target->partHeader),
+                              "--" STREAM_SERVER_MJPEG_BOUNDARY "\r\n"
+                              "Content-Type: image/jpeg\r\n"
+                              "Content-Length: %lu\r\n"
+                              "\r\n",
+                              (unsigned long)size);
+    Network::ASocket::Buffer buffers[3] = {
+        { target->partHeader, (uint32_t)headerSize },
+        { payload, (uint32_t)size },
+        { "\r\n", 2 }
+    };
+    target->socket->write(buffers, 3);
+    return true;
+}
+
+void	StreamServer::_adaptClient(Client* client, uint64_t now) {
+    uint64_t elapsed = now - client->windowStart;
+    unsigned int rung = client->rung;
+
+    // The link carries the rung while the frames take a small share of the
+    // window to write: skipped frames, a busy link or writes waiting in the
+    // kernel are the signs of a rung too heavy for it
+    // H.264 clients receive a single stream, at a fixed bitrate
+    if (STREAM_SERVER_ADAPTIVE && client->windowStart != 0
+        && client->codec == StreamCodecJpeg) {
+        uint64_t load = client->windowBusy * 100 / elapsed;
+        uint64_t writeTime = client->windowBusy / client->windowFrames;
+
+        if (rung > 0 && (client->windowSkipped * 4 > client->windowFrames
+                         || load > downLoadPercent
+                         || writeTime > downWriteTime)) {
+            --rung;
+            client->upHold = upHoldWindows;
+        } else if (client->upHold > 0) {
+            --client->upHold;
+        } else if (rung + 1 < rungCount && client->windowSkipped == 0
+                   && client->windowFrames >= adaptMinFrames
+                   && load < upLoadPercent) {
+            ++rung;
+        }
+        if (rung != client->rung) {
+            LOG_DEBUG("Stream client to " << _ladder[rung].width << "x"
+                      << _ladder[rung].height << " q" << _ladder[rung].quality
+                      << ", " << client->windowBytes * 1000000 / elapsed
+                      << " B/s, " << load << "% busy, "
+                      << client->windowSkipped << " skipped");
+            client->rung = rung;
+            _updateValves();
+        }
+    }
+    client->windowStart = now;
+    client->windowBusy = 0;
+    client->windowBytes = 0;
+    client->windowFrames = 0;
+    client->windowSkipped = 0;
+}
+
+void	StreamServer::_updateValves() {
+    bool used[streamCount] = {};
+
+    if (_pipeline == NULL)
+        return ;
+    for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+        if (it->second->closing)
+            continue ;
+        if (it->second->codec == StreamCodecH264)
+            used[h264Stream] = true;
+        else
+            used[it->second->rung] = true;
+    }
+    for (unsigned int i = 0; i < streamCount; ++i)
+        if (_sinks[i].valve != NULL)
+            g_object_set(G_OBJECT(_sinks[i].valve), "drop", !used[i], NULL);
+}
+
+void	StreamServer::_destroyClient(Client* client) {
+    _clients.erase(client->socket);
+    // Closed, and kept for the next connection
+    client->server->release(client->socket);
+    delete client;
+}
+
+size_t	StreamServer::_connectedClients() const {
+    size_t count = 0;
+
+    for (auto it = _clients.begin(); it != _clients.end(); ++it)
+        if (!it->second->closing)
+            ++count;
+    return count;
+}
+
+void	StreamServer::setImageData(unsigned int stream, char *data, size_t size,
+                                   bool keyframe) {
+    _setImage(stream, data, size, keyframe);
+}
+
+void	StreamServer::setOpencvData(char *data, size_t size) {
+    if (_currentCamera == Opencv)
+        _setImage(anyRung, data, size, true);
+}
+
+void	StreamServer::_setImage(unsigned int stream, char *data, size_t size,
+                                bool keyframe) {
+    uint64_t time = LatencyHistogram::now();
+    // Filled before it is shared, the previous frame is freed once its
+    // writes are done
+    Network::SharedBuffer image(size + 8);
+    uint64_t size64 = size;
+    char* frame = static_cast<char*>(image.mutableData());
+
+    memcpy(frame, &size64, 8);
+    memcpy(frame + 8, data, size);
+    _imageMutex.lock();
+    _frames[stream].image = image;
+    _frames[stream].time = time;
+    _frames[stream].changed = true;
+    _frames[stream].codec = stream == h264Stream ? StreamCodecH264
+                                                 : StreamCodecJpeg;
+    _frames[stream].keyframe = keyframe;
+    _imageChanged = true;
+    _imageMutex.unlock();
+    _imageCondition.notify_one();
 }
 
 static GstFlowReturn appsink_new_preroll(GstAppSink *sink, gpointer user_data)
@@ -244,11 +695,13 @@ static GstFlowReturn appsink_new_preroll(GstAppSink *sink, gpointer user_data)
 
 static GstFlowReturn appsink_new_buffer(GstAppSink *sink, gpointer user_data)
 {
-    (void)user_data;
+    StreamServer::Sink* stream = (StreamServer::Sink*)user_data;
     GstBuffer *buffer = gst_app_sink_pull_buffer(sink);
     unsigned char* data = GST_BUFFER_MALLOCDATA(buffer);
-    ((StreamServer*)user_data)->setImageData((char*)data,
-                                             GST_BUFFER_SIZE(buffer));
+    stream->server->setImageData(stream->stream, (char*)data,
+                                 GST_BUFFER_SIZE(buffer),
+                                 !GST_BUFFER_FLAG_IS_SET(buffer,
+                                                         GST_BUFFER_FLAG_DELTA_UNIT));
     gst_buffer_unref(buffer);
     return GST_FLOW_OK;
 }
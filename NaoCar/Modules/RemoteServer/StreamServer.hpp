@@ -15,15 +15,24 @@
 # include <boost/asio.hpp>
 # include <boost/thread/thread.hpp>
 # include <atomic>
+# include <condition_variable>
+# include <map>
 # include <mutex>
 # include <gst/gst.h>
 # include <glib.h>
 # include <gst/app/gstappsink.h>
 
+# include "LatencyHistogram.hpp"
+// Shared with the clients, from Apps/Remote/Sources
+# include "StreamProtocol.hpp"
+# include "Network/BoostLocalServer.h"
 # include "Network/BoostTcpServer.h"
 # include "Network/BoostTcpSocket.h"
 # include "Network/ITcpServerDelegate.h"
 # include "Network/ITcpSocketDelegate.h"
+# ifdef NETWORK_HAVE_URING
+#  include "Network/UringTcpServer.h"
+# endif
 
 namespace AL
 {
@@ -40,11 +49,28 @@ public:
         Opencv
     };
 
+    //! The appsink of a stream, and the valve which stops its encoding
+    /*!
+     The callbacks of the appsink get it as user data.
+     */
+    struct Sink {
+        StreamServer*	server;
+        unsigned int	stream;
+        GstElement*	appsink;
+        GstElement*	valve;
+    };
+
     StreamServer(boost::asio::io_service* ioService);
     virtual ~StreamServer();
 
     int	run();
     void	stop();
+    //! Stops streaming and accepting, and releases the clients
+    /*!
+     Called once the io_service is stopped, whose handlers are run before
+     the server is destroyed.
+     */
+    void	close();
 
     virtual void	newConnection(Network::ATcpServer* sender,
                                   Network::ATcpSocket* socket);
@@ -55,41 +81,210 @@ public:
                                  size_t bytesRead);
     virtual void	readFinished(Network::ASocket* sender,
                                  Network::ASocket::Error error,
-                                 std::string const& buffer);
+                                 Network::ASocket::Buffer const& line);
     virtual void	writeFinished(Network::ASocket* sender,
                                   Network::ASocket::Error error,
                                   size_t bytesWritten);
-    void	setImageData(char *data, size_t size);
+    //! Streams the frames as MJPEG to a socket which requested it over HTTP
+    /*!
+     The request has been read by another server, whose writes on the
+     socket are finished: the multipart response starts right away, and
+     the socket is released to server when the viewer disconnects. The
+     socket leaves the strand of the other server for its own.
+     */
+    void	addMjpegClient(Network::ATcpServer* server,
+                           Network::ATcpSocket* socket);
+    //! Sets the frame of an encoded stream, a rung of the ladder or H.264
+    void	setImageData(unsigned int stream, char *data, size_t size,
+                         bool keyframe);
     void	setOpencvData(char *data, size_t size);
     void	setCamera(Camera type);
 
 private:
-    struct Packet {
-        char	*data;
-        size_t	size;
+    //! Kernel send buffer of a client, in bytes
+    static const int sendBufferSize = 64 * 1024;
+    //! Unsent bytes the kernel may hold for a client, about a frame
+    static const int notSentLowWatermark = 16 * 1024;
+    //! Frames between two logs of the dispatch latency, about 10 seconds
+    static const uint64_t latencyReportFrames = 300;
+
+    //! An encoding of the camera
+    struct Rung {
+        int	width;
+        int	height;
+        //! JPEG quality, from 0 to 100
+        int	quality;
+    };
+    //! Encodings a client may receive, from the lightest
+    /*!
+     Each rung is encoded once, from a tee of the camera, and only while
+     some client receives it.
+     */
+    static const unsigned int rungCount = 3;
+    static const Rung _ladder[rungCount];
+    //! Rung of new clients, and of every client without adaptation
+    static const unsigned int defaultRung = 1;
+    //! The H.264 stream, encoded like the default rung
+    static const unsigned int h264Stream = rungCount;
+    //! Streams encoded by the pipeline
+    static const unsigned int streamCount = rungCount + 1;
+    //! Frames set by OpenCV, the same for every client
+    static const unsigned int anyRung = streamCount;
+
+    //! H.264 bitrate, in kbit/s
+    static const int h264Bitrate = 384;
+    //! Frames between two H.264 keyframes at most
+    static const int h264KeyframeInterval = 30;
+    //! Microseconds between two keyframes requested by clients at least
+    static const uint64_t keyframeRequestInterval = 200000;
+
+    //! Microseconds over which the link of a client is measured
+    static const uint64_t adaptWindow = 1000000;
+    //! Frames a window needs before a client may go up
+    static const uint64_t adaptMinFrames = 5;
+    //! Share of a window spent writing, in percent, below which a client
+    //! goes up, and above which it goes down
+    static const uint64_t upLoadPercent = 20;
+    static const uint64_t downLoadPercent = 80;
+    //! Average write time, in microseconds, above which a client goes down
+    static const uint64_t downWriteTime = 200000;
+    //! Windows a client stays on its rung after going down
+    static const unsigned int upHoldWindows = 5;
+
+    //! A frame of an encoded stream
+    struct Frame {
+        Frame() : image(), time(0), changed(false), codec(StreamCodecJpeg),
+                  keyframe(true) {}
+
+        //! Size prefixed, written as is to the clients of legacy framing
+        Network::SharedBuffer	image;
+        //! When it left the encoder, see LatencyHistogram::now()
+        uint64_t		time;
+        //! Not dispatched yet
+        bool			changed;
+        StreamCodec		codec;
+        //! Decodes on its own, every JPEG does
+        bool			keyframe;
+    };
+
+    //! A stream connection, its frame being written and the next one
+    /*!
+     A client holds at most two frames: the one being written, and the
+     latest one received meanwhile, which replaces any older one. A slow
+     link skips frames instead of falling behind, and a JPEG client is
+     moved along the ladder by what it sustained over the last window. An
+     H.264 client which skips a frame waits for the next keyframe instead.
+     */
+    struct Client {
+        Client() : server(NULL), socket(NULL), mjpeg(false), tagged(false),
+                   codec(StreamCodecJpeg), needKeyframe(false), writing(false),
+                   sending(), next(), closing(false), framesSent(0),
+                   framesSkipped(0), rung(defaultRung), writeStart(0),
+                   windowStart(0), windowBusy(0), windowBytes(0),
+                   windowFrames(0), windowSkipped(0), upHold(0) {}
+
+        //! Server which accepted the socket, and takes it back
+        Network::ATcpServer*	server;
+        Network::ATcpSocket*	socket;
+        //! Receives the frames as HTTP multipart parts, not size prefixed
+        bool			mjpeg;
+        //! Asked for a codec: its frames start with a StreamHeader
+        bool			tagged;
+        //! Codec of the frames of the camera it receives
+        StreamCodec		codec;
+        //! Its H.264 stream is broken, delta frames are not sent
+        bool			needKeyframe;
+        //! A frame, or the multipart response header, is being written
+        bool			writing;
+        //! Frame whose payload an MJPEG or tagged write points to
+        Network::SharedBuffer	sending;
+        //! Header of the frame being written, for MJPEG and tagged clients
+        char			partHeader[96];
+        //! Frame written once the current one is, empty if none
+        Frame			next;
+        //! Disconnected, destroyed once its frame is written
+        bool			closing;
+        uint64_t		framesSent;
+        //! Frames replaced by a newer one before they could be written
+        uint64_t		framesSkipped;
+        //! Rung of the frames it receives
+        unsigned int		rung;
+        //! When the current write started, see LatencyHistogram::now()
+        uint64_t		writeStart;
+        //! Since windowStart: time spent writing frames, and their bytes,
+        //! frames written and frames skipped
+        uint64_t		windowStart;
+        uint64_t		windowBusy;
+        uint64_t		windowBytes;
+        uint64_t		windowFrames;
+        uint64_t		windowSkipped;
+        //! Windows left before it may go up
+        unsigned int		upHold;
     };
 
-    void	_writeData(Network::ATcpSocket* target,
-                       char* data, size_t size);
+    //! Registers the client, and starts the pipeline for the first one
+    void	_addClient(Client* client);
+    //! Writes the frame, or keeps it as the next one if a write is running
+    /*!
+     \return true if the write of the frame is started, false if the frame
+     waits or is skipped
+     */
+    bool	_writeData(Client* target, Frame const& frame);
+    //! Writes the frame to the clients of the stream
+    void	_dispatchFrame(unsigned int stream, Frame const& frame);
+    //! Handles a "codec" line of the stream protocol
+    void	_setCodec(Client* client, std::string const& name);
+    //! Asks the H.264 encoder for a keyframe, at most once per interval
+    void	_requestKeyframe();
+    //! Moves the client along the ladder once its window is over
+    void	_adaptClient(Client* client, uint64_t now);
+    //! Encodes the streams which have clients, and only them
+    void	_updateValves();
+    //! Replaces the frame of the stream, prefixed with its size
+    void	_setImage(unsigned int stream, char* data, size_t size,
+                      bool keyframe);
+    //! The io_uring server when it is built and supported, Boost otherwise
+    Network::ATcpServer*	_createTcpServer();
+    void	_destroyClient(Client* client);
+    size_t	_connectedClients() const;
     void	_setPipeline(std::string const& pipeline);
     void	_startPipeline();
+    //! Called with _clientsMutex locked
     void	_stopPipeline();
     void	mainThread();
 
     boost::asio::io_service	*_ioService;
     boost::thread			*_mainThread;
-    Network::BoostTcpServer	*_tcpServer;
-    std::list<Network::ATcpSocket*>	_clients;
+    Network::ATcpServer		*_tcpServer;
+    //! Serves the processes of the robot, on STREAM_SERVER_LOCAL_SOCKET
+    Network::BoostLocalServer	*_localServer;
+#ifdef NETWORK_HAVE_URING
+    //! Runs the io_uring server and its sockets, NULL with Boost
+    Network::UringService	*_uringService;
+#endif
+    std::map<Network::ASocket*, Client*>	_clients;
     std::mutex				_clientsMutex;
-    std::list<std::pair<Network::ATcpSocket*, Packet*> > _toWrite;
     std::atomic<bool>		_stop;
+    //! Rebuilt by setCamera() from any thread, protected by _clientsMutex
     GstElement			*_pipeline;
-    char				*_imageData;
-    uint64_t			_imageSize;
+    //! Latest frame of each stream, then of OpenCV
+    Frame			_frames[streamCount + 1];
+    //! Some frame is not dispatched yet
     std::atomic<bool>		_imageChanged;
+    //! Protects the frames
     std::mutex			_imageMutex;
+    //! Wakes the main thread when a frame is set, or on stop()
+    std::condition_variable	_imageCondition;
+    //! From the encoder to the writes, only used by the main thread
+    LatencyHistogram		_dispatchLatency;
     std::atomic<char>		_currentCamera;
-    GstElement			*_gstAppsink;
+    //! Elements of each stream, while the pipeline runs, protected by
+    //! _clientsMutex
+    Sink			_sinks[streamCount];
+    //! Whether GStreamer has an H.264 encoder, x264enc
+    bool			_h264Available;
+    //! When the last keyframe was requested, protected by _clientsMutex
+    uint64_t			_keyframeRequest;
 };
 
 #endif
@@ -0,0 +1,167 @@
+//
+// WebSocket.cpp
+// NaoCar Remote Server
+//
+
+#include "WebSocket.hpp"
+
+static void     sha1(const unsigned char* data, size_t size, unsigned char digest[20]);
+static std::string  base64(const unsigned char* data, size_t size);
+
+std::string	WebSocket::acceptKey(std::string const& key) {
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    std::string concatenated = key + guid;
+    unsigned char digest[20];
+
+    sha1((const unsigned char*)concatenated.data(), concatenated.size(), digest);
+    return base64(digest, sizeof(digest));
+}
+
+WebSocket::Status	WebSocket::parseFrame(char* data, size_t size,
+                                              size_t maxPayloadSize,
+                                              Opcode& opcode, char*& payload,
+                                              size_t& payloadSize,
+                                              size_t& consumed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    if (size < 2)
+        return Incomplete;
+    bool final = (bytes[0] & 0x80) != 0;
+    // Reserved bits are only used by extensions, none is negotiated
+    if ((bytes[0] & 0x70) != 0 || !final || (bytes[1] & 0x80) == 0)
+        return Invalid;
+    opcode = (Opcode)(bytes[0] & 0x0F);
+
+    size_t offset = 2;
+    uint64_t length = bytes[1] & 0x7F;
+    if (length == 126) {
+        if (size < offset + 2)
+            return Incomplete;
+        length = (bytes[2] << 8) | bytes[3];
+        offset += 2;
+    } else if (length == 127) {
+        if (size < offset + 8)
+            return Incomplete;
+        length = 0;
+        for (int i = 0; i < 8; ++i)
+            length = (length << 8) | bytes[2 + i];
+        offset += 8;
+    }
+    if (length > maxPayloadSize)
+        return Invalid;
+    if (size < offset + 4 + length)
+        return Incomplete;
+
+    const unsigned char* mask = bytes + offset;
+    offset += 4;
+    payload = data + offset;
+    payloadSize = length;
+    for (size_t i = 0; i < payloadSize; ++i)
+        payload[i] ^= mask[i % 4];
+    consumed = offset + payloadSize;
+    return Complete;
+}
+
+size_t	WebSocket::writeFrameHeader(Opcode opcode, size_t payloadSize,
+                                    char* header) {
+    header[0] = (char)(0x80 | opcode);
+    if (payloadSize < 126) {
+        header[1] = (char)payloadSize;
+        return 2;
+    }
+    if (payloadSize <= 0xFFFF) {
+        header[1] = 126;
+        header[2] = (char)(payloadSize >> 8);
+        header[3] = (char)payloadSize;
+        return 4;
+    }
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+        header[2 + i] = (char)((uint64_t)payloadSize >> (8 * (7 - i)));
+    return 10;
+}
+
+static uint32_t rotate(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void     sha1(const unsigned char* data, size_t size, unsigned char digest[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    // Padded message: data, 0x80, zeros, 64-bit big-endian bit length
+    size_t total = ((size + 8) / 64 + 1) * 64;
+
+    for (size_t block = 0; block < total; block += 64) {
+        uint32_t w[80];
+
+        for (int i = 0; i < 16; ++i) {
+            w[i] = 0;
+            for (int byte = 0; byte < 4; ++byte) {
+                size_t index = block + i * 4 + byte;
+                unsigned char c;
+
+                if (index < size)
+                    c = data[index];
+                else if (index == size)
+                    c = 0x80;
+                else if (index >= total - 8)
+                    c = (unsigned char)((uint64_t)size * 8 >> (8 * (total - 1 - index)));
+                else
+                    c = 0;
+                w[i] = (w[i] << 8) | c;
+            }
+        }
+        for (int i = 16; i < 80; ++i)
+            w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotate(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotate(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; ++i)
+        digest[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static std::string  base64(const unsigned char* data, size_t size) {
+    static const char alphabet[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string result;
+
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t group = data[i] << 16;
+        if (i + 1 < size)
+            group |= data[i + 1] << 8;
+        if (i + 2 < size)
+            group |= data[i + 2];
+        result += alphabet[(group >> 18) & 0x3F];
+        result += alphabet[(group >> 12) & 0x3F];
+        result += i + 1 < size ? alphabet[(group >> 6) & 0x3F] : '=';
+        result += i + 2 < size ? alphabet[group & 0x3F] : '=';
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+//
+// WebSocket.hpp
+// NaoCar Remote Server
+//
+
+#ifndef __WEB_SOCKET_HPP__
+# define __WEB_SOCKET_HPP__
+
+# include <cstddef>
+# include <stdint.h>
+# include <string>
+
+//! Server side of the WebSocket protocol (RFC 6455)
+namespace WebSocket {
+
+    enum Opcode {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA
+    };
+
+    enum Status {
+        Incomplete,
+        Complete,
+        Invalid
+    };
+
+    //! Maximum size of the header of a frame
+    static const size_t maxHeaderSize = 14;
+
+    //! Returns the Sec-WebSocket-Accept value answering the given key
+    std::string acceptKey(std::string const& key);
+
+    //! Parses a client frame
+    /*!
+     Client frames must be masked: the payload is unmasked in place.
+     Fragmented messages are not supported.
+     \param consumed Set to the size of the whole frame when Complete
+     \param maxPayloadSize Larger frames are Invalid
+     */
+    Status  parseFrame(char* data, size_t size, size_t maxPayloadSize,
+                       Opcode& opcode, char*& payload, size_t& payloadSize,
+                       size_t& consumed);
+
+    //! Writes the header of an unmasked, final server frame
+    /*!
+     \param header At least maxHeaderSize bytes
+     \return The size of the header
+     */
+    size_t  writeFrameHeader(Opcode opcode, size_t payloadSize, char* header);
+
+}
+
+#endif
@@ -14,6 +14,15 @@
 # include <string>
 # include <alcommon/alproxy.h>
 
+//! ALMemory event raised by the Drive module when its state changes
+/*!
+ Its value is an array of ints: gas pedal pushed, steering wheel taken,
+ steering wheel direction, speed and animating.
+ */
+# ifndef DRIVE_STATE_EVENT
+#  define DRIVE_STATE_EVENT "NaoCarDriveState"
+# endif
+
 class DriveProxy : public AL::ALProxy
 {
 public:
@@ -21,8 +21,9 @@ Remote::Remote()
     : _mainWindow(this),
       _bonjour(this), _naoAvailable(false), _naoUrl(), _networkManager(),
       _connected(false), _streamSocket(new QTcpSocket(this)),
-      _streamImageSize(-1), _streamImage(new QImage()), _streamSizeRead(false),
-      _rift(NULL), _leapController(new Controller()), _leapListener(new LeapListener(this)) {
+      _streamDecoder(), _streamImage(new QImage()),
+      _rift(NULL), _leapController(new Controller()), _leapListener(new LeapListener(this)),
+      _controlSocket(new QTcpSocket(this)), _controlConnected(0), _controlSequence(0) {
     // Launch Bonjour to automatically detect Nao on a local network
     if (!_bonjour.browseServices("_http._tcp")) {
         std::cerr << "Cannot browse Bonjour services" << std::endl;
@@ -31,8 +32,17 @@ Remote::Remote()
     QObject::connect(&_networkManager, SIGNAL(finished(QNetworkReply*)),
                      this, SLOT(networkRequestFinished(QNetworkReply*)));
     _naoUrl.setScheme("http");
+    QObject::connect(_streamSocket, SIGNAL(connected()),
+                     this, SLOT(streamConnected()));
     QObject::connect(_streamSocket, SIGNAL(readyRead()),
                      this, SLOT(streamDataAvailable()));
+    QObject::connect(_controlSocket, SIGNAL(connected()),
+                     this, SLOT(controlConnected()));
+    QObject::connect(_controlSocket, SIGNAL(disconnected()),
+                     this, SLOT(controlDisconnected()));
+    QObject::connect(_controlSocket, SIGNAL(readyRead()),
+                     this, SLOT(controlDataAvailable()));
+    _controlClock.start();
     _streamImage->load(":/waiting-streaming.png");
     _mainWindow.setStreamImage(_streamImage);
 
@@ -92,6 +102,7 @@ void Remote::connect(void) {
     if (_naoAvailable) {
         sendRequest("/begin");
         sendRequest("/get-stream-port");
+        sendRequest("/get-control-port");
     } else {
         QMessageBox::critical(_mainWindow.getWindow(), "Connect error",
                               "No available NaoCar server found");
@@ -127,7 +138,7 @@ void Remote::viewChanged(int index) {
 }
 
 void Remote::carambarAction(void) {
-    if (_naoAvailable)
+    if (_naoAvailable && !sendCommand(CarambarActionCommand))
         sendRequest("/carambar-action");
 }
 
@@ -148,49 +159,55 @@ void Remote::safeMode(void) {
 }
 
 void Remote::steeringWheelAction(void) {
-    if (_naoAvailable)
+    if (_naoAvailable && !sendCommand(SteeringWheelActionCommand))
         sendRequest("/steeringwheel-action");
 }
 
 void Remote::funAction(void) {
-    if (_naoAvailable)
+    if (_naoAvailable && !sendCommand(FunActionCommand))
         sendRequest("/fun-action");
 }
 
 void Remote::frontward(void) {
     if (!_naoAvailable)
         return ;
-    sendRequest("/go-frontwards");
+    if (!sendCommand(GoFrontwardsCommand))
+        sendRequest("/go-frontwards");
 }
 
 void Remote::backward(void) {
     if (!_naoAvailable)
         return ;
-    sendRequest("/go-backwards");
+    if (!sendCommand(GoBackwardsCommand))
+        sendRequest("/go-backwards");
 }
 
 void Remote::stop(void) {
     if (!_naoAvailable)
         return ;
-    sendRequest("/stop");
+    if (!sendCommand(StopCommand))
+        sendRequest("/stop");
 }
 
 void Remote::left(void) {
     if (!_naoAvailable)
         return ;
-    sendRequest("/turn-left");
+    if (!sendCommand(TurnLeftCommand))
+        sendRequest("/turn-left");
 }
 
 void Remote::right(void) {
     if (!_naoAvailable)
         return ;
-    sendRequest("/turn-right");
+    if (!sendCommand(TurnRightCommand))
+        sendRequest("/turn-right");
 }
 
 void Remote::front(void) {
     if (!_naoAvailable)
         return ;
-    sendRequest("/turn-front");
+    if (!sendCommand(TurnFrontCommand))
+        sendRequest("/turn-front");
 }
 
 void Remote::sendRequest(std::string requestStr,
@@ -204,7 +221,36 @@ void Remote::sendRequest(std::string requestStr,
     _pendingRequest << newUrl;
 }
 
+bool Remote::sendCommand(CommandId command, float arg0, float arg1,
+                         float arg2, unsigned int present) {
+    if (!_controlConnected)
+        return false;
+    ControlFrame frame;
+    frame.command = command;
+    frame.args[0] = arg0;
+    frame.args[1] = arg1;
+    frame.args[2] = arg2;
+    frame.flags = present;
+    _pendingFramesMutex.lock();
+    frame.sequence = ++_controlSequence;
+    frame.timestamp = _controlClock.nsecsElapsed() / 1000;
+    _pendingFrames << frame;
+    _pendingFramesMutex.unlock();
+    // Sent right away by the main thread instead of waiting for the timer
+    QMetaObject::invokeMethod(this, "_flushPendingRequest", Qt::QueuedConnection);
+    return true;
+}
+
 void Remote::_flushPendingRequest() {
+    _pendingFramesMutex.lock();
+    if (!_pendingFrames.empty()) {
+        QByteArray data(_pendingFrames.size() * controlFrameSize, 0);
+        for (int i = 0; i < _pendingFrames.size(); ++i)
+            encodeControlFrame(_pendingFrames[i], data.data() + i * controlFrameSize);
+        _pendingFrames.clear();
+        _controlSocket->write(data);
+    }
+    _pendingFramesMutex.unlock();
     while (!_pendingRequest.empty()) {
         QUrl url = _pendingRequest.first();
         QNetworkRequest request;
@@ -223,25 +269,50 @@ void Remote::networkRequestFinished(QNetworkReply* reply) {
 
         if (data.startsWith("stream-port:")) {
             _streamSocket->connectToHost(_naoUrl.host(), data.mid(12).toInt());
+        } else if (data.startsWith("control-port:")) {
+            _controlSocket->connectToHost(_naoUrl.host(), data.mid(13).toInt());
         }
     }
 }
 
+void Remote::streamConnected(void) {
+    // Asks for the H.264 stream if it can be decoded, JPEG otherwise
+    _streamDecoder.reset();
+    _streamSocket->write(StreamDecoder::codecRequest());
+}
+
 void Remote::streamDataAvailable(void) {
-    if (_streamSizeRead == false &&
-            (quint64)_streamSocket->bytesAvailable() >= sizeof(_streamImageSize)) {
-        _streamSocket->read((char*)&_streamImageSize, sizeof(_streamImageSize));
-        _streamSizeRead = true;
-    }
-    if (_streamSizeRead == true &&
-            _streamSocket->bytesAvailable() >= _streamImageSize) {
-        QByteArray data = _streamSocket->read(_streamImageSize);
-        _streamImage->loadFromData(data);
+    if (_streamDecoder.read(_streamSocket, *_streamImage)) {
         _mainWindow.setStreamImage(_streamImage);
         if (_rift) {
             _rift->setViewImage(*_streamImage);
         }
-        _streamSizeRead = false;
+    }
+}
+
+void Remote::controlConnected(void) {
+    _controlSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    _controlConnected = 1;
+}
+
+void Remote::controlDisconnected(void) {
+    _controlConnected = 0;
+}
+
+void Remote::controlDataAvailable(void) {
+    while ((quint64)_controlSocket->bytesAvailable() >= controlFrameSize) {
+        char data[controlFrameSize];
+        ControlFrame frame;
+
+        _controlSocket->read(data, controlFrameSize);
+        if (!decodeControlFrame(data, frame)) {
+            qDebug() << "Invalid control frame";
+            _controlSocket->abort();
+            return ;
+        }
+        if (frame.flags != ControlOk && frame.flags != ControlSuperseded) {
+            qDebug() << "Command" << frame.command << "failed:" << frame.flags;
+        }
     }
 }
 
@@ -257,6 +328,8 @@ void Remote::rift(void) {
 }
 
 void Remote::riftOrientationUpdate(OVR::Vector3f orientation) {
+    if (sendCommand(SetHeadCommand, orientation.x, -orientation.y, 0.5, 7))
+        return ;
     ParamsList params;
     params << QPair<QString, QString>("headYaw", QString::number(orientation.x))
             << QPair<QString, QString>("headPitch", QString::number(-orientation.y))
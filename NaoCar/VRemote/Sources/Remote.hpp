@@ -12,6 +12,9 @@
 # include <QUrl>
 # include <QTcpSocket>
 # include <QTimer>
+# include <QElapsedTimer>
+# include <QMutex>
+# include <QAtomicInt>
 # include <Leap/Leap.h>
 
 # include <map>
@@ -19,7 +22,9 @@
 # include "MainWindow.hpp"
 # include "MainWindowDelegate.hpp"
 # include "Bonjour.hpp"
+# include "ControlProtocol.hpp"
 # include "BonjourDelegate.hpp"
+# include "StreamDecoder.hpp"
 # include "Rift.hpp"
 
 # define NAOCAR_BONJOUR_SERVICE_NAME "nao-car"
@@ -76,11 +81,25 @@ public:
     void sendRequest(std::string request,
                      ParamsList const & params=ParamsList());
 
+    //! Sends a command on the binary control connection
+    /*!
+     May be called from any thread.
+     \param present Bit i is set if the i-th argument is given
+     \return false if the control connection is not established, the
+     command should then be sent with sendRequest()
+     */
+    bool sendCommand(CommandId command, float arg0=0, float arg1=0,
+                     float arg2=0, unsigned int present=0);
+
     public slots:
     void networkRequestFinished(QNetworkReply* reply);
     
     private slots:
+    void streamConnected();
     void streamDataAvailable();
+    void controlConnected();
+    void controlDisconnected();
+    void controlDataAvailable();
     void _flushPendingRequest();
 
 private:
@@ -91,14 +110,19 @@ private:
     QNetworkAccessManager	_networkManager;
     bool                    _connected;
     QTcpSocket*             _streamSocket;
-    qint64                  _streamImageSize;
+    StreamDecoder           _streamDecoder;
     QImage*                 _streamImage;
-    bool                    _streamSizeRead;
     Rift*                   _rift;
     Controller*             _leapController;
     LeapListener*           _leapListener;
     QList<QUrl>             _pendingRequest;
     QTimer                  _flushRequestTimer;
+    QTcpSocket*             _controlSocket;
+    QAtomicInt              _controlConnected;
+    quint32                 _controlSequence;
+    QElapsedTimer           _controlClock;
+    QList<ControlFrame>     _pendingFrames;
+    QMutex                  _pendingFramesMutex;
 };
 
 #endif